@@ -33,6 +33,13 @@ int array_length(void* array) {
     return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
 }
 
+//drops the items from length on, the capacity stays
+void array_truncate(void* array, int length) {
+    if (array != NULL && length < ARRAY_OCCUPIED(array)) {
+        ARRAY_OCCUPIED(array) = length;
+    }
+}
+
 void array_free(void* array) {
     if (array != NULL) {
         free(ARRAY_RAW_DATA(array));
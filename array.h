@@ -9,6 +9,7 @@
 
 void* array_hold(void* array, int count, int item_size);
 int array_length(void* array);
+void array_truncate(void* array, int length);
 void array_free(void* array);
 
 #endif
@@ -0,0 +1,545 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include "array.h"
+#include "display.h"
+#include "mesh.h"
+#include "pipeline.h"
+#include "camera.h"
+#include "light.h"
+#include "shadow.h"
+#include "point_cloud.h"
+#include "thread_pool.h"
+#include "batch.h"
+#include "profiler.h"
+
+//offline rendering of camera paths into numbered .bmp files.
+//the job file has one setting per line, for example:
+//
+//  resolution 1920 1080
+//  frames 0 119
+//  display_mode 3
+//  depth_test 1
+//  msaa 1
+//  gamma_correct 1
+//  alpha 128
+//  shadows 1
+//  pcf 1
+//  light_direction 0.5 -1 1
+//  packed 1
+//  io_threads 4
+//  output renders
+//  mesh assets\cube.obj
+//  mesh assets\f22.obj
+//  skin assets\f22.skin
+//  key 0 0 0.3 5
+//  key 119 6.2832 0.3 5
+//
+//key lines are: frame, camera orbit yaw and pitch (elevation) in radians, distance from the mesh.
+//every mesh gets rendered over the whole frame range into <output>/<mesh name>_<frame>.bmp.
+//a skin line animates the mesh above it, see skin.h. display mode 6 draws the vertices as
+//points, which also works for vertex only files
+
+//copy of a finished frame waiting for an I/O thread to encode and write it
+typedef struct {
+	uint32_t* pixels;
+	int width;
+	int height;
+	char path[BATCH_MAX_PATH * 2 + 32]; //output directory, mesh name, frame number and extension
+	bool in_use;
+} batch_frame_t;
+
+typedef struct {
+	batch_frame_t* frames;
+	int num_frames;
+	SDL_mutex* lock;
+	SDL_cond* frame_released;
+	int failed_writes;
+} batch_frame_pool_t;
+
+typedef struct {
+	batch_frame_pool_t* pool;
+	batch_frame_t* frame;
+} batch_write_t;
+
+static char* skip_spaces(char* text) {
+	while (*text == ' ' || *text == '\t') {
+		text++;
+	}
+	return text;
+}
+
+static void trim_line_end(char* text) {
+	size_t length = strlen(text);
+	while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r' || text[length - 1] == ' ' || text[length - 1] == '\t')) {
+		text[--length] = '\0';
+	}
+}
+
+static bool starts_with_keyword(const char* line, const char* keyword) {
+	size_t length = strlen(keyword);
+	return strncmp(line, keyword, length) == 0 && (line[length] == ' ' || line[length] == '\t');
+}
+
+bool load_batch_job(const char* filename, batch_job_t* job) {
+	FILE* file;
+	char line[512];
+
+	memset(job, 0, sizeof(batch_job_t));
+	job->width = 1280;
+	job->height = 720;
+	job->first_frame = 0;
+	job->last_frame = 0;
+	job->display_mode = 3;
+	job->io_threads = 2;
+	job->alpha = 255;
+	job->shadows_pcf = true;
+	job->light_direction = light.direction;
+	snprintf(job->output_directory, sizeof(job->output_directory), ".");
+
+	if (fopen_s(&file, filename, "r") != 0) {
+		fprintf(stderr, "cannot open batch job file %s.\n", filename);
+		return false;
+	}
+
+	int line_number = 0;
+	bool valid = true;
+	while (fgets(line, 512, file)) {
+		line_number++;
+		trim_line_end(line);
+		char* text = skip_spaces(line);
+		if (text[0] == '\0' || text[0] == '#') {
+			continue;
+		}
+
+		int parsed = 0;
+		if (starts_with_keyword(text, "resolution")) {
+			parsed = sscanf_s(text, "resolution %d %d", &job->width, &job->height) == 2;
+		}
+		else if (starts_with_keyword(text, "frames")) {
+			parsed = sscanf_s(text, "frames %d %d", &job->first_frame, &job->last_frame) == 2;
+		}
+		else if (starts_with_keyword(text, "display_mode")) {
+			parsed = sscanf_s(text, "display_mode %d", &job->display_mode) == 1;
+		}
+		else if (starts_with_keyword(text, "depth_test")) {
+			int value = 0;
+			parsed = sscanf_s(text, "depth_test %d", &value) == 1;
+			job->depth_test = value != 0;
+		}
+		else if (starts_with_keyword(text, "msaa")) {
+			int value = 0;
+			parsed = sscanf_s(text, "msaa %d", &value) == 1;
+			job->msaa = value != 0;
+		}
+		else if (starts_with_keyword(text, "gamma_correct")) {
+			int value = 0;
+			parsed = sscanf_s(text, "gamma_correct %d", &value) == 1;
+			job->gamma_correct = value != 0;
+		}
+		else if (starts_with_keyword(text, "alpha")) {
+			parsed = sscanf_s(text, "alpha %d", &job->alpha) == 1 && job->alpha >= 0 && job->alpha <= 255;
+		}
+		else if (starts_with_keyword(text, "shadows")) {
+			int value = 0;
+			parsed = sscanf_s(text, "shadows %d", &value) == 1;
+			job->shadows = value != 0;
+		}
+		else if (starts_with_keyword(text, "pcf")) {
+			int value = 0;
+			parsed = sscanf_s(text, "pcf %d", &value) == 1;
+			job->shadows_pcf = value != 0;
+		}
+		else if (starts_with_keyword(text, "light_direction")) {
+			vec3_t direction;
+			parsed = sscanf_s(text, "light_direction %f %f %f", &direction.x, &direction.y, &direction.z) == 3
+				&& vec3_length(direction) > 0.0f;
+			if (parsed) {
+				vec3_normalize(&direction);
+				job->light_direction = direction;
+			}
+		}
+		else if (starts_with_keyword(text, "packed")) {
+			int value = 0;
+			parsed = sscanf_s(text, "packed %d", &value) == 1;
+			job->packed = value != 0;
+		}
+		else if (starts_with_keyword(text, "io_threads")) {
+			parsed = sscanf_s(text, "io_threads %d", &job->io_threads) == 1;
+		}
+		else if (starts_with_keyword(text, "output")) {
+			char* path = skip_spaces(text + strlen("output"));
+			parsed = strlen(path) > 0 && strlen(path) < BATCH_MAX_PATH;
+			if (parsed) {
+				snprintf(job->output_directory, sizeof(job->output_directory), "%s", path);
+			}
+		}
+		else if (starts_with_keyword(text, "mesh")) {
+			char* path = skip_spaces(text + strlen("mesh"));
+			parsed = strlen(path) > 0 && strlen(path) < BATCH_MAX_PATH;
+			if (parsed) {
+				batch_mesh_t mesh_entry;
+				snprintf(mesh_entry.path, sizeof(mesh_entry.path), "%s", path);
+				mesh_entry.skin_path[0] = '\0';
+				array_push(job->meshes, mesh_entry);
+			}
+		}
+		else if (starts_with_keyword(text, "skin")) {
+			char* path = skip_spaces(text + strlen("skin"));
+			int num_meshes = array_length(job->meshes);
+			parsed = num_meshes > 0 && strlen(path) > 0 && strlen(path) < BATCH_MAX_PATH;
+			if (parsed) {
+				snprintf(job->meshes[num_meshes - 1].skin_path, sizeof(job->meshes[num_meshes - 1].skin_path), "%s", path);
+			}
+		}
+		else if (starts_with_keyword(text, "key")) {
+			batch_keyframe_t key;
+			parsed = sscanf_s(text, "key %d %f %f %f", &key.frame, &key.yaw, &key.pitch, &key.distance) == 4;
+			if (parsed) {
+				//keep the keyframes sorted by frame
+				array_push(job->keyframes, key);
+				for (int i = array_length(job->keyframes) - 1; i > 0 && job->keyframes[i - 1].frame > job->keyframes[i].frame; i--) {
+					batch_keyframe_t temp = job->keyframes[i];
+					job->keyframes[i] = job->keyframes[i - 1];
+					job->keyframes[i - 1] = temp;
+				}
+			}
+		}
+
+		if (!parsed) {
+			fprintf(stderr, "%s:%d: cannot understand \"%s\".\n", filename, line_number, text);
+			valid = false;
+		}
+	}
+	fclose(file);
+
+	if (valid && (job->width <= 0 || job->height <= 0 || job->last_frame < job->first_frame || job->io_threads <= 0)) {
+		fprintf(stderr, "%s: resolution, frame range and io_threads have to be positive.\n", filename);
+		valid = false;
+	}
+	if (valid && (array_length(job->meshes) == 0 || array_length(job->keyframes) == 0)) {
+		fprintf(stderr, "%s: a batch job needs at least one mesh and one key.\n", filename);
+		valid = false;
+	}
+	if (!valid) {
+		free_batch_job(job);
+	}
+	return valid;
+}
+
+void free_batch_job(batch_job_t* job) {
+	array_free(job->meshes);
+	array_free(job->keyframes);
+	job->meshes = NULL;
+	job->keyframes = NULL;
+}
+
+static batch_keyframe_t interpolate_keyframes(batch_job_t* job, int frame) {
+	int num_keys = array_length(job->keyframes);
+	if (frame <= job->keyframes[0].frame) {
+		return job->keyframes[0];
+	}
+	for (int i = 1; i < num_keys; i++) {
+		batch_keyframe_t k0 = job->keyframes[i - 1];
+		batch_keyframe_t k1 = job->keyframes[i];
+		if (frame <= k1.frame) {
+			float t = (float)(frame - k0.frame) / (float)(k1.frame - k0.frame);
+			batch_keyframe_t result = {
+				.frame = frame,
+				.yaw = k0.yaw + (k1.yaw - k0.yaw) * t,
+				.pitch = k0.pitch + (k1.pitch - k0.pitch) * t,
+				.distance = k0.distance + (k1.distance - k0.distance) * t
+			};
+			return result;
+		}
+	}
+	return job->keyframes[num_keys - 1];
+}
+
+//file name without directories and extension
+static void mesh_base_name(const char* path, char* name, size_t size) {
+	const char* start = path;
+	for (const char* c = path; *c; c++) {
+		if (*c == '/' || *c == '\\') {
+			start = c + 1;
+		}
+	}
+	size_t length = strlen(start);
+	const char* dot = strrchr(start, '.');
+	if (dot) {
+		length = dot - start;
+	}
+	if (length >= size) {
+		length = size - 1;
+	}
+	memcpy(name, start, length);
+	name[length] = '\0';
+}
+
+static void write_le16(uint8_t* out, uint16_t value) {
+	out[0] = value & 0xFF;
+	out[1] = (value >> 8) & 0xFF;
+}
+
+static void write_le32(uint8_t* out, uint32_t value) {
+	out[0] = value & 0xFF;
+	out[1] = (value >> 8) & 0xFF;
+	out[2] = (value >> 16) & 0xFF;
+	out[3] = (value >> 24) & 0xFF;
+}
+
+//24 bit bottom up .bmp, rows padded to 4 bytes
+static bool write_bmp(const char* path, const uint32_t* pixels, int width, int height) {
+	int row_size = (width * 3 + 3) & ~3;
+	uint8_t header[54] = { 'B', 'M' };
+	write_le32(header + 2, 54 + row_size * height);
+	write_le32(header + 10, 54);
+	write_le32(header + 14, 40);
+	write_le32(header + 18, width);
+	write_le32(header + 22, height);
+	write_le16(header + 26, 1);
+	write_le16(header + 28, 24);
+	write_le32(header + 34, row_size * height);
+
+	FILE* file;
+	if (fopen_s(&file, path, "wb") != 0) {
+		return false;
+	}
+
+	uint8_t* row = (uint8_t*)calloc(row_size, 1);
+	bool ok = row && fwrite(header, sizeof(header), 1, file) == 1;
+	for (int y = height - 1; ok && y >= 0; y--) {
+		const uint32_t* source = pixels + (size_t)width * y;
+		for (int x = 0; x < width; x++) {
+			row[x * 3 + 0] = source[x] & 0xFF;
+			row[x * 3 + 1] = (source[x] >> 8) & 0xFF;
+			row[x * 3 + 2] = (source[x] >> 16) & 0xFF;
+		}
+		ok = fwrite(row, row_size, 1, file) == 1;
+	}
+	free(row);
+	return fclose(file) == 0 && ok;
+}
+
+//hands the frame copy back for the next frame, written tells whether it reached the disk
+static void release_frame(batch_frame_pool_t* pool, batch_frame_t* frame, bool written) {
+	SDL_LockMutex(pool->lock);
+	if (!written) {
+		pool->failed_writes++;
+	}
+	frame->in_use = false;
+	SDL_CondSignal(pool->frame_released);
+	SDL_UnlockMutex(pool->lock);
+}
+
+static void write_frame_job(void* data) {
+	batch_write_t* write = (batch_write_t*)data;
+	batch_frame_pool_t* pool = write->pool;
+	batch_frame_t* frame = write->frame;
+	free(write);
+
+	PROFILE_BEGIN(PROFILE_WRITE_IMAGE);
+	bool ok = write_bmp(frame->path, frame->pixels, frame->width, frame->height);
+	PROFILE_END(PROFILE_WRITE_IMAGE);
+	if (!ok) {
+		fprintf(stderr, "cannot write %s.\n", frame->path);
+	}
+
+	release_frame(pool, frame, ok);
+}
+
+//the rasterizer only waits here when every frame copy is still queued for writing
+static batch_frame_t* acquire_frame(batch_frame_pool_t* pool) {
+	batch_frame_t* frame = NULL;
+	SDL_LockMutex(pool->lock);
+	while (!frame) {
+		for (int i = 0; i < pool->num_frames; i++) {
+			if (!pool->frames[i].in_use) {
+				frame = &pool->frames[i];
+				frame->in_use = true;
+				break;
+			}
+		}
+		if (!frame) {
+			SDL_CondWait(pool->frame_released, pool->lock);
+		}
+	}
+	SDL_UnlockMutex(pool->lock);
+	return frame;
+}
+
+static bool render_mesh_frames(batch_job_t* job, batch_mesh_t* mesh_entry, thread_pool_t* io_pool, batch_frame_pool_t* frame_pool) {
+	mesh_free(&mesh);
+	mesh.rotation = (vec3_t){ 0, 0, 0 };
+	mesh.translation = (vec3_t){ 0, 0, 0 };
+	load_obj_file_data(mesh_entry->path);
+	//vertex only files like scans can still be drawn as points
+	if (array_length(mesh.faces) == 0 && (display_mode != POINT_DISPLAY_MODE || array_length(mesh.vertices) == 0)) {
+		fprintf(stderr, "%s has no faces, skipping it.\n", mesh_entry->path);
+		return false;
+	}
+	mesh_build_edges(&mesh);
+	mesh_compute_bounds(&mesh);
+	if (mesh_entry->skin_path[0] && !mesh_load_skin(&mesh, mesh_entry->skin_path)) {
+		return false;
+	}
+	if (job->packed && !mesh_pack(&mesh)) {
+		return false;
+	}
+	mesh_set_alpha(&mesh, (uint8_t)job->alpha);
+	if (!setup_vertex_buffers()) {
+		return false;
+	}
+
+	char name[BATCH_MAX_PATH];
+	mesh_base_name(mesh_entry->path, name, sizeof(name));
+	rect_t frame_area = rect_make(0, 0, window_width, window_height);
+
+	for (int frame_number = job->first_frame; frame_number <= job->last_frame; frame_number++) {
+		PROFILE_BEGIN(PROFILE_FRAME);
+		//the camera orbits the mesh, which stays untransformed at the origin
+		batch_keyframe_t key = interpolate_keyframes(job, frame_number);
+		vec3_t eye = {
+			-key.distance * sinf(key.yaw) * cosf(key.pitch),
+			key.distance * sinf(key.pitch),
+			-key.distance * cosf(key.yaw) * cosf(key.pitch)
+		};
+		vec3_t target = { 0, 0, 0 };
+		camera_look_at(&camera, eye, target);
+		mesh_animate(&mesh, (float)frame_number / BATCH_ANIMATION_FPS);
+
+		transform_mesh();
+		render_triangles(frame_area);
+
+		batch_frame_t* frame = acquire_frame(frame_pool);
+		memcpy(frame->pixels, color_buffer, sizeof(uint32_t) * window_width * window_height);
+		int path_length = snprintf(frame->path, sizeof(frame->path), "%s/%s_%04d.bmp", job->output_directory, name, frame_number);
+		if (path_length < 0 || path_length >= (int)sizeof(frame->path)) {
+			//a cut off path could overwrite another frame
+			fprintf(stderr, "output path for %s frame %d is too long.\n", name, frame_number);
+			release_frame(frame_pool, frame, false);
+			PROFILE_END(PROFILE_FRAME);
+			return false;
+		}
+
+		batch_write_t* write = (batch_write_t*)malloc(sizeof(batch_write_t));
+		if (!write) {
+			fprintf(stderr, "Error creating the batch write. Probably not enough avaliable memory.\n");
+			release_frame(frame_pool, frame, false);
+			PROFILE_END(PROFILE_FRAME);
+			return false;
+		}
+		write->pool = frame_pool;
+		write->frame = frame;
+		thread_pool_submit(io_pool, write_frame_job, write);
+		PROFILE_END(PROFILE_FRAME);
+#ifdef ENABLE_PROFILER
+		profiler_end_frame();
+#endif
+	}
+	return true;
+}
+
+//renders every mesh of the job as fast as possible, without a window or frame pacing
+bool run_batch_job(const char* filename) {
+	batch_job_t job;
+	if (!load_batch_job(filename, &job)) {
+		return false;
+	}
+
+	set_output_size(job.width, job.height);
+	display_mode = job.display_mode;
+	depth_test_enabled = job.depth_test;
+	light.gamma_correct = job.gamma_correct;
+	light.direction = job.light_direction;
+	shadow_map.pcf = job.shadows_pcf;
+	shadow_map.enabled = job.shadows && shadow_map_init();
+	color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
+	depth_buffer = (float*)malloc(sizeof(float) * window_width * window_height);
+	msaa_enabled = job.msaa && allocate_msaa_buffers();
+	if (display_mode == 5 && !allocate_overdraw_buffer()) {
+		display_mode = 3;
+	}
+	setup_projection();
+#ifdef ENABLE_PROFILER
+	profiler_set_viewport(window_width, window_height);
+#endif
+
+	//two frame copies per I/O thread keep every writer busy while the next frames render
+	batch_frame_pool_t frame_pool = { 0 };
+	frame_pool.num_frames = job.io_threads * 2;
+	frame_pool.frames = (batch_frame_t*)calloc(frame_pool.num_frames, sizeof(batch_frame_t));
+	frame_pool.lock = SDL_CreateMutex();
+	frame_pool.frame_released = SDL_CreateCond();
+
+	bool ok = color_buffer && depth_buffer && frame_pool.frames;
+	for (int i = 0; ok && i < frame_pool.num_frames; i++) {
+		frame_pool.frames[i].width = window_width;
+		frame_pool.frames[i].height = window_height;
+		frame_pool.frames[i].pixels = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
+		ok = frame_pool.frames[i].pixels != NULL;
+	}
+	if (!ok) {
+		fprintf(stderr, "Error creating the batch frame buffers. Probably not enough avaliable memory.\n");
+	}
+
+	thread_pool_t* io_pool = ok ? thread_pool_create(job.io_threads, "batch io") : NULL;
+	ok = ok && io_pool;
+
+	Uint64 start_time = SDL_GetPerformanceCounter();
+	int rendered_frames = 0;
+	int num_meshes = array_length(job.meshes);
+	for (int i = 0; ok && i < num_meshes; i++) {
+		if (render_mesh_frames(&job, &job.meshes[i], io_pool, &frame_pool)) {
+			rendered_frames += job.last_frame - job.first_frame + 1;
+		}
+	}
+
+	//drain the writers before the frame copies go away
+	thread_pool_destroy(io_pool);
+
+	if (ok) {
+		double seconds = (double)(SDL_GetPerformanceCounter() - start_time) / SDL_GetPerformanceFrequency();
+		printf("rendered %d frames in %.2f s (%.1f frames per second), %d failed writes\n",
+			rendered_frames, seconds, seconds > 0 ? rendered_frames / seconds : 0.0, frame_pool.failed_writes);
+	}
+	ok = ok && frame_pool.failed_writes == 0;
+
+#ifdef ENABLE_PROFILER
+	char trace_path[BATCH_MAX_PATH + 16];
+	snprintf(trace_path, sizeof(trace_path), "%s/trace.json", job.output_directory);
+	if (profiler_write_chrome_trace(trace_path)) {
+		printf("trace written to %s\n", trace_path);
+	}
+#endif
+
+	for (int i = 0; frame_pool.frames && i < frame_pool.num_frames; i++) {
+		free(frame_pool.frames[i].pixels);
+	}
+	free(frame_pool.frames);
+	SDL_DestroyCond(frame_pool.frame_released);
+	SDL_DestroyMutex(frame_pool.lock);
+	free(color_buffer);
+	free(depth_buffer);
+	free(msaa_color_buffer);
+	free(msaa_depth_buffer);
+	free(overdraw_buffer);
+	free(oit_accum_buffer);
+	free(oit_revealage_buffer);
+	color_buffer = NULL;
+	depth_buffer = NULL;
+	msaa_color_buffer = NULL;
+	msaa_depth_buffer = NULL;
+	overdraw_buffer = NULL;
+	oit_accum_buffer = NULL;
+	oit_revealage_buffer = NULL;
+	free_vertex_buffers();
+	shadow_map_free();
+	mesh_free(&mesh);
+	skin_shutdown();
+	point_cloud_shutdown();
+	free_batch_job(&job);
+	return ok;
+}
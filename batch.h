@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "vector.h"
+
+#define BATCH_MAX_PATH 260
+//frame rate of skinned animations, frame n shows the pose at n / BATCH_ANIMATION_FPS seconds
+#define BATCH_ANIMATION_FPS 30
+
+//camera position on an orbit around the mesh at a given frame,
+//frames between two keyframes are interpolated linearly
+typedef struct {
+	int frame;
+	float yaw;
+	float pitch;
+	float distance;
+} batch_keyframe_t;
+
+typedef struct {
+	char path[BATCH_MAX_PATH];
+	char skin_path[BATCH_MAX_PATH]; //empty for a rigid mesh
+} batch_mesh_t;
+
+typedef struct {
+	int width;
+	int height;
+	int first_frame;
+	int last_frame;
+	int display_mode;
+	bool depth_test;
+	bool msaa;
+	bool gamma_correct;
+	int alpha; //of every face, 0 - 255
+	bool shadows;
+	bool shadows_pcf;
+	vec3_t light_direction;
+	bool packed; //render from the compressed mesh, see packed_mesh.h
+	int io_threads;
+	char output_directory[BATCH_MAX_PATH];
+	batch_mesh_t* meshes;          //dynamic array
+	batch_keyframe_t* keyframes;   //dynamic array, sorted by frame
+} batch_job_t;
+
+bool load_batch_job(const char* filename, batch_job_t* job);
+void free_batch_job(batch_job_t* job);
+bool run_batch_job(const char* filename);
+
+#endif
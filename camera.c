@@ -0,0 +1,118 @@
+#include <math.h>
+#include "camera.h"
+
+#define CAMERA_MAX_PITCH 1.55f
+
+camera_t camera = {
+	.position = { 0, 0, 0 },
+	.yaw = 0,
+	.pitch = 0,
+	.fov = (float)(M_PI / 3.0),
+	.znear = 0.1f,
+	.zfar = 100.0f,
+	.viewport_width = 800,
+	.viewport_height = 800,
+	.forward = { 0, 0, 1 },
+	.view_changed = true,
+	.projection_changed = true,
+	.version = 0
+};
+
+void camera_set_position(camera_t* c, vec3_t position) {
+	c->position = position;
+	c->view_changed = true;
+}
+
+void camera_set_rotation(camera_t* c, float yaw, float pitch) {
+	if (pitch > CAMERA_MAX_PITCH) pitch = CAMERA_MAX_PITCH;
+	if (pitch < -CAMERA_MAX_PITCH) pitch = -CAMERA_MAX_PITCH;
+	c->yaw = yaw;
+	c->pitch = pitch;
+	c->view_changed = true;
+}
+
+void camera_look_at(camera_t* c, vec3_t eye, vec3_t target) {
+	vec3_t direction = vec3_sub(target, eye);
+	float horizontal = sqrtf(direction.x * direction.x + direction.z * direction.z);
+	c->position = eye;
+	camera_set_rotation(c, atan2f(direction.x, direction.z), atan2f(direction.y, horizontal));
+}
+
+//moves along the horizontal view direction, so looking up or down does not change height
+void camera_move(camera_t* c, float forward_amount, float right_amount) {
+	float sine = sinf(c->yaw);
+	float cosine = cosf(c->yaw);
+	c->position.x += sine * forward_amount + cosine * right_amount;
+	c->position.z += cosine * forward_amount - sine * right_amount;
+	c->view_changed = true;
+}
+
+void camera_set_viewport(camera_t* c, int width, int height) {
+	if (c->viewport_width != width || c->viewport_height != height) {
+		c->viewport_width = width;
+		c->viewport_height = height;
+		c->projection_changed = true;
+	}
+}
+
+void camera_set_perspective(camera_t* c, float fov, float znear, float zfar) {
+	c->fov = fov;
+	c->znear = znear;
+	c->zfar = zfar;
+	c->projection_changed = true;
+}
+
+static plane_t make_plane(float a, float b, float c, float d) {
+	float length = sqrtf(a * a + b * b + c * c);
+	plane_t plane = { { a / length, b / length, c / length }, d / length };
+	return plane;
+}
+
+//Gribb-Hartmann: the frustum planes are sums and differences of the rows of the
+//view projection matrix, with this projection z / w runs from 0 at znear to 1 at zfar
+static void extract_frustum_planes(camera_t* c) {
+	float(*m)[4] = c->view_projection_matrix.m;
+	c->frustum_planes[FRUSTUM_LEFT] = make_plane(m[3][0] + m[0][0], m[3][1] + m[0][1], m[3][2] + m[0][2], m[3][3] + m[0][3]);
+	c->frustum_planes[FRUSTUM_RIGHT] = make_plane(m[3][0] - m[0][0], m[3][1] - m[0][1], m[3][2] - m[0][2], m[3][3] - m[0][3]);
+	c->frustum_planes[FRUSTUM_BOTTOM] = make_plane(m[3][0] + m[1][0], m[3][1] + m[1][1], m[3][2] + m[1][2], m[3][3] + m[1][3]);
+	c->frustum_planes[FRUSTUM_TOP] = make_plane(m[3][0] - m[1][0], m[3][1] - m[1][1], m[3][2] - m[1][2], m[3][3] - m[1][3]);
+	c->frustum_planes[FRUSTUM_NEAR] = make_plane(m[2][0], m[2][1], m[2][2], m[2][3]);
+	c->frustum_planes[FRUSTUM_FAR] = make_plane(m[3][0] - m[2][0], m[3][1] - m[2][1], m[3][2] - m[2][2], m[3][3] - m[2][3]);
+}
+
+//rebuilds only the matrices whose inputs changed since the last call
+void camera_update(camera_t* c) {
+	if (!c->view_changed && !c->projection_changed) {
+		return;
+	}
+
+	if (c->view_changed) {
+		c->forward.x = sinf(c->yaw) * cosf(c->pitch);
+		c->forward.y = sinf(c->pitch);
+		c->forward.z = cosf(c->yaw) * cosf(c->pitch);
+		vec3_t target = vec3_add(c->position, c->forward);
+		vec3_t up = { 0, 1, 0 };
+		c->view_matrix = mat4_look_at(c->position, target, up);
+	}
+	if (c->projection_changed) {
+		float aspect = (float)c->viewport_height / (float)c->viewport_width;
+		c->projection_matrix = mat4_make_perspective(c->fov, aspect, c->znear, c->zfar);
+	}
+
+	mat4_mul_mat4_faster(&c->view_projection_matrix, &c->projection_matrix, &c->view_matrix);
+	extract_frustum_planes(c);
+
+	c->view_changed = false;
+	c->projection_changed = false;
+	c->version++;
+}
+
+bool camera_sphere_visible(camera_t* c, vec3_t center, float radius) {
+	for (int i = 0; i < FRUSTUM_PLANES; i++) {
+		plane_t plane = c->frustum_planes[i];
+		if (vec3_dot(plane.normal, center) + plane.d < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+
+//plane as normal and distance, a point p is in front of it when dot(normal, p) + d >= 0
+typedef struct {
+	vec3_t normal;
+	float d;
+} plane_t;
+
+enum {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_PLANES
+};
+
+//fps style camera: a position plus yaw (around y) and pitch (around x),
+//yaw 0 and pitch 0 look down +z. the matrices are cached and only rebuilt
+//by camera_update after something changed
+typedef struct {
+	vec3_t position;
+	float yaw;
+	float pitch;
+
+	float fov;
+	float znear;
+	float zfar;
+	int viewport_width;
+	int viewport_height;
+
+	mat4_t view_matrix;
+	mat4_t projection_matrix;
+	mat4_t view_projection_matrix;
+	plane_t frustum_planes[FRUSTUM_PLANES];
+	vec3_t forward;
+
+	bool view_changed;
+	bool projection_changed;
+	unsigned int version; //goes up every time view_projection_matrix gets rebuilt
+} camera_t;
+
+extern camera_t camera;
+
+void camera_set_position(camera_t* c, vec3_t position);
+void camera_set_rotation(camera_t* c, float yaw, float pitch);
+void camera_look_at(camera_t* c, vec3_t eye, vec3_t target);
+void camera_move(camera_t* c, float forward_amount, float right_amount);
+void camera_set_viewport(camera_t* c, int width, int height);
+void camera_set_perspective(camera_t* c, float fov, float znear, float zfar);
+void camera_update(camera_t* c);
+bool camera_sphere_visible(camera_t* c, vec3_t center, float radius);
+
+#endif
@@ -0,0 +1,628 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "array.h"
+#include "camera.h"
+#include "cluster.h"
+#include "file.h"
+
+//projected bounding sphere radius in pixels above which a cluster wants level 0 / level 1
+#define CLUSTER_LOD0_PIXELS 96.0f
+#define CLUSTER_LOD1_PIXELS 24.0f
+
+//grid cells per axis used to simplify each level after the first one
+static const int lod_grid_cells[CLUSTER_LODS] = { 0, 16, 6 };
+
+static float vec3_axis(vec3_t v, int axis) {
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+//builder
+
+typedef struct {
+	int first;
+	int count;
+} cluster_range_t;
+
+typedef struct {
+	vec3_t* vertices;
+	face_t* faces;
+} cluster_geometry_t;
+
+//qsort has no context argument, the builder is single threaded
+static vec3_t* sort_centroids = NULL;
+static int sort_axis = 0;
+
+static int compare_centroids(const void* a, const void* b) {
+	float ca = vec3_axis(sort_centroids[*(const int*)a], sort_axis);
+	float cb = vec3_axis(sort_centroids[*(const int*)b], sort_axis);
+	return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+//splits the faces at the median of their centers along the longest axis until every part is small enough
+static void split_faces(int* face_order, vec3_t* centroids, int first, int count, int max_faces, cluster_range_t** ranges) {
+	if (count <= max_faces) {
+		cluster_range_t range = { first, count };
+		array_push(*ranges, range);
+		return;
+	}
+
+	vec3_t min = centroids[face_order[first]];
+	vec3_t max = min;
+	for (int i = first + 1; i < first + count; i++) {
+		vec3_t c = centroids[face_order[i]];
+		if (c.x < min.x) min.x = c.x;
+		if (c.y < min.y) min.y = c.y;
+		if (c.z < min.z) min.z = c.z;
+		if (c.x > max.x) max.x = c.x;
+		if (c.y > max.y) max.y = c.y;
+		if (c.z > max.z) max.z = c.z;
+	}
+	vec3_t size = vec3_sub(max, min);
+	sort_axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+	sort_centroids = centroids;
+	qsort(face_order + first, count, sizeof(int), compare_centroids);
+
+	int half = count / 2;
+	split_faces(face_order, centroids, first, half, max_faces, ranges);
+	split_faces(face_order, centroids, first + half, count - half, max_faces, ranges);
+}
+
+//level 0: the faces of the range with their vertices renumbered to the cluster
+static void build_full_level(const int* face_order, cluster_range_t range, int* remap, cluster_geometry_t* level) {
+	for (int i = range.first; i < range.first + range.count; i++) {
+		face_t face = mesh.faces[face_order[i]];
+		int* indices[3] = { &face.a, &face.b, &face.c };
+		for (int j = 0; j < 3; j++) {
+			int index = *indices[j] - 1;
+			if (remap[index] < 0) {
+				remap[index] = array_length(level->vertices);
+				array_push(level->vertices, mesh.vertices[index]);
+			}
+			*indices[j] = remap[index] + 1;
+		}
+		array_push(level->faces, face);
+	}
+
+	//leave the table clean for the next cluster
+	for (int i = range.first; i < range.first + range.count; i++) {
+		face_t face = mesh.faces[face_order[i]];
+		remap[face.a - 1] = -1;
+		remap[face.b - 1] = -1;
+		remap[face.c - 1] = -1;
+	}
+}
+
+//vertex clustering: all vertices in one grid cell collapse into their average,
+//faces that lose an edge on the way are dropped
+static void build_simplified_level(const cluster_geometry_t* full, vec3_t center, float radius, int cells, cluster_geometry_t* level) {
+	int num_cells = cells * cells * cells;
+	int* cell_vertex = (int*)malloc(sizeof(int) * num_cells);
+	int num_vertices = array_length(full->vertices);
+	int* vertex_map = (int*)malloc(sizeof(int) * (num_vertices > 0 ? num_vertices : 1));
+	float* weights = NULL;
+	if (!cell_vertex || !vertex_map) {
+		fprintf(stderr, "Error creating the simplification tables. Probably not enough avaliable memory.\n");
+		free(cell_vertex);
+		free(vertex_map);
+		return;
+	}
+	for (int i = 0; i < num_cells; i++) {
+		cell_vertex[i] = -1;
+	}
+
+	float cell_size = (radius > 0 ? 2 * radius : 1.0f) / cells;
+	vec3_t origin = { center.x - radius, center.y - radius, center.z - radius };
+	for (int i = 0; i < num_vertices; i++) {
+		vec3_t v = full->vertices[i];
+		int cell[3];
+		for (int axis = 0; axis < 3; axis++) {
+			int c = (int)((vec3_axis(v, axis) - vec3_axis(origin, axis)) / cell_size);
+			cell[axis] = c < 0 ? 0 : (c >= cells ? cells - 1 : c);
+		}
+		int id = cell[0] + cells * (cell[1] + cells * cell[2]);
+		if (cell_vertex[id] < 0) {
+			cell_vertex[id] = array_length(level->vertices);
+			vec3_t zero = { 0, 0, 0 };
+			array_push(level->vertices, zero);
+			array_push(weights, 0.0f);
+		}
+		int index = cell_vertex[id];
+		level->vertices[index] = vec3_add(level->vertices[index], v);
+		weights[index] += 1.0f;
+		vertex_map[i] = index;
+	}
+	for (int i = 0; i < array_length(level->vertices); i++) {
+		level->vertices[i] = vec3_div(level->vertices[i], weights[i]);
+	}
+
+	for (int i = 0; i < array_length(full->faces); i++) {
+		face_t face = full->faces[i];
+		face.a = vertex_map[face.a - 1] + 1;
+		face.b = vertex_map[face.b - 1] + 1;
+		face.c = vertex_map[face.c - 1] + 1;
+		if (face.a != face.b && face.b != face.c && face.a != face.c) {
+			array_push(level->faces, face);
+		}
+	}
+
+	array_free(weights);
+	free(vertex_map);
+	free(cell_vertex);
+}
+
+static bool write_level(FILE* file, const cluster_geometry_t* level, cluster_lod_header_t* header) {
+	header->offset = file_tell(file);
+	header->num_vertices = array_length(level->vertices);
+	header->num_faces = array_length(level->faces);
+	bool ok = true;
+	if (header->num_vertices > 0) {
+		ok = ok && fwrite(level->vertices, sizeof(vec3_t), header->num_vertices, file) == header->num_vertices;
+	}
+	if (header->num_faces > 0) {
+		ok = ok && fwrite(level->faces, sizeof(face_t), header->num_faces, file) == header->num_faces;
+	}
+	return ok;
+}
+
+//splits an .obj file into spatial clusters with their levels of detail. this is an offline
+//step: the source mesh has to fit into memory once, the result never has to again
+bool cluster_build_file(char* obj_filename, const char* cluster_filename, int max_faces_per_cluster) {
+	mesh_free(&mesh);
+	load_obj_file_data(obj_filename);
+	int num_vertices = array_length(mesh.vertices);
+	int num_faces = array_length(mesh.faces);
+	if (num_faces == 0) {
+		fprintf(stderr, "%s has no faces.\n", obj_filename);
+		mesh_free(&mesh);
+		return false;
+	}
+	mesh_compute_bounds(&mesh);
+
+	int* face_order = (int*)malloc(sizeof(int) * num_faces);
+	vec3_t* centroids = (vec3_t*)malloc(sizeof(vec3_t) * num_faces);
+	int* remap = (int*)malloc(sizeof(int) * num_vertices);
+	FILE* file = NULL;
+	bool ok = face_order && centroids && remap;
+	if (!ok) {
+		fprintf(stderr, "Error creating the cluster builder tables. Probably not enough avaliable memory.\n");
+	}
+	else if (fopen_s(&file, cluster_filename, "wb") != 0 || !file) {
+		fprintf(stderr, "cannot open %s.\n", cluster_filename);
+		file = NULL;
+		ok = false;
+	}
+
+	cluster_range_t* ranges = NULL;
+	cluster_header_t* headers = NULL;
+	if (ok) {
+		for (int i = 0; i < num_vertices; i++) {
+			remap[i] = -1;
+		}
+		for (int i = 0; i < num_faces; i++) {
+			face_order[i] = i;
+			face_t face = mesh.faces[i];
+			vec3_t sum = vec3_add(vec3_add(mesh.vertices[face.a - 1], mesh.vertices[face.b - 1]), mesh.vertices[face.c - 1]);
+			centroids[i] = vec3_div(sum, 3.0f);
+		}
+		split_faces(face_order, centroids, 0, num_faces, max_faces_per_cluster > 0 ? max_faces_per_cluster : CLUSTER_DEFAULT_FACES, &ranges);
+
+		int num_clusters = array_length(ranges);
+		headers = (cluster_header_t*)calloc(num_clusters, sizeof(cluster_header_t));
+		cluster_file_header_t file_header = { { 'C', 'L', 'U', '1' }, (uint32_t)num_clusters, mesh.bounds_center, mesh.bounds_radius };
+
+		//the cluster table is written again at the end, once the offsets are known
+		ok = headers
+			&& fwrite(&file_header, sizeof(file_header), 1, file) == 1
+			&& fwrite(headers, sizeof(cluster_header_t), num_clusters, file) == (size_t)num_clusters;
+
+		for (int c = 0; ok && c < num_clusters; c++) {
+			cluster_geometry_t levels[CLUSTER_LODS];
+			memset(levels, 0, sizeof(levels));
+			build_full_level(face_order, ranges[c], remap, &levels[0]);
+
+			mesh_t cluster_mesh = { 0 };
+			cluster_mesh.vertices = levels[0].vertices;
+			mesh_compute_bounds(&cluster_mesh);
+			headers[c].center = cluster_mesh.bounds_center;
+			headers[c].radius = cluster_mesh.bounds_radius;
+
+			for (int lod = 1; lod < CLUSTER_LODS; lod++) {
+				build_simplified_level(&levels[0], headers[c].center, headers[c].radius, lod_grid_cells[lod], &levels[lod]);
+			}
+			for (int lod = 0; lod < CLUSTER_LODS; lod++) {
+				ok = ok && write_level(file, &levels[lod], &headers[c].lods[lod]);
+				array_free(levels[lod].vertices);
+				array_free(levels[lod].faces);
+			}
+		}
+
+		ok = ok
+			&& file_seek(file, sizeof(cluster_file_header_t)) == 0
+			&& fwrite(headers, sizeof(cluster_header_t), num_clusters, file) == (size_t)num_clusters;
+		if (ok) {
+			printf("wrote %d clusters of up to %d faces to %s\n", num_clusters,
+				max_faces_per_cluster > 0 ? max_faces_per_cluster : CLUSTER_DEFAULT_FACES, cluster_filename);
+		}
+		else {
+			fprintf(stderr, "cannot write %s.\n", cluster_filename);
+		}
+	}
+
+	if (file && fclose(file) != 0) {
+		ok = false;
+	}
+	array_free(ranges);
+	free(headers);
+	free(remap);
+	free(centroids);
+	free(face_order);
+	mesh_free(&mesh);
+	return ok;
+}
+
+//streaming
+
+static size_t estimate_level_bytes(const cluster_lod_header_t* header) {
+	//a closed mesh has one and a half edges per face
+	return header->num_vertices * sizeof(vec3_t) + header->num_faces * sizeof(face_t)
+		+ header->num_faces * 3 / 2 * sizeof(mesh_edge_t);
+}
+
+static void free_level(cluster_lod_t* level) {
+	array_free(level->vertices);
+	array_free(level->faces);
+	array_free(level->edges);
+	level->vertices = NULL;
+	level->faces = NULL;
+	level->edges = NULL;
+	level->bytes = 0;
+}
+
+//runs on the I/O thread without holding the lock
+static bool read_level(cluster_stream_t* stream, int key, cluster_lod_t* result) {
+	cluster_lod_header_t* header = &stream->headers[key / CLUSTER_LODS].lods[key % CLUSTER_LODS];
+	mesh_t level = { 0 };
+	level.vertices = (vec3_t*)array_hold(NULL, header->num_vertices, sizeof(vec3_t));
+	level.faces = (face_t*)array_hold(NULL, header->num_faces, sizeof(face_t));
+
+	bool ok = file_seek(stream->file, header->offset) == 0
+		&& fread(level.vertices, sizeof(vec3_t), header->num_vertices, stream->file) == header->num_vertices
+		&& fread(level.faces, sizeof(face_t), header->num_faces, stream->file) == header->num_faces;
+	for (uint32_t i = 0; ok && i < header->num_faces; i++) {
+		face_t face = level.faces[i];
+		ok = face.a >= 1 && face.b >= 1 && face.c >= 1
+			&& face.a <= (int)header->num_vertices && face.b <= (int)header->num_vertices && face.c <= (int)header->num_vertices;
+	}
+	if (!ok) {
+		fprintf(stderr, "cannot read cluster %d level %d.\n", key / CLUSTER_LODS, key % CLUSTER_LODS);
+		mesh_free(&level);
+		return false;
+	}
+
+	mesh_build_edges(&level);
+	result->vertices = level.vertices;
+	result->faces = level.faces;
+	result->edges = level.edges;
+	result->bytes = header->num_vertices * sizeof(vec3_t) + header->num_faces * sizeof(face_t)
+		+ array_length(level.edges) * sizeof(mesh_edge_t);
+	return true;
+}
+
+static int cluster_io_main(void* data) {
+	cluster_stream_t* stream = (cluster_stream_t*)data;
+
+	SDL_LockMutex(stream->lock);
+	while (true) {
+		while (!stream->stopping && stream->next_request == array_length(stream->requests)) {
+			SDL_CondWait(stream->request_available, stream->lock);
+		}
+		if (stream->stopping) {
+			break;
+		}
+
+		int key = stream->requests[stream->next_request++];
+		stream->lods[key].state = CLUSTER_LOADING;
+		SDL_UnlockMutex(stream->lock);
+
+		cluster_lod_t result = { 0 };
+		read_level(stream, key, &result);
+
+		SDL_LockMutex(stream->lock);
+		stream->lods[key].vertices = result.vertices;
+		stream->lods[key].faces = result.faces;
+		stream->lods[key].edges = result.edges;
+		stream->lods[key].bytes = result.bytes;
+		array_push(stream->completed, key);
+	}
+	SDL_UnlockMutex(stream->lock);
+	return 0;
+}
+
+cluster_stream_t* cluster_stream_open(const char* filename, size_t memory_budget) {
+	cluster_stream_t* stream = (cluster_stream_t*)calloc(1, sizeof(cluster_stream_t));
+	if (!stream) {
+		fprintf(stderr, "Error creating the cluster stream. Probably not enough avaliable memory.\n");
+		return NULL;
+	}
+	stream->memory_budget = memory_budget;
+
+	if (fopen_s(&stream->file, filename, "rb") != 0 || !stream->file) {
+		fprintf(stderr, "cannot open %s.\n", filename);
+		free(stream);
+		return NULL;
+	}
+
+	cluster_file_header_t file_header;
+	if (fread(&file_header, sizeof(file_header), 1, stream->file) != 1 || memcmp(file_header.magic, "CLU1", 4) != 0) {
+		fprintf(stderr, "%s is not a cluster file.\n", filename);
+		fclose(stream->file);
+		free(stream);
+		return NULL;
+	}
+
+	stream->num_clusters = file_header.num_clusters;
+	stream->bounds_center = file_header.bounds_center;
+	stream->bounds_radius = file_header.bounds_radius;
+	stream->headers = (cluster_header_t*)malloc(sizeof(cluster_header_t) * stream->num_clusters);
+	stream->lods = (cluster_lod_t*)calloc((size_t)stream->num_clusters * CLUSTER_LODS, sizeof(cluster_lod_t));
+	if (!stream->headers || !stream->lods
+		|| fread(stream->headers, sizeof(cluster_header_t), stream->num_clusters, stream->file) != (size_t)stream->num_clusters) {
+		fprintf(stderr, "cannot read the cluster table of %s.\n", filename);
+		cluster_stream_close(stream);
+		return NULL;
+	}
+
+	stream->lock = SDL_CreateMutex();
+	stream->request_available = SDL_CreateCond();
+	stream->thread = SDL_CreateThread(cluster_io_main, "cluster io", stream);
+	if (!stream->thread) {
+		fprintf(stderr, "Error creating the cluster I/O thread: %s\n", SDL_GetError());
+		cluster_stream_close(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+typedef struct {
+	int key;
+	float priority;
+} cluster_request_t;
+
+static int compare_requests(const void* a, const void* b) {
+	float pa = ((const cluster_request_t*)a)->priority;
+	float pb = ((const cluster_request_t*)b)->priority;
+	return pa > pb ? -1 : (pa < pb ? 1 : 0);
+}
+
+//picks the level to draw for every visible cluster out of what is resident, queues the
+//levels the current view would rather have and evicts what has not been used for longest.
+//the I/O thread never holds the lock while it reads, so this never waits for the disk
+void cluster_stream_update(cluster_stream_t* stream, const mat4_t* world_matrix, float max_scale) {
+	stream->frame++;
+	SDL_LockMutex(stream->lock);
+
+	//take over whatever the I/O thread finished since the last frame
+	int num_completed = array_length(stream->completed);
+	for (int i = 0; i < num_completed; i++) {
+		cluster_lod_t* level = &stream->lods[stream->completed[i]];
+		if (level->vertices) {
+			level->state = CLUSTER_RESIDENT;
+			level->last_used_frame = stream->frame;
+			stream->resident_bytes += level->bytes;
+		}
+		else {
+			//a truncated or corrupt file would fail again, the other levels stand in for it
+			level->state = CLUSTER_FAILED;
+		}
+	}
+	array_free(stream->completed);
+	stream->completed = NULL;
+
+	int* selection = NULL;
+	cluster_request_t* wanted = NULL;
+	size_t bytes_in_use = 0;
+	float pixels_per_unit = (camera.viewport_height * 0.5f) / tanf(camera.fov * 0.5f);
+
+	for (int c = 0; c < stream->num_clusters; c++) {
+		cluster_header_t* header = &stream->headers[c];
+		cluster_lod_t* levels = &stream->lods[c * CLUSTER_LODS];
+
+		vec4_t world_center;
+		mat4_transform_points_affine(world_matrix, &header->center, &world_center, 1);
+		vec3_t center = vec3_from_vec4(world_center);
+		float radius = header->radius * max_scale;
+		if (!camera_sphere_visible(&camera, center, radius)) {
+			continue;
+		}
+
+		float distance = vec3_length(vec3_sub(center, camera.position));
+		float pixels = distance > radius ? radius * pixels_per_unit / distance : FLT_MAX;
+		int desired = pixels > CLUSTER_LOD0_PIXELS ? 0 : (pixels > CLUSTER_LOD1_PIXELS ? 1 : 2);
+
+		//closest resident level, the coarser one first when two are equally close
+		int drawn = -1;
+		for (int d = 0; d < CLUSTER_LODS && drawn < 0; d++) {
+			if (desired + d < CLUSTER_LODS && levels[desired + d].state == CLUSTER_RESIDENT) {
+				drawn = desired + d;
+			}
+			else if (desired - d >= 0 && levels[desired - d].state == CLUSTER_RESIDENT) {
+				drawn = desired - d;
+			}
+		}
+		if (drawn >= 0) {
+			array_push(selection, c * CLUSTER_LODS + drawn);
+			levels[drawn].last_used_frame = stream->frame;
+			bytes_in_use += levels[drawn].bytes;
+		}
+
+		if (drawn != desired) {
+			//with nothing resident the coarsest level that can be read comes first, so the
+			//cluster shows up quickly
+			int lod = desired;
+			if (drawn < 0) {
+				lod = CLUSTER_LODS - 1;
+				while (lod > 0 && levels[lod].state == CLUSTER_FAILED) {
+					lod--;
+				}
+			}
+			if (levels[lod].state == CLUSTER_NOT_RESIDENT || levels[lod].state == CLUSTER_QUEUED) {
+				cluster_request_t request = { c * CLUSTER_LODS + lod, drawn < 0 ? FLT_MAX : pixels };
+				array_push(wanted, request);
+			}
+		}
+	}
+
+	//least recently used levels go first, the ones drawn this frame stay
+	while (stream->resident_bytes > stream->memory_budget) {
+		int oldest = -1;
+		for (int i = 0; i < stream->num_clusters * CLUSTER_LODS; i++) {
+			cluster_lod_t* level = &stream->lods[i];
+			if (level->state == CLUSTER_RESIDENT && level->last_used_frame != stream->frame
+				&& (oldest < 0 || level->last_used_frame < stream->lods[oldest].last_used_frame)) {
+				oldest = i;
+			}
+		}
+		if (oldest < 0) {
+			break;
+		}
+		stream->resident_bytes -= stream->lods[oldest].bytes;
+		free_level(&stream->lods[oldest]);
+		stream->lods[oldest].state = CLUSTER_NOT_RESIDENT;
+	}
+
+	//the queue is rebuilt every frame, so requests the view moved away from are dropped
+	for (int i = stream->next_request; i < array_length(stream->requests); i++) {
+		if (stream->lods[stream->requests[i]].state == CLUSTER_QUEUED) {
+			stream->lods[stream->requests[i]].state = CLUSTER_NOT_RESIDENT;
+		}
+	}
+	array_free(stream->requests);
+	stream->requests = NULL;
+	stream->next_request = 0;
+
+	int num_wanted = array_length(wanted);
+	if (num_wanted > 0) {
+		qsort(wanted, num_wanted, sizeof(cluster_request_t), compare_requests);
+	}
+	//the level the I/O thread is reading right now arrives on top of what gets queued
+	size_t bytes_planned = bytes_in_use;
+	for (int i = 0; i < stream->num_clusters * CLUSTER_LODS; i++) {
+		if (stream->lods[i].state == CLUSTER_LOADING) {
+			bytes_planned += estimate_level_bytes(&stream->headers[i / CLUSTER_LODS].lods[i % CLUSTER_LODS]);
+		}
+	}
+	for (int i = 0; i < num_wanted; i++) {
+		int key = wanted[i].key;
+		size_t bytes = estimate_level_bytes(&stream->headers[key / CLUSTER_LODS].lods[key % CLUSTER_LODS]);
+		if (bytes_planned + bytes > stream->memory_budget) {
+			continue;
+		}
+		bytes_planned += bytes;
+		stream->lods[key].state = CLUSTER_QUEUED;
+		array_push(stream->requests, key);
+	}
+	if (array_length(stream->requests) > 0) {
+		SDL_CondSignal(stream->request_available);
+	}
+	SDL_UnlockMutex(stream->lock);
+	array_free(wanted);
+
+	int num_selected = array_length(selection);
+	stream->selection_changed = num_selected != array_length(stream->selection)
+		|| (num_selected > 0 && memcmp(selection, stream->selection, sizeof(int) * num_selected) != 0);
+	array_free(stream->selection);
+	stream->selection = selection;
+}
+
+//copies the levels selected by the last update into one mesh for the regular pipeline
+void cluster_stream_assemble(cluster_stream_t* stream, mesh_t* m) {
+	int num_selected = array_length(stream->selection);
+	int num_vertices = 0;
+	int num_faces = 0;
+	int num_edges = 0;
+	for (int i = 0; i < num_selected; i++) {
+		cluster_lod_t* level = &stream->lods[stream->selection[i]];
+		num_vertices += array_length(level->vertices);
+		num_faces += array_length(level->faces);
+		num_edges += array_length(level->edges);
+	}
+
+	array_free(m->vertices);
+	array_free(m->faces);
+	array_free(m->edges);
+	m->vertices = (vec3_t*)array_hold(NULL, num_vertices, sizeof(vec3_t));
+	m->faces = (face_t*)array_hold(NULL, num_faces, sizeof(face_t));
+	m->edges = (mesh_edge_t*)array_hold(NULL, num_edges, sizeof(mesh_edge_t));
+
+	int vertex_base = 0;
+	int face_base = 0;
+	int edge_base = 0;
+	for (int i = 0; i < num_selected; i++) {
+		cluster_lod_t* level = &stream->lods[stream->selection[i]];
+		int level_vertices = array_length(level->vertices);
+		int level_faces = array_length(level->faces);
+		int level_edges = array_length(level->edges);
+
+		memcpy(m->vertices + vertex_base, level->vertices, sizeof(vec3_t) * level_vertices);
+		for (int f = 0; f < level_faces; f++) {
+			face_t face = level->faces[f];
+			face.a += vertex_base;
+			face.b += vertex_base;
+			face.c += vertex_base;
+			m->faces[face_base + f] = face;
+		}
+		for (int e = 0; e < level_edges; e++) {
+			mesh_edge_t edge = level->edges[e];
+			edge.a += vertex_base;
+			edge.b += vertex_base;
+			edge.faces[0] += face_base;
+			if (edge.faces[1] >= 0) {
+				edge.faces[1] += face_base;
+			}
+			m->edges[edge_base + e] = edge;
+		}
+
+		vertex_base += level_vertices;
+		face_base += level_faces;
+		edge_base += level_edges;
+	}
+
+	m->bounds_center = stream->bounds_center;
+	m->bounds_radius = stream->bounds_radius;
+}
+
+void cluster_stream_close(cluster_stream_t* stream) {
+	if (!stream) {
+		return;
+	}
+	if (stream->thread) {
+		SDL_LockMutex(stream->lock);
+		stream->stopping = true;
+		SDL_CondSignal(stream->request_available);
+		SDL_UnlockMutex(stream->lock);
+		SDL_WaitThread(stream->thread, NULL);
+	}
+
+	//resident levels and loads the main thread never picked up
+	for (int i = 0; stream->lods && i < stream->num_clusters * CLUSTER_LODS; i++) {
+		free_level(&stream->lods[i]);
+	}
+	array_free(stream->selection);
+	array_free(stream->requests);
+	array_free(stream->completed);
+	if (stream->request_available) {
+		SDL_DestroyCond(stream->request_available);
+	}
+	if (stream->lock) {
+		SDL_DestroyMutex(stream->lock);
+	}
+	if (stream->file) {
+		fclose(stream->file);
+	}
+	free(stream->lods);
+	free(stream->headers);
+	free(stream);
+}
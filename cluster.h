@@ -0,0 +1,92 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL.h>
+#include "vector.h"
+#include "matrix.h"
+#include "triangle.h"
+#include "mesh.h"
+
+//level 0 is the full cluster, every following level is simplified further
+#define CLUSTER_LODS 3
+#define CLUSTER_DEFAULT_FACES 4096
+#define CLUSTER_DEFAULT_BUDGET_MB 256
+
+//a clustered mesh file (.clu) is a cluster_file_header_t, a cluster_header_t for every
+//cluster and then the geometry of every level of detail: vertices (vec3_t) followed by
+//faces (face_t, 1 based indices into the vertices of the same level). little endian
+typedef struct {
+	char magic[4]; //"CLU1"
+	uint32_t num_clusters;
+	vec3_t bounds_center;
+	float bounds_radius;
+} cluster_file_header_t;
+
+typedef struct {
+	uint64_t offset;
+	uint32_t num_vertices;
+	uint32_t num_faces;
+} cluster_lod_header_t;
+
+typedef struct {
+	vec3_t center;
+	float radius;
+	cluster_lod_header_t lods[CLUSTER_LODS];
+} cluster_header_t;
+
+enum {
+	CLUSTER_NOT_RESIDENT,
+	CLUSTER_QUEUED,
+	CLUSTER_LOADING,
+	CLUSTER_RESIDENT,
+	CLUSTER_FAILED //could not be read, it is never asked for again
+};
+
+//geometry of one level of one cluster, the arrays belong to the I/O thread while
+//the state is CLUSTER_LOADING and to the main thread once it is CLUSTER_RESIDENT
+typedef struct {
+	int state;
+	vec3_t* vertices;
+	face_t* faces;
+	mesh_edge_t* edges;
+	size_t bytes;
+	unsigned int last_used_frame;
+} cluster_lod_t;
+
+//keeps the clusters of one file resident within a memory budget, loading the ones the
+//camera needs on a background thread and evicting the least recently used ones
+typedef struct {
+	FILE* file; //only used by the I/O thread after opening
+	int num_clusters;
+	cluster_header_t* headers;
+	cluster_lod_t* lods; //num_clusters * CLUSTER_LODS, indexed by cluster * CLUSTER_LODS + lod
+	vec3_t bounds_center;
+	float bounds_radius;
+
+	size_t memory_budget;
+	size_t resident_bytes;
+	unsigned int frame;
+	int* selection; //dynamic array of the levels drawn this frame
+	bool selection_changed;
+
+	SDL_Thread* thread;
+	SDL_mutex* lock;
+	SDL_cond* request_available;
+	int* requests; //dynamic array in priority order, requests before next_request are taken
+	int next_request;
+	int* completed; //finished (or failed) loads waiting for the main thread
+	bool stopping;
+} cluster_stream_t;
+
+bool cluster_build_file(char* obj_filename, const char* cluster_filename, int max_faces_per_cluster);
+
+cluster_stream_t* cluster_stream_open(const char* filename, size_t memory_budget);
+void cluster_stream_update(cluster_stream_t* stream, const mat4_t* world_matrix, float max_scale);
+void cluster_stream_assemble(cluster_stream_t* stream, mesh_t* m);
+void cluster_stream_close(cluster_stream_t* stream);
+
+#endif
@@ -0,0 +1,229 @@
+#include <math.h>
+#include "color.h"
+
+static float srgb_to_linear[256];
+static uint8_t linear_to_srgb[COLOR_LINEAR_STEPS];
+
+//fills the sRGB conversion tables, has to run once before any of the _srgb functions
+void color_init(void) {
+	for (int i = 0; i < 256; i++) {
+		float c = i / 255.0f;
+		srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+	for (int i = 0; i < COLOR_LINEAR_STEPS; i++) {
+		float l = i / (float)(COLOR_LINEAR_STEPS - 1);
+		float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+		linear_to_srgb[i] = (uint8_t)lrintf(c * 255.0f);
+	}
+}
+
+//scales red, green and blue, negative intensities give black and channels stop at 255.
+//alpha is kept as it is
+uint32_t color_modulate(uint32_t color, float intensity) {
+	if (!(intensity > 0.0f)) {
+		intensity = 0.0f;
+	}
+	uint32_t result = color & 0xFF000000;
+	for (int shift = 0; shift < 24; shift += 8) {
+		float channel = ((color >> shift) & 0xFF) * intensity;
+		result |= (channel >= 255.0f ? 255u : (uint32_t)channel) << shift;
+	}
+	return result;
+}
+
+//the same in linear light, the color is taken as sRGB and the result converted back to it
+uint32_t color_modulate_srgb(uint32_t color, float intensity) {
+	if (!(intensity > 0.0f)) {
+		intensity = 0.0f;
+	}
+	uint32_t result = color & 0xFF000000;
+	for (int shift = 0; shift < 24; shift += 8) {
+		float linear = srgb_to_linear[(color >> shift) & 0xFF] * intensity;
+		int index = linear >= 1.0f ? COLOR_LINEAR_STEPS - 1 : (int)lrintf(linear * (COLOR_LINEAR_STEPS - 1));
+		result |= (uint32_t)linear_to_srgb[index] << shift;
+	}
+	return result;
+}
+
+//(x + 128 + ((x + 128) >> 8)) >> 8 is x / 255 rounded, exact for every product of two bytes
+static uint32_t div255(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+//source over destination by the source alpha
+uint32_t color_blend(uint32_t destination, uint32_t source) {
+	uint32_t alpha = source >> 24;
+	uint32_t inverse = 255 - alpha;
+	uint32_t result = 0;
+	for (int shift = 0; shift < 24; shift += 8) {
+		uint32_t channel = div255(((source >> shift) & 0xFF) * alpha + ((destination >> shift) & 0xFF) * inverse);
+		result |= channel << shift;
+	}
+	uint32_t result_alpha = alpha + div255((destination >> 24) * inverse);
+	return result | (result_alpha << 24);
+}
+
+uint32_t color_add_saturate(uint32_t a, uint32_t b) {
+	uint32_t result = 0;
+	for (int shift = 0; shift < 32; shift += 8) {
+		uint32_t channel = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF);
+		result |= (channel > 255 ? 255 : channel) << shift;
+	}
+	return result;
+}
+
+//mixes color into the pixel by coverage (0 - 256), red and blue share one multiply
+//and green gets the other, so one pixel costs two multiplies instead of three
+uint32_t color_mix(uint32_t destination, uint32_t color, uint32_t coverage) {
+	uint32_t inverse = 256 - coverage;
+	uint32_t rb = (((color & 0x00FF00FF) * coverage + (destination & 0x00FF00FF) * inverse) >> 8) & 0x00FF00FF;
+	uint32_t g = (((color & 0x0000FF00) * coverage + (destination & 0x0000FF00) * inverse) >> 8) & 0x0000FF00;
+	return 0xFF000000 | rb | g;
+}
+
+void color_modulate_n(const uint32_t* colors, const float* RESTRICT intensities, uint32_t* out, int count) {
+	int i = 0;
+#if USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128 max_channel = _mm_set1_ps(255.0f);
+	__m128 zero_ps = _mm_setzero_ps();
+	//alpha is multiplied by one
+	__m128 alpha_one = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, 0x3F800000));
+	__m128 rgb_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(colors + i));
+		//max_ps returns its second operand for NaN, so those end up black as well
+		__m128 intensity = _mm_max_ps(_mm_loadu_ps(intensities + i), zero_ps);
+
+		__m128i low = _mm_unpacklo_epi8(pixels, zero);
+		__m128i high = _mm_unpackhi_epi8(pixels, zero);
+		__m128i channels[4] = {
+			_mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+			_mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)
+		};
+		__m128 factors[4] = {
+			_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(0, 0, 0, 0)),
+			_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(1, 1, 1, 1)),
+			_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(2, 2, 2, 2)),
+			_mm_shuffle_ps(intensity, intensity, _MM_SHUFFLE(3, 3, 3, 3))
+		};
+		for (int j = 0; j < 4; j++) {
+			__m128 factor = _mm_or_ps(_mm_and_ps(factors[j], rgb_mask), alpha_one);
+			__m128 scaled = _mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(channels[j]), factor), max_channel);
+			channels[j] = _mm_cvttps_epi32(scaled);
+		}
+
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(channels[0], channels[1]), _mm_packs_epi32(channels[2], channels[3]));
+		_mm_storeu_si128((__m128i*)(out + i), packed);
+	}
+#endif
+	for (; i < count; i++) {
+		out[i] = color_modulate(colors[i], intensities[i]);
+	}
+}
+
+//the table lookups stay scalar, the light math in between runs on four colors at once
+void color_modulate_srgb_n(const uint32_t* colors, const float* RESTRICT intensities, uint32_t* out, int count) {
+	int i = 0;
+#if USE_SSE2
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 steps = _mm_set1_ps((float)(COLOR_LINEAR_STEPS - 1));
+	for (; i + 4 <= count; i += 4) {
+		__m128 intensity = _mm_max_ps(_mm_loadu_ps(intensities + i), zero);
+		ALIGN16 int32_t indices[3][4];
+		for (int channel = 0; channel < 3; channel++) {
+			int shift = channel * 8;
+			__m128 linear = _mm_setr_ps(
+				srgb_to_linear[(colors[i] >> shift) & 0xFF],
+				srgb_to_linear[(colors[i + 1] >> shift) & 0xFF],
+				srgb_to_linear[(colors[i + 2] >> shift) & 0xFF],
+				srgb_to_linear[(colors[i + 3] >> shift) & 0xFF]);
+			linear = _mm_min_ps(_mm_mul_ps(linear, intensity), one);
+			_mm_store_si128((__m128i*)indices[channel], _mm_cvtps_epi32(_mm_mul_ps(linear, steps)));
+		}
+		for (int j = 0; j < 4; j++) {
+			out[i + j] = (colors[i + j] & 0xFF000000) |
+				((uint32_t)linear_to_srgb[indices[2][j]] << 16) |
+				((uint32_t)linear_to_srgb[indices[1][j]] << 8) |
+				(uint32_t)linear_to_srgb[indices[0][j]];
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		out[i] = color_modulate_srgb(colors[i], intensities[i]);
+	}
+}
+
+void color_blend_n(uint32_t* RESTRICT destination, const uint32_t* RESTRICT source, int count) {
+	int i = 0;
+#if USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i max_channel = _mm_set1_epi16(255);
+	__m128i round = _mm_set1_epi16(128);
+	//the alpha of the result is source alpha * 255 + destination alpha * (255 - source alpha)
+	__m128i rgb_mask = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+	__m128i alpha_max = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+	for (; i + 4 <= count; i += 4) {
+		__m128i src = _mm_loadu_si128((const __m128i*)(source + i));
+		__m128i dst = _mm_loadu_si128((const __m128i*)(destination + i));
+		__m128i halves[2];
+		for (int half = 0; half < 2; half++) {
+			__m128i s = half == 0 ? _mm_unpacklo_epi8(src, zero) : _mm_unpackhi_epi8(src, zero);
+			__m128i d = half == 0 ? _mm_unpacklo_epi8(dst, zero) : _mm_unpackhi_epi8(dst, zero);
+			__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i inverse = _mm_sub_epi16(max_channel, alpha);
+			__m128i source_factor = _mm_or_si128(_mm_and_si128(alpha, rgb_mask), alpha_max);
+			__m128i sum = _mm_add_epi16(_mm_mullo_epi16(s, source_factor), _mm_mullo_epi16(d, inverse));
+			//sum is at most 255 * 255, the rounded division by 255 stays within 16 bits
+			sum = _mm_add_epi16(sum, round);
+			halves[half] = _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_epi16(sum, 8)), 8);
+		}
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_packus_epi16(halves[0], halves[1]));
+	}
+#endif
+	for (; i < count; i++) {
+		destination[i] = color_blend(destination[i], source[i]);
+	}
+}
+
+void color_add_saturate_n(uint32_t* RESTRICT destination, const uint32_t* RESTRICT source, int count) {
+	int i = 0;
+#if USE_SSE2
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(destination + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(source + i));
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_adds_epu8(a, b));
+	}
+#endif
+	for (; i < count; i++) {
+		destination[i] = color_add_saturate(destination[i], source[i]);
+	}
+}
+
+//four samples per pixel, every channel is the truncated mean of its samples
+void color_average_samples_n(const uint32_t* RESTRICT samples, uint32_t* RESTRICT out, int count) {
+	int i = 0;
+#if USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4) {
+		__m128i sums[4];
+		for (int j = 0; j < 4; j++) {
+			__m128i pixel = _mm_loadu_si128((const __m128i*)(samples + (i + j) * 4));
+			//samples 0 + 2 and 1 + 3 side by side, then the two halves added
+			__m128i sum = _mm_add_epi16(_mm_unpacklo_epi8(pixel, zero), _mm_unpackhi_epi8(pixel, zero));
+			sums[j] = _mm_srli_epi16(_mm_add_epi16(sum, _mm_unpackhi_epi64(sum, sum)), 2);
+		}
+		__m128i low = _mm_unpacklo_epi64(sums[0], sums[1]);
+		__m128i high = _mm_unpacklo_epi64(sums[2], sums[3]);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(low, high));
+	}
+#endif
+	for (; i < count; i++) {
+		const uint32_t* s = samples + i * 4;
+		uint32_t rb = (s[0] & 0x00FF00FF) + (s[1] & 0x00FF00FF) + (s[2] & 0x00FF00FF) + (s[3] & 0x00FF00FF);
+		uint32_t ag = ((s[0] >> 8) & 0x00FF00FF) + ((s[1] >> 8) & 0x00FF00FF) + ((s[2] >> 8) & 0x00FF00FF) + ((s[3] >> 8) & 0x00FF00FF);
+		out[i] = ((rb >> 2) & 0x00FF00FF) | (((ag >> 2) & 0x00FF00FF) << 8);
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+#include "simd.h"
+
+//packed ARGB8888 math, every channel saturates instead of spilling into its neighbor.
+//the _n versions work on whole spans, four pixels per step with SSE2. the modulate
+//spans may write over their input, the others need separate arrays
+
+//entries of the table going from linear light back to sRGB
+#define COLOR_LINEAR_STEPS 4096
+
+void color_init(void);
+
+uint32_t color_modulate(uint32_t color, float intensity);
+uint32_t color_modulate_srgb(uint32_t color, float intensity);
+uint32_t color_blend(uint32_t destination, uint32_t source);
+uint32_t color_add_saturate(uint32_t a, uint32_t b);
+uint32_t color_mix(uint32_t destination, uint32_t color, uint32_t coverage);
+
+void color_modulate_n(const uint32_t* colors, const float* RESTRICT intensities, uint32_t* out, int count);
+void color_modulate_srgb_n(const uint32_t* colors, const float* RESTRICT intensities, uint32_t* out, int count);
+void color_blend_n(uint32_t* RESTRICT destination, const uint32_t* RESTRICT source, int count);
+void color_add_saturate_n(uint32_t* RESTRICT destination, const uint32_t* RESTRICT source, int count);
+void color_average_samples_n(const uint32_t* RESTRICT samples, uint32_t* RESTRICT out, int count);
+
+#endif
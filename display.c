@@ -1,13 +1,46 @@
+#include <string.h>
 #include "display.h"
+#include "color.h"
+#include "simd.h"
+#include "profiler.h"
 
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
 SDL_Texture* color_buffer_texture = NULL;
 uint32_t* color_buffer = NULL;
+float* depth_buffer = NULL;
+
+//MSAA_SAMPLES entries per pixel, stored next to each other
+uint32_t* msaa_color_buffer = NULL;
+float* msaa_depth_buffer = NULL;
+//set while a frame renders into the multisample buffers instead of color_buffer
+bool msaa_active = false;
+
+//writes per pixel in the overdraw display mode, saturates at 255
+uint8_t* overdraw_buffer = NULL;
+
+const uint32_t overdraw_palette[OVERDRAW_LEVELS] = {
+	0xFF000000, 0xFF00007F, 0xFF0000FF, 0xFF00FFFF, 0xFF00FF00,
+	0xFFFFFF00, 0xFFFF7F00, 0xFFFF0000, 0xFFFFFFFF
+};
+
+//weighted blended order independent transparency: every pixel sums its transparent
+//fragments as weighted premultiplied colors (blue, green, red, alpha like the bytes of
+//a pixel) and multiplies their transparencies into the revealage, the order never matters
+float* oit_accum_buffer = NULL;
+float* oit_revealage_buffer = NULL;
 
 int window_width = 800;
 int window_height = 800;
 
+//size of the window and of every buffer, window_width and window_height are the part of
+//the buffers being rendered to, smaller than this with dynamic resolution
+int output_width = 800;
+int output_height = 800;
+
+//every draw function only touches pixels inside of this rectangle (scissor)
+rect_t clip_rect = { 0, 0, 800, 800 };
+
 bool initialize_window(void) {
 	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
 		fprintf(stderr, "Error initializing SDL.\n");
@@ -17,8 +50,7 @@ bool initialize_window(void) {
 	SDL_DisplayMode display_info;
 	SDL_GetCurrentDisplayMode(0, &display_info);
 
-	window_width = display_info.w;
-	window_height = display_info.h;
+	set_output_size(display_info.w, display_info.h);
 	printf("your refresh rate is: %d", display_info.refresh_rate);
 
 	window = SDL_CreateWindow(
@@ -47,18 +79,87 @@ bool initialize_window(void) {
 	return true;
 }
 
+//the sample buffers are only created the first time multisampling gets turned on
+bool allocate_msaa_buffers(void) {
+	if (msaa_color_buffer && msaa_depth_buffer) {
+		return true;
+	}
+	msaa_color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * MSAA_SAMPLES * output_width * output_height);
+	msaa_depth_buffer = (float*)malloc(sizeof(float) * MSAA_SAMPLES * output_width * output_height);
+	if (!msaa_color_buffer || !msaa_depth_buffer) {
+		fprintf(stderr, "Error creating the multisample buffers. Probably not enough avaliable memory.\n");
+		free(msaa_color_buffer);
+		free(msaa_depth_buffer);
+		msaa_color_buffer = NULL;
+		msaa_depth_buffer = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool allocate_overdraw_buffer(void) {
+	if (overdraw_buffer) {
+		return true;
+	}
+	overdraw_buffer = (uint8_t*)calloc((size_t)output_width * output_height, sizeof(uint8_t));
+	if (!overdraw_buffer) {
+		fprintf(stderr, "Error creating the overdraw buffer. Probably not enough avaliable memory.\n");
+		return false;
+	}
+	return true;
+}
+
+bool allocate_oit_buffers(void) {
+	if (oit_accum_buffer && oit_revealage_buffer) {
+		return true;
+	}
+	oit_accum_buffer = (float*)malloc(sizeof(float) * 4 * output_width * output_height);
+	oit_revealage_buffer = (float*)malloc(sizeof(float) * output_width * output_height);
+	if (!oit_accum_buffer || !oit_revealage_buffer) {
+		fprintf(stderr, "Error creating the transparency buffers. Probably not enough avaliable memory.\n");
+		free(oit_accum_buffer);
+		free(oit_revealage_buffer);
+		oit_accum_buffer = NULL;
+		oit_revealage_buffer = NULL;
+		return false;
+	}
+	return true;
+}
+
+//full resolution rendering into buffers of this size
+void set_output_size(int width, int height) {
+	output_width = width;
+	output_height = height;
+	window_width = width;
+	window_height = height;
+	reset_clip_rect();
+}
+
+void set_clip_rect(rect_t r) {
+	clip_rect = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+}
+
+void reset_clip_rect(void) {
+	clip_rect = rect_make(0, 0, window_width, window_height);
+}
+
+//clipped once up front, so the rows are filled without testing every pixel
 void draw_rectangle(int x, int y, int height, int width, uint32_t color) {
-	for (int row = y; row < height + y; row++) {
-		for (int col = x; col < width + x; col++) {
-			//color_buffer[(window_width * row) + col] = color;
-			draw_pixel(col, row, color);
+	rect_t r = rect_intersect(rect_make(x, y, width, height), clip_rect);
+	for (int row = r.y0; row < r.y1; row++) {
+		uint32_t* pixels = color_buffer + window_width * row;
+		for (int col = r.x0; col < r.x1; col++) {
+			pixels[col] = color;
+			PROFILE_PIXEL(window_width * row + col);
 		}
 	}
 }
 
 void draw_pixel(int x, int y, uint32_t color) {
-	if (x >= 0 && x < window_width && y >= 0 && y < window_height)
+	if (x >= clip_rect.x0 && x < clip_rect.x1 && y >= clip_rect.y0 && y < clip_rect.y1) {
 		color_buffer[window_width * y + x] = color;
+		PROFILE_PIXEL(window_width * y + x);
+	}
 }
 
 //DDA
@@ -95,8 +196,10 @@ void draw_line_bresenham(int x0, int y0, int x1, int y1, uint32_t color) {
 
 		//draw_pixel function body copied here to avoid sending the same color value
 		//every time for efficiency purposes
-		if (x0 >= 0 && x0 < window_width && y0 >= 0 && y0 < window_height)
+		if (x0 >= clip_rect.x0 && x0 < clip_rect.x1 && y0 >= clip_rect.y0 && y0 < clip_rect.y1) {
 			color_buffer[window_width * y0 + x0] = color;
+			PROFILE_PIXEL(window_width * y0 + x0);
+		}
 
 		if (x0 == x1 && y0 == y1) {
 			break;
@@ -120,18 +223,27 @@ void draw_line_bresenham(int x0, int y0, int x1, int y1, uint32_t color) {
 }
 
 //for flat top flat bottom triangle rasterization
+//the span is clipped against the clip rectangle once, so the loop itself needs no checks
 void draw_horizontal_line(int x0, int y0, int x1, uint32_t color) {
-	if (x0 < x1) {
-		for (x0; x0 <= x1; ++x0) {
-			if (x0 >= 0 && x0 < window_width && y0 >= 0 && y0 < window_height)
-				color_buffer[window_width * y0 + x0] = color;
-		}
+	if (y0 < clip_rect.y0 || y0 >= clip_rect.y1) {
+		return;
 	}
-	else {
-		for (x1; x1 <= x0; ++x1) {
-			if (x1 >= 0 && x1 < window_width && y0 >= 0 && y0 < window_height)
-				color_buffer[window_width * y0 + x1] = color;
-		}
+	if (x0 > x1) {
+		int temp = x0;
+		x0 = x1;
+		x1 = temp;
+	}
+	if (x0 < clip_rect.x0) {
+		x0 = clip_rect.x0;
+	}
+	if (x1 >= clip_rect.x1) {
+		x1 = clip_rect.x1 - 1;
+	}
+
+	uint32_t* row = color_buffer + window_width * y0;
+	for (int x = x0; x <= x1; ++x) {
+		row[x] = color;
+		PROFILE_PIXEL(window_width * y0 + x);
 	}
 }
 
@@ -167,25 +279,251 @@ void draw_diagonal_line(int x0, int y0, int x1, int y1, uint32_t color) {
 
 
 
-void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color) {
-	draw_pixel(x0, y0, color);
-	draw_pixel(x1, y1, color);
-	draw_pixel(x2, y2, color);
-	draw_line_bresenham(x0, y0, x1, y1, color);
-	draw_line_bresenham(x1, y1, x2, y2, color);
-	draw_line_bresenham(x2, y2, x0, y0, color);
+//Cohen-Sutherland outcodes against the clip rectangle in fixed point
+#define OUTCODE_LEFT 1
+#define OUTCODE_RIGHT 2
+#define OUTCODE_TOP 4
+#define OUTCODE_BOTTOM 8
+
+static int compute_outcode(vec2_fixed_t p, fixed_t min_x, fixed_t min_y, fixed_t max_x, fixed_t max_y) {
+	int code = 0;
+	if (p.x < min_x) code |= OUTCODE_LEFT;
+	else if (p.x > max_x) code |= OUTCODE_RIGHT;
+	if (p.y < min_y) code |= OUTCODE_TOP;
+	else if (p.y > max_y) code |= OUTCODE_BOTTOM;
+	return code;
+}
+
+//cuts the line down to the part inside of the clip rectangle before any pixel is touched,
+//returns false when nothing of the line is visible
+bool clip_line_fixed(vec2_fixed_t* p0, vec2_fixed_t* p1) {
+	fixed_t min_x = fixed_from_int(clip_rect.x0);
+	fixed_t min_y = fixed_from_int(clip_rect.y0);
+	fixed_t max_x = fixed_from_int(clip_rect.x1) - 1;
+	fixed_t max_y = fixed_from_int(clip_rect.y1) - 1;
+	if (min_x > max_x || min_y > max_y) {
+		return false;
+	}
+
+	int code0 = compute_outcode(*p0, min_x, min_y, max_x, max_y);
+	int code1 = compute_outcode(*p1, min_x, min_y, max_x, max_y);
+
+	while (code0 | code1) {
+		if (code0 & code1) {
+			return false;
+		}
+
+		int code = code0 ? code0 : code1;
+		int64_t dx = (int64_t)p1->x - p0->x;
+		int64_t dy = (int64_t)p1->y - p0->y;
+		vec2_fixed_t p;
+		if (code & OUTCODE_TOP) {
+			p.x = (fixed_t)(p0->x + dx * (min_y - p0->y) / dy);
+			p.y = min_y;
+		}
+		else if (code & OUTCODE_BOTTOM) {
+			p.x = (fixed_t)(p0->x + dx * (max_y - p0->y) / dy);
+			p.y = max_y;
+		}
+		else if (code & OUTCODE_LEFT) {
+			p.y = (fixed_t)(p0->y + dy * (min_x - p0->x) / dx);
+			p.x = min_x;
+		}
+		else {
+			p.y = (fixed_t)(p0->y + dy * (max_x - p0->x) / dx);
+			p.x = max_x;
+		}
+
+		//integer rounding can leave the new point a sub pixel step outside
+		if (p.x < min_x) p.x = min_x;
+		if (p.x > max_x) p.x = max_x;
+		if (p.y < min_y) p.y = min_y;
+		if (p.y > max_y) p.y = max_y;
+
+		if (code == code0) {
+			*p0 = p;
+			code0 = compute_outcode(*p0, min_x, min_y, max_x, max_y);
+		}
+		else {
+			*p1 = p;
+			code1 = compute_outcode(*p1, min_x, min_y, max_x, max_y);
+		}
+	}
+	return true;
+}
+
+//shared setup of the fixed point line functions: the line is turned into an x major line
+//going right (y major lines get their axes swapped), the minor axis position is kept
+//with 16 extra fraction bits at the center of the first pixel
+typedef struct {
+	bool x_major;
+	fixed_t major0, major1;
+	int start, end;
+	int64_t minor;
+	int64_t minor_step;
+	int64_t minor_min, minor_max;
+} line_setup_t;
+
+static void line_setup(vec2_fixed_t p0, vec2_fixed_t p1, line_setup_t* line) {
+	int64_t dx = (int64_t)p1.x - p0.x;
+	int64_t dy = (int64_t)p1.y - p0.y;
+
+	line->x_major = (dx < 0 ? -dx : dx) >= (dy < 0 ? -dy : dy);
+
+	fixed_t major0 = line->x_major ? p0.x : p0.y;
+	fixed_t minor0 = line->x_major ? p0.y : p0.x;
+	fixed_t major1 = line->x_major ? p1.x : p1.y;
+	fixed_t minor1 = line->x_major ? p1.y : p1.x;
+	if (major0 > major1) {
+		fixed_t temp = major0; major0 = major1; major1 = temp;
+		temp = minor0; minor0 = minor1; minor1 = temp;
+	}
+
+	int64_t slope = major1 != major0 ? ((int64_t)minor1 - minor0) * 65536 / ((int64_t)major1 - major0) : 0;
+
+	line->major0 = major0;
+	line->major1 = major1;
+	line->start = fixed_floor_to_int(major0);
+	line->end = fixed_floor_to_int(major1);
+	line->minor = (int64_t)minor0 * 65536 + ((int64_t)fixed_pixel_center(line->start) - major0) * slope;
+	line->minor_step = slope * FIXED_ONE;
+	line->minor_min = (int64_t)(minor0 < minor1 ? minor0 : minor1) * 65536;
+	line->minor_max = (int64_t)(minor0 > minor1 ? minor0 : minor1) * 65536;
 }
 
+//line drawing on 28.4 fixed point end points, walks the pixel centers along the major
+//axis, integer only and without per pixel bounds checks since the line is clipped up front.
+//msaa lines cover the whole pixel, so every sample gets the color
+static FORCE_INLINE void line_fixed(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color, bool msaa) {
+	if (!clip_line_fixed(&p0, &p1)) {
+		return;
+	}
+
+	line_setup_t line;
+	line_setup(p0, p1, &line);
+
+	int64_t minor = line.minor;
+	for (int major = line.start; major <= line.end; major++) {
+		int64_t clamped = minor < line.minor_min ? line.minor_min : (minor > line.minor_max ? line.minor_max : minor);
+		int minor_pixel = (int)(clamped >> (16 + FIXED_SHIFT));
+		int index = line.x_major ? window_width * minor_pixel + major : window_width * major + minor_pixel;
+		if (msaa) {
+			for (int sample = 0; sample < MSAA_SAMPLES; sample++)
+				msaa_color_buffer[index * MSAA_SAMPLES + sample] = color;
+		}
+		else {
+			color_buffer[index] = color;
+		}
+		PROFILE_PIXEL(index);
+		minor += line.minor_step;
+	}
+}
+
+void draw_line_fixed(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color) {
+	line_fixed(p0, p1, color, false);
+}
+
+void draw_line_fixed_msaa(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color) {
+	line_fixed(p0, p1, color, true);
+}
+
+//Xiaolin Wu style anti-aliased line: every major axis step covers the two pixels
+//closest to the line, weighted by the distance of the line to their centers
+void draw_line_antialiased(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color) {
+	if (!clip_line_fixed(&p0, &p1)) {
+		return;
+	}
+
+	line_setup_t line;
+	line_setup(p0, p1, &line);
+
+	int minor_clip_start = line.x_major ? clip_rect.y0 : clip_rect.x0;
+	int minor_clip_end = line.x_major ? clip_rect.y1 - 1 : clip_rect.x1 - 1;
+	int minor_stride = line.x_major ? window_width : 1;
+	int major_stride = line.x_major ? 1 : window_width;
+
+	int64_t minor = line.minor;
+	for (int major = line.start; major <= line.end; major++) {
+		//the end pixels are only partly covered along the major axis
+		uint32_t major_coverage = 256;
+		if (major == line.start || major == line.end) {
+			fixed_t pixel_start = fixed_from_int(major);
+			fixed_t covered_start = line.major0 > pixel_start ? line.major0 : pixel_start;
+			fixed_t covered_end = line.major1 < pixel_start + FIXED_ONE ? line.major1 : pixel_start + FIXED_ONE;
+			major_coverage = covered_end > covered_start ? (covered_end - covered_start) * (256 / FIXED_ONE) : 256 / FIXED_ONE;
+		}
+
+		int64_t clamped = minor < line.minor_min ? line.minor_min : (minor > line.minor_max ? line.minor_max : minor);
+		//distance from the center of the upper (or left) pixel, 8 fraction bits
+		int64_t offset = clamped - (int64_t)FIXED_HALF * 65536;
+		int minor_pixel = (int)(offset >> (16 + FIXED_SHIFT));
+		uint32_t fraction = (uint32_t)((offset >> (16 + FIXED_SHIFT - 8)) & 0xFF);
+
+		uint32_t coverage_first = ((256 - fraction) * major_coverage) >> 8;
+		uint32_t coverage_second = (fraction * major_coverage) >> 8;
+
+		uint32_t* major_line = color_buffer + major * major_stride;
+		if (minor_pixel >= minor_clip_start && minor_pixel <= minor_clip_end) {
+			uint32_t* pixel = major_line + minor_pixel * minor_stride;
+			*pixel = color_mix(*pixel, color, coverage_first);
+			PROFILE_PIXEL((int)(pixel - color_buffer));
+		}
+		if (minor_pixel + 1 >= minor_clip_start && minor_pixel + 1 <= minor_clip_end) {
+			uint32_t* pixel = major_line + (minor_pixel + 1) * minor_stride;
+			*pixel = color_mix(*pixel, color, coverage_second);
+			PROFILE_PIXEL((int)(pixel - color_buffer));
+		}
+		minor += line.minor_step;
+	}
+}
+
+void draw_triangle(vec2_fixed_t p0, vec2_fixed_t p1, vec2_fixed_t p2, uint32_t color) {
+	line_fixed(p0, p1, color, false);
+	line_fixed(p1, p2, color, false);
+	line_fixed(p2, p0, color, false);
+}
+
+void draw_triangle_msaa(vec2_fixed_t p0, vec2_fixed_t p1, vec2_fixed_t p2, uint32_t color) {
+	line_fixed(p0, p1, color, true);
+	line_fixed(p1, p2, color, true);
+	line_fixed(p2, p0, color, true);
+}
+
+
+//shows the texture in the window, the rendered part gets stretched over the whole window
+//with the filtering the texture was created with
+void render_color_buffer_texture(void) {
+	SDL_Rect source = { 0, 0, window_width, window_height };
+	SDL_RenderCopy(renderer, color_buffer_texture, &source, NULL);
+}
 
 void render_color_buffer(void) {
+	SDL_Rect update_area = { 0, 0, window_width, window_height };
 	SDL_UpdateTexture(
 		color_buffer_texture,
-		NULL,
+		&update_area,
 		color_buffer,
 		(int)(window_width * sizeof(uint32_t))
 	);
 
-	SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL);
+	render_color_buffer_texture();
+}
+
+//uploads only the changed area, the rest of the texture keeps the previous frame
+void render_color_buffer_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+
+	if (!rect_is_empty(r)) {
+		SDL_Rect update_area = { r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0 };
+		SDL_UpdateTexture(
+			color_buffer_texture,
+			&update_area,
+			color_buffer + window_width * r.y0 + r.x0,
+			(int)(window_width * sizeof(uint32_t))
+		);
+	}
+
+	render_color_buffer_texture();
 }
 
 void clear_color_buffer(uint32_t color) {
@@ -196,6 +534,117 @@ void clear_color_buffer(uint32_t color) {
 	}
 }
 
+void clear_color_buffer_rect(rect_t r, uint32_t color) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		for (int col = r.x0; col < r.x1; col++) {
+			color_buffer[(window_width * row) + col] = color;
+		}
+	}
+}
+
+void clear_depth_buffer_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		for (int col = r.x0; col < r.x1; col++) {
+			depth_buffer[(window_width * row) + col] = 1.0f;
+		}
+	}
+}
+
+void clear_msaa_buffers_rect(rect_t r, uint32_t color) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		uint32_t* samples = msaa_color_buffer + (window_width * row + r.x0) * MSAA_SAMPLES;
+		float* sample_depths = msaa_depth_buffer + (window_width * row + r.x0) * MSAA_SAMPLES;
+		for (int i = 0; i < (r.x1 - r.x0) * MSAA_SAMPLES; i++) {
+			samples[i] = color;
+			sample_depths[i] = 1.0f;
+		}
+	}
+}
+
+//averages the samples of every pixel into color_buffer, a row at a time
+void resolve_msaa_buffer_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		uint32_t* samples = msaa_color_buffer + (window_width * row + r.x0) * MSAA_SAMPLES;
+		color_average_samples_n(samples, color_buffer + window_width * row + r.x0, r.x1 - r.x0);
+	}
+}
+
+void clear_overdraw_buffer_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		memset(overdraw_buffer + window_width * row + r.x0, 0, r.x1 - r.x0);
+	}
+}
+
+//turns the write counts into heatmap colors and adds every pixel of the area to its histogram bin
+void resolve_overdraw_heatmap_rect(rect_t r, int64_t histogram[OVERDRAW_LEVELS]) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		uint8_t* counts = overdraw_buffer + window_width * row;
+		uint32_t* pixels = color_buffer + window_width * row;
+		for (int col = r.x0; col < r.x1; col++) {
+			int level = counts[col] < OVERDRAW_LEVELS - 1 ? counts[col] : OVERDRAW_LEVELS - 1;
+			pixels[col] = overdraw_palette[level];
+			histogram[level]++;
+		}
+	}
+}
+
+void clear_oit_buffers_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		memset(oit_accum_buffer + (window_width * row + r.x0) * 4, 0, sizeof(float) * 4 * (r.x1 - r.x0));
+		float* revealage = oit_revealage_buffer + window_width * row;
+		for (int col = r.x0; col < r.x1; col++) {
+			revealage[col] = 1.0f;
+		}
+	}
+}
+
+//composites the transparent layers over the opaque pixels: the weighted average of the
+//fragment colors covers the pixel by 1 - revealage. pixels no fragment touched are skipped
+void resolve_oit_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int row = r.y0; row < r.y1; row++) {
+		const float* accum = oit_accum_buffer + window_width * row * 4;
+		const float* revealage = oit_revealage_buffer + window_width * row;
+		uint32_t* pixels = color_buffer + window_width * row;
+		for (int col = r.x0; col < r.x1; col++) {
+			float reveal = revealage[col];
+			if (reveal >= 1.0f) {
+				continue;
+			}
+#if USE_SSE2
+			__m128 sum = _mm_loadu_ps(accum + col * 4);
+			__m128 weight = _mm_max_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3)), _mm_set1_ps(1e-5f));
+			__m128 average = _mm_div_ps(sum, weight);
+			__m128i zero = _mm_setzero_si128();
+			__m128i destination = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)pixels[col]), zero), zero);
+			__m128 result = _mm_add_ps(
+				_mm_mul_ps(average, _mm_set1_ps(1.0f - reveal)),
+				_mm_mul_ps(_mm_cvtepi32_ps(destination), _mm_set1_ps(reveal)));
+			__m128i channels = _mm_cvtps_epi32(result);
+			channels = _mm_packus_epi16(_mm_packs_epi32(channels, zero), zero);
+			pixels[col] = 0xFF000000 | ((uint32_t)_mm_cvtsi128_si32(channels) & 0x00FFFFFF);
+#else
+			const float* sum = accum + col * 4;
+			float weight = sum[3] > 1e-5f ? sum[3] : 1e-5f;
+			uint32_t result = 0xFF000000;
+			for (int channel = 0; channel < 3; channel++) {
+				float value = sum[channel] / weight * (1.0f - reveal) + ((pixels[col] >> (channel * 8)) & 0xFF) * reveal;
+				int rounded = (int)(value + 0.5f);
+				result |= (uint32_t)(rounded < 0 ? 0 : (rounded > 255 ? 255 : rounded)) << (channel * 8);
+			}
+			pixels[col] = result;
+#endif
+		}
+	}
+}
+
 void destroy_window(void) {
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
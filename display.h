@@ -6,6 +6,13 @@
 #include <math.h>
 #include <stdbool.h>
 #include <SDL.h>
+#include "rect.h"
+#include "fixed.h"
+
+#define MSAA_SAMPLES 4
+
+//heatmap colors for 0 to 7 writes per pixel, the last one stands for 8 and more
+#define OVERDRAW_LEVELS 9
 
 #define FPS 60
 #define FRAME_TARGET_TIME 1000 / FPS
@@ -14,21 +21,52 @@ extern SDL_Window* window;
 extern SDL_Renderer* renderer;
 extern SDL_Texture* color_buffer_texture;
 extern uint32_t* color_buffer;
+extern float* depth_buffer;
+extern uint32_t* msaa_color_buffer;
+extern float* msaa_depth_buffer;
+extern bool msaa_active;
+extern uint8_t* overdraw_buffer;
+extern const uint32_t overdraw_palette[OVERDRAW_LEVELS];
+extern float* oit_accum_buffer;
+extern float* oit_revealage_buffer;
 
 extern int window_width;
 extern int window_height;
+extern int output_width;
+extern int output_height;
+extern rect_t clip_rect;
 
 bool initialize_window(void);
+bool allocate_msaa_buffers(void);
+bool allocate_overdraw_buffer(void);
+bool allocate_oit_buffers(void);
+void set_output_size(int width, int height);
+void set_clip_rect(rect_t r);
+void reset_clip_rect(void);
 void draw_rectangle(int x, int y, int height, int width, uint32_t color);
 void draw_pixel(int x, int y, uint32_t color);
 void draw_line_dda(int x0, int y0, int x1, int y1, uint32_t color);
 void draw_line_bresenham(int x0, int y0, int x1, int y1, uint32_t color);
+bool clip_line_fixed(vec2_fixed_t* p0, vec2_fixed_t* p1);
+void draw_line_fixed(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color);
+void draw_line_fixed_msaa(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color);
+void draw_line_antialiased(vec2_fixed_t p0, vec2_fixed_t p1, uint32_t color);
 void draw_horizontal_line(int x0, int y0, int x1, uint32_t color);
 void draw_vertical_line(int x0, int y0, int y1, uint32_t color);
-void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
-void draw_filled_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
+void draw_triangle(vec2_fixed_t p0, vec2_fixed_t p1, vec2_fixed_t p2, uint32_t color);
+void draw_triangle_msaa(vec2_fixed_t p0, vec2_fixed_t p1, vec2_fixed_t p2, uint32_t color);
+void render_color_buffer_texture(void);
 void render_color_buffer(void);
+void render_color_buffer_rect(rect_t r);
 void clear_color_buffer(uint32_t color);
+void clear_color_buffer_rect(rect_t r, uint32_t color);
+void clear_depth_buffer_rect(rect_t r);
+void clear_msaa_buffers_rect(rect_t r, uint32_t color);
+void resolve_msaa_buffer_rect(rect_t r);
+void clear_overdraw_buffer_rect(rect_t r);
+void resolve_overdraw_heatmap_rect(rect_t r, int64_t histogram[OVERDRAW_LEVELS]);
+void clear_oit_buffers_rect(rect_t r);
+void resolve_oit_rect(rect_t r);
 void destroy_window(void);
 
 #endif
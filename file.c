@@ -0,0 +1,27 @@
+#include "file.h"
+
+int file_seek(FILE* file, uint64_t offset) {
+#ifdef _MSC_VER
+	return _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+uint64_t file_tell(FILE* file) {
+#ifdef _MSC_VER
+	return (uint64_t)_ftelli64(file);
+#else
+	return (uint64_t)ftello(file);
+#endif
+}
+
+//leaves the position at the end of the file
+uint64_t file_size(FILE* file) {
+#ifdef _MSC_VER
+	_fseeki64(file, 0, SEEK_END);
+#else
+	fseeko(file, 0, SEEK_END);
+#endif
+	return file_tell(file);
+}
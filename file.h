@@ -0,0 +1,12 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+//64 bit file positions, long is 32 bits on Windows
+int file_seek(FILE* file, uint64_t offset);
+uint64_t file_tell(FILE* file);
+uint64_t file_size(FILE* file);
+
+#endif
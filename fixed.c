@@ -0,0 +1,22 @@
+#include <math.h>
+#include "fixed.h"
+
+//rounds to the nearest sub pixel step, also catches NaN and infinity
+//coming from vertices that ended up on the camera plane
+fixed_t fixed_from_float(float f) {
+	if (!(f > -FIXED_GUARD_BAND)) {
+		f = -FIXED_GUARD_BAND;
+	}
+	else if (f > FIXED_GUARD_BAND) {
+		f = FIXED_GUARD_BAND;
+	}
+	return (fixed_t)floorf(f * FIXED_ONE + 0.5f);
+}
+
+vec2_fixed_t vec2_fixed_from_floats(float x, float y) {
+	vec2_fixed_t result = {
+		.x = fixed_from_float(x),
+		.y = fixed_from_float(y)
+	};
+	return result;
+}
@@ -0,0 +1,32 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+//28.4 fixed point screen coordinates (16 sub pixel steps per pixel)
+//the pixel (x, y) has its center at (x + 0.5, y + 0.5)
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT 4
+#define FIXED_ONE (1 << FIXED_SHIFT)
+#define FIXED_HALF (FIXED_ONE >> 1)
+#define FIXED_MASK (FIXED_ONE - 1)
+
+//projected points further out than this many pixels get clamped, this keeps
+//every edge function product inside of 64 bits
+#define FIXED_GUARD_BAND 16384.0f
+
+#define fixed_from_int(i) ((fixed_t)(i) * FIXED_ONE)
+#define fixed_floor_to_int(f) ((f) >> FIXED_SHIFT)
+#define fixed_ceil_to_int(f) (((f) + FIXED_MASK) >> FIXED_SHIFT)
+//center of the pixel in fixed point
+#define fixed_pixel_center(i) (fixed_from_int(i) + FIXED_HALF)
+
+typedef struct {
+	fixed_t x, y;
+} vec2_fixed_t;
+
+fixed_t fixed_from_float(float f);
+vec2_fixed_t vec2_fixed_from_floats(float x, float y);
+
+#endif
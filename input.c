@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include "input.h"
+#include "profiler.h"
+
+input_state_t input = { 0 };
+
+//takes every event SDL has queued, not just one per frame, so input never piles up
+void input_poll(input_state_t* s) {
+	SDL_Event event;
+	while (SDL_PollEvent(&event)) {
+		if (event.type == SDL_QUIT) {
+			s->quit = true;
+		}
+		else if (event.type == SDL_KEYDOWN) {
+			if (s->num_presses == INPUT_MAX_PRESSES) {
+				//nobody takes presses at this rate, the newest ones are dropped
+				continue;
+			}
+			uint32_t now = SDL_GetTicks();
+			uint32_t timestamp = event.key.timestamp;
+			//not every platform stamps its events, and the stamp cannot be in the future
+			if (timestamp == 0 || (int32_t)(now - timestamp) < 0) {
+				timestamp = now;
+			}
+			input_press_t press = { event.key.keysym.sym, timestamp };
+			s->presses[s->num_presses++] = press;
+		}
+	}
+}
+
+//hands the queued presses to handler, oldest first. the ones it returns false for stay queued
+void input_consume(input_state_t* s, input_handler_t handler) {
+	int kept = 0;
+	for (int i = 0; i < s->num_presses; i++) {
+		input_press_t press = s->presses[i];
+		if (!handler(press.key)) {
+			s->presses[kept++] = press;
+			continue;
+		}
+		if (!s->frame_has_input || (int32_t)(press.timestamp - s->frame_input_time) < 0) {
+			s->frame_input_time = press.timestamp;
+		}
+		s->frame_has_input = true;
+	}
+	s->num_presses = kept;
+}
+
+//call right after the frame was presented, the presses handled for it count as shown
+void input_presented(input_state_t* s) {
+	if (!s->frame_has_input) {
+		return;
+	}
+	s->frame_has_input = false;
+	float latency = (float)(SDL_GetTicks() - s->frame_input_time);
+	PROFILE_COUNT(PROFILE_INPUT_LATENCY, (int64_t)latency);
+
+	s->last_latency_ms = latency;
+	s->num_latency_samples++;
+	s->average_latency_ms += (latency - s->average_latency_ms) / s->num_latency_samples;
+	if (latency > s->max_latency_ms) {
+		s->max_latency_ms = latency;
+	}
+}
+
+void input_print_latency(const input_state_t* s) {
+	if (s->num_latency_samples > 0) {
+		printf("input to present latency: %.1f ms average, %.1f ms max over %d frames\n",
+			s->average_latency_ms, s->max_latency_ms, s->num_latency_samples);
+	}
+}
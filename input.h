@@ -0,0 +1,43 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <SDL.h>
+
+//keyboard input is collected from the whole SDL event queue into a queue of timestamped
+//presses. parts of the frame take the presses they handle, camera keys are taken as late
+//as possible, right before the vertex stage. the time from the oldest press that went into
+//a frame to the present of that frame is measured as the input latency
+
+#define INPUT_MAX_PRESSES 64
+
+typedef struct {
+	SDL_Keycode key;
+	uint32_t timestamp; //SDL_GetTicks time the event was queued
+} input_press_t;
+
+typedef bool (*input_handler_t)(SDL_Keycode key);
+
+typedef struct {
+	bool quit;
+	input_press_t presses[INPUT_MAX_PRESSES]; //not handled yet, oldest first
+	int num_presses;
+
+	bool frame_has_input; //a press was handled for the frame being built
+	uint32_t frame_input_time; //of the oldest one
+
+	float last_latency_ms;
+	float average_latency_ms;
+	float max_latency_ms;
+	int num_latency_samples;
+} input_state_t;
+
+extern input_state_t input;
+
+void input_poll(input_state_t* s);
+void input_consume(input_state_t* s, input_handler_t handler);
+void input_presented(input_state_t* s);
+void input_print_latency(const input_state_t* s);
+
+#endif
@@ -1,16 +1,26 @@
 #include <stdint.h>
 #include "light.h"
+#include "color.h"
 
 light_t light = {
-	.direction = {0,0,1}
+	.direction = {0,0,1},
+	.gamma_correct = false
 };
 
+//factors below zero (faces turned away from the light) give black, above one the channels saturate
 uint32_t light_apply_intensity(uint32_t original_color, float percentage_factor) {
-	uint32_t a = (original_color & 0xFF000000);
-	uint32_t r = (original_color & 0x00FF0000) * percentage_factor;
-	uint32_t g = (original_color & 0x0000FF00) * percentage_factor;
-	uint32_t b = (original_color & 0x000000FF) * percentage_factor;
+	if (light.gamma_correct) {
+		return color_modulate_srgb(original_color, percentage_factor);
+	}
+	return color_modulate(original_color, percentage_factor);
+}
 
-	uint32_t new_color = a | (r & 0x00FF0000) | (g & 0x0000FF00) | (b & 0x000000FF);
-	return new_color;
-}
\ No newline at end of file
+//the same for a whole span of colors, out may be the colors array itself
+void light_apply_intensities(const uint32_t* colors, const float* percentage_factors, uint32_t* out, int count) {
+	if (light.gamma_correct) {
+		color_modulate_srgb_n(colors, percentage_factors, out, count);
+	}
+	else {
+		color_modulate_n(colors, percentage_factors, out, count);
+	}
+}
@@ -2,14 +2,17 @@
 #define LIGHT_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "vector.h"
 
 typedef struct {
 	vec3_t direction;
+	bool gamma_correct; //shade in linear light instead of on the sRGB values
 } light_t;
 
 extern light_t light;
 
 uint32_t light_apply_intensity(uint32_t original_color, float percentage_factor);
+void light_apply_intensities(const uint32_t* colors, const float* percentage_factors, uint32_t* out, int count);
 
 #endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <SDL.h>
 #include "array.h"
 #include "display.h"
@@ -9,84 +10,304 @@
 #include "triangle.h"
 #include "matrix.h"
 #include "light.h"
+#include "rect.h"
+#include "fixed.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "server.h"
+#include "camera.h"
+#include "profiler.h"
+#include "cluster.h"
+#include "color.h"
+#include "shadow.h"
+#include "resolution.h"
+#include "point_cloud.h"
+#include "input.h"
+#include "temporal.h"
 
 bool is_running = false;
-triangle_t* triangles_to_render = NULL;
-
-vec3_t camera_position = { .x = 0, .y = 0, .z = 0 };
-mat4_t proj_matrix;
-
 int previous_frame_time = 0;
 
-int display_mode = 2; //default 2
-int backface_culling_mode = 1; //default 1 (enabled)
+bool animation_paused = false;
+
+//set with --stream, the mesh is then assembled from whatever clusters are resident
+const char* stream_filename = NULL;
+size_t stream_budget = (size_t)CLUSTER_DEFAULT_BUDGET_MB * 1024 * 1024;
+cluster_stream_t* mesh_stream = NULL;
+unsigned int mesh_version = 0;
+
+//set with --packed, the mesh is rendered from its compressed form
+bool mesh_packing = false;
+//set with --skin, the mesh is then animated by the skeleton in that file
+const char* skin_filename = NULL;
+float animation_time = 0.0f;
+//set with --points, display mode 6 then shows that point cloud instead of the mesh
+const char* points_filename = NULL;
+uint8_t mesh_alpha = 0xFF;
+
+#define CAMERA_MOVE_STEP 0.25f
+#define CAMERA_TURN_STEP 0.05f
+
+//everything that decides what the mesh looks like on screen, compared between frames
+//so that frames where nothing changed do not have to be rendered again
+typedef struct {
+	vec3_t rotation;
+	vec3_t scale;
+	vec3_t translation;
+	int display_mode;
+	int backface_culling_mode;
+	bool wireframe_antialiasing;
+	bool depth_test_enabled;
+	bool msaa_enabled;
+	bool gamma_correct;
+	bool shadows_enabled;
+	bool shadows_pcf;
+	float animation_time;
+	float point_size_scale;
+	bool temporal_enabled;
+	unsigned int camera_version;
+	unsigned int mesh_version;
+} scene_state_t;
+
+scene_state_t previous_scene_state;
+bool full_redraw_needed = true;
+rect_t dirty_rect = { 0, 0, 0, 0 };
+//the last frame changed the scene, in temporal mode half of its pixels were only reprojected
+bool temporal_settle_needed = false;
 
 bool setup(void) {
-	color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * window_width * window_height);
+	color_buffer = (uint32_t*)malloc(sizeof(uint32_t) * output_width * output_height);
 
 	if (!color_buffer) {
 		fprintf(stderr, "Error creating the color buffer. Probably not enough avaliable memory.\n");
 		return false;
 	}
 
+	depth_buffer = (float*)malloc(sizeof(float) * output_width * output_height);
+
+	if (!depth_buffer) {
+		fprintf(stderr, "Error creating the depth buffer. Probably not enough avaliable memory.\n");
+		return false;
+	}
+
+	//frames rendered at a lower resolution are filtered when they get stretched to the window
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 	color_buffer_texture = SDL_CreateTexture(
 		renderer,
 		SDL_PIXELFORMAT_ARGB8888,
 		SDL_TEXTUREACCESS_STREAMING,
-		window_width,
-		window_height
+		output_width,
+		output_height
 	);
 
 	//initialize perspective projection matrix
-	float fov = M_PI / 3.0;
-	float aspect = (float)window_height / (float)window_width;
-	float znear = 0.1;
-	float zfar = 100.0;
-	proj_matrix = mat4_make_perspective(
-		fov,
-		aspect,
-		znear,
-		zfar);
-
-	//load_cube_mesh_data();
-	char* filename = "assets\\cube.obj";
-	load_obj_file_data(filename);
+	setup_projection();
+
+	if (stream_filename) {
+		//starts out empty, update() assembles the mesh once clusters arrive
+		mesh_stream = cluster_stream_open(stream_filename, stream_budget);
+		if (!mesh_stream) {
+			return false;
+		}
+		mesh.bounds_center = mesh_stream->bounds_center;
+		mesh.bounds_radius = mesh_stream->bounds_radius;
+	}
+	else if (points_filename) {
+		if (!point_cloud_load(&point_cloud, points_filename)) {
+			return false;
+		}
+		//scans are rarely centered on the origin, the camera starts out looking at the whole
+		//cloud from outside of it and the cloud holds still until p is pressed
+		display_mode = POINT_DISPLAY_MODE;
+		animation_paused = true;
+		float radius = point_cloud.bounds_radius > 0.0f ? point_cloud.bounds_radius : 1.0f;
+		vec3_t target = vec3_add(point_cloud.bounds_center, (vec3_t){ 0, 0, 5 });
+		vec3_t eye = vec3_add(target, (vec3_t){ 0, radius * 0.5f, -radius * 2.5f });
+		camera_set_perspective(&camera, camera.fov, radius * 0.001f, radius * 6.0f);
+		camera_look_at(&camera, eye, target);
+	}
+	else {
+		//load_cube_mesh_data();
+		char* filename = "assets\\cube.obj";
+		load_obj_file_data(filename);
+		mesh_build_edges(&mesh);
+		mesh_compute_bounds(&mesh);
+		if (skin_filename && !mesh_load_skin(&mesh, skin_filename)) {
+			return false;
+		}
+		if (mesh_packing && !mesh_pack(&mesh)) {
+			return false;
+		}
+	}
+
+#ifdef ENABLE_PROFILER
+	profiler_set_viewport(window_width, window_height);
+#endif
+
+	return setup_vertex_buffers();
+}
+
+//renders the next frames at the size picked by the resolution controller
+void apply_render_resolution(void) {
+	int width, height;
+	resolution_size(&resolution, output_width, output_height, &width, &height);
+	if (width == window_width && height == window_height) {
+		return;
+	}
+	window_width = width;
+	window_height = height;
+	reset_clip_rect();
+	setup_projection();
+#ifdef ENABLE_PROFILER
+	profiler_set_viewport(window_width, window_height);
+#endif
+	full_redraw_needed = true;
+}
+
+static bool is_camera_key(SDL_Keycode key) {
+	return key == SDLK_w || key == SDLK_s || key == SDLK_q || key == SDLK_e
+		|| key == SDLK_LEFT || key == SDLK_RIGHT || key == SDLK_UP || key == SDLK_DOWN;
+}
+
+//settings, taken at the start of the frame
+static bool handle_setting_key(SDL_Keycode key) {
+	if (key == SDLK_ESCAPE) {
+		is_running = false;
+	}
+	else if (key == SDLK_1) {
+		display_mode = 1;
+	}
+	else if (key == SDLK_2) {
+		display_mode = 2;
+	}
+	else if (key == SDLK_3) {
+		display_mode = 3;
+	}
+	else if (key == SDLK_4) {
+		display_mode = 4;
+	}
+	else if (key == SDLK_5) {
+		if (allocate_overdraw_buffer()) {
+			display_mode = 5;
+		}
+	}
+	else if (key == SDLK_6) {
+		display_mode = POINT_DISPLAY_MODE;
+	}
+	else if (key == SDLK_EQUALS) {
+		point_size_scale *= 1.25f;
+	}
+	else if (key == SDLK_MINUS) {
+		point_size_scale *= 0.8f;
+	}
+	else if (key == SDLK_c) {
+		backface_culling_mode = 1;
+	}
+	else if (key == SDLK_d) {
+		backface_culling_mode = 0;
+	}
+	else if (key == SDLK_l) {
+		wireframe_antialiasing = !wireframe_antialiasing;
+	}
+	else if (key == SDLK_z) {
+		depth_test_enabled = !depth_test_enabled;
+	}
+	else if (key == SDLK_m) {
+		msaa_enabled = !msaa_enabled && allocate_msaa_buffers();
+	}
+	else if (key == SDLK_p) {
+		animation_paused = !animation_paused;
+	}
+	else if (key == SDLK_g) {
+		light.gamma_correct = !light.gamma_correct;
+	}
+	else if (key == SDLK_x) {
+		//shadows show in display mode 3 with the depth test on
+		shadow_map.enabled = !shadow_map.enabled && shadow_map_init();
+	}
+	else if (key == SDLK_f) {
+		shadow_map.pcf = !shadow_map.pcf;
+	}
+	else if (key == SDLK_r) {
+		resolution.enabled = !resolution.enabled;
+		resolution_reset(&resolution);
+		apply_render_resolution();
+	}
+	else if (key == SDLK_k) {
+		//checkerboard rendering, used in display mode 3 with the depth test on
+		temporal.enabled = !temporal.enabled && temporal_init();
+	}
+	else if (key == SDLK_o) {
+		//cycles the mesh through opaque, 75%, 50% and 25%
+		mesh_alpha = mesh_alpha == 0xFF ? 0xC0 : (mesh_alpha == 0xC0 ? 0x80 : (mesh_alpha == 0x80 ? 0x40 : 0xFF));
+		mesh_set_alpha(&mesh, mesh_alpha);
+		mesh_version++;
+	}
+#ifdef ENABLE_PROFILER
+	else if (key == SDLK_h) {
+		profiler_hud_visible = !profiler_hud_visible;
+		full_redraw_needed = true;
+	}
+	else if (key == SDLK_t) {
+		if (profiler_write_chrome_trace("trace.json")) {
+			printf("trace written to trace.json\n");
+		}
+	}
+#endif
 
+	//camera keys stay queued for latch_camera, anything else is dropped
+	return !is_camera_key(key);
+}
+
+static bool handle_camera_key(SDL_Keycode key) {
+	if (key == SDLK_w) {
+		camera_move(&camera, CAMERA_MOVE_STEP, 0);
+	}
+	else if (key == SDLK_s) {
+		camera_move(&camera, -CAMERA_MOVE_STEP, 0);
+	}
+	else if (key == SDLK_q) {
+		camera_move(&camera, 0, -CAMERA_MOVE_STEP);
+	}
+	else if (key == SDLK_e) {
+		camera_move(&camera, 0, CAMERA_MOVE_STEP);
+	}
+	else if (key == SDLK_LEFT) {
+		camera_set_rotation(&camera, camera.yaw - CAMERA_TURN_STEP, camera.pitch);
+	}
+	else if (key == SDLK_RIGHT) {
+		camera_set_rotation(&camera, camera.yaw + CAMERA_TURN_STEP, camera.pitch);
+	}
+	else if (key == SDLK_UP) {
+		camera_set_rotation(&camera, camera.yaw, camera.pitch + CAMERA_TURN_STEP);
+	}
+	else if (key == SDLK_DOWN) {
+		camera_set_rotation(&camera, camera.yaw, camera.pitch - CAMERA_TURN_STEP);
+	}
+	else {
+		return false;
+	}
 	return true;
 }
 
 void process_input(void) {
-	SDL_Event event;
-	SDL_PollEvent(&event);
-
-	switch (event.type) {
-		case SDL_QUIT:
-			is_running = false;
-			break;
-		case SDL_KEYDOWN:
-			if (event.key.keysym.sym == SDLK_ESCAPE) {
-				is_running = false;
-			}
-			else if (event.key.keysym.sym == SDLK_1) {
-				display_mode = 1;
-			}
-			else if (event.key.keysym.sym == SDLK_2) {
-				display_mode = 2;
-			}
-			else if (event.key.keysym.sym == SDLK_3) {
-				display_mode = 3;
-			}
-			else if (event.key.keysym.sym == SDLK_4) {
-				display_mode = 4;
-			}
-			else if (event.key.keysym.sym == SDLK_c) {
-				backface_culling_mode = 1;
-			}
-			else if (event.key.keysym.sym == SDLK_d) {
-				backface_culling_mode = 0;
-			}
-			break;
+	PROFILE_BEGIN(PROFILE_INPUT);
+	input_poll(&input);
+	if (input.quit) {
+		is_running = false;
 	}
+	input_consume(&input, handle_setting_key);
+	PROFILE_END(PROFILE_INPUT);
+}
+
+//the view is taken as late as possible: camera keys pressed while the frame waited for its
+//turn or simulated still move this frame, instead of waiting for the next one
+void latch_camera(void) {
+	PROFILE_BEGIN(PROFILE_INPUT);
+	input_poll(&input);
+	input_consume(&input, handle_camera_key);
+	camera_update(&camera);
+	PROFILE_END(PROFILE_INPUT);
 }
 
 void update(void) {
@@ -98,212 +319,228 @@ void update(void) {
 		SDL_Delay(time_to_wait);
 	}
 
-	previous_frame_time = SDL_GetTicks();
-
-	triangles_to_render = NULL;
-
-	mesh.rotation.x += 0.01;
-	mesh.rotation.y += 0.01;
-	mesh.rotation.z += 0.01;
-
-	mesh.translation.z = 5;
-
-	mat4_t scale_matrix = mat4_make_scale(mesh.scale.x, mesh.scale.y, mesh.scale.z);
-	mat4_t translation_matrix = mat4_make_translation(mesh.translation.x, mesh.translation.y, mesh.translation.z);
-	mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh.rotation.x);
-	mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh.rotation.y);
-	mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh.rotation.z);
-
-
-	//loop all triangle faces of cube mesh
-	int num_faces = array_length(mesh.faces);
-	for (int i = 0; i < num_faces; i++) {
-		face_t mesh_face = mesh.faces[i];
-		
-		vec3_t face_vertices[3];
-		face_vertices[0] = mesh.vertices[mesh_face.a - 1];
-		face_vertices[1] = mesh.vertices[mesh_face.b - 1];
-		face_vertices[2] = mesh.vertices[mesh_face.c - 1];
-
-		vec4_t transformed_vertices[3];
-		 //loop all three vertices of this face and apply transforms
-		for (int j = 0; j < 3; j++) {
-			vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
-
-			mat4_t world_matrix = mat4_identity();
-			world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
-			world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-			world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-			world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-			world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
-			
-			//translate the vertex array from the camera
-			transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
-
-			transformed_vertices[j] = transformed_vertex;
+	int frame_start = SDL_GetTicks();
+	float delta_time = previous_frame_time > 0 ? (frame_start - previous_frame_time) / 1000.0f : 0.0f;
+	previous_frame_time = frame_start;
+
+	if (!animation_paused) {
+		mesh.rotation.x += 0.01;
+		mesh.rotation.y += 0.01;
+		mesh.rotation.z += 0.01;
+		if (mesh.skin) {
+			animation_time += delta_time;
+			mesh_animate(&mesh, animation_time);
 		}
+	}
 
-		//backface culling
-		
-		vec3_t vector_a = vec3_from_vec4(transformed_vertices[0]);
-		vec3_t vector_b = vec3_from_vec4(transformed_vertices[1]);
-		vec3_t vector_c = vec3_from_vec4(transformed_vertices[2]);
-
-		vec3_t vector_ab = vec3_sub(vector_b, vector_a);
-		vec3_t vector_ac = vec3_sub(vector_c, vector_a);
-		vec3_normalize(&vector_ab);
-		vec3_normalize(&vector_ac);
-
-		vec3_t normal = vec3_cross(vector_ab, vector_ac);
-		vec3_normalize(&normal);
-
-		vec3_t camera_ray = vec3_sub(camera_position, vector_a);
-		float dot_normal_camera = vec3_dot(normal, camera_ray);
+	mesh.translation.z = 5;
 
-		if (backface_culling_mode) {
-			if (dot_normal_camera < 0) {
-				continue;
+	latch_camera();
+
+	if (mesh_stream) {
+		mat4_t world_matrix;
+		mat4_make_trs(&world_matrix, mesh.scale, mesh.rotation, mesh.translation);
+		float max_scale = fmaxf(fabsf(mesh.scale.x), fmaxf(fabsf(mesh.scale.y), fabsf(mesh.scale.z)));
+		cluster_stream_update(mesh_stream, &world_matrix, max_scale);
+		if (mesh_stream->selection_changed) {
+			cluster_stream_assemble(mesh_stream, &mesh);
+			mesh_set_alpha(&mesh, mesh_alpha);
+			if (!setup_vertex_buffers()) {
+				is_running = false;
+				return;
 			}
+			mesh_version++;
 		}
+	}
 
-		vec4_t projected_points[3];
-		for (int j = 0; j < 3; j++) {
-			//project the current vertex
-			projected_points[j] = mat4_mul_vec4_project(proj_matrix, transformed_vertices[j]);
+	//skip the whole pipeline when the scene looks exactly like last frame
+	//compared with memcmp, so the padding between the fields has to be zeroed as well
+	scene_state_t scene_state;
+	memset(&scene_state, 0, sizeof(scene_state_t));
+	scene_state.rotation = mesh.rotation;
+	scene_state.scale = mesh.scale;
+	scene_state.translation = mesh.translation;
+	scene_state.display_mode = display_mode;
+	scene_state.backface_culling_mode = backface_culling_mode;
+	scene_state.wireframe_antialiasing = wireframe_antialiasing;
+	scene_state.depth_test_enabled = depth_test_enabled;
+	scene_state.msaa_enabled = msaa_enabled;
+	scene_state.gamma_correct = light.gamma_correct;
+	scene_state.shadows_enabled = shadow_map.enabled;
+	scene_state.shadows_pcf = shadow_map.pcf;
+	scene_state.animation_time = animation_time;
+	scene_state.point_size_scale = point_size_scale;
+	scene_state.temporal_enabled = temporal.enabled;
+	scene_state.camera_version = camera.version;
+	scene_state.mesh_version = mesh_version;
+	bool scene_changed = full_redraw_needed || memcmp(&scene_state, &previous_scene_state, sizeof(scene_state_t)) != 0;
+	memcpy(&previous_scene_state, &scene_state, sizeof(scene_state_t));
+
+	//once the scene holds still, one more frame rasterizes every pixel so that the
+	//reconstructed half of the last one does not stay on screen
+	bool settle = !scene_changed && temporal_settle_needed;
+	temporal_settle_needed = scene_changed && temporal.enabled;
+	if (settle) {
+		temporal_reset();
+	}
 
-			//scale and translate projected points to middle of screen
+	if (!scene_changed && !settle) {
+		dirty_rect = rect_empty();
+#ifdef ENABLE_PROFILER
+		//the hud changes every frame
+		if (profiler_hud_visible) {
+			dirty_rect = profiler_hud_rect();
+		}
+#endif
+		return;
+	}
 
-			projected_points[j].x *= (window_width / 2.0);
-			projected_points[j].y *= (window_height / 2.0);
+	rect_t mesh_bounds = transform_mesh();
 
-			projected_points[j].y *= -1;
+	//the area to redraw is where the mesh was plus where it is now
+	if (full_redraw_needed) {
+		dirty_rect = rect_make(0, 0, window_width, window_height);
+		full_redraw_needed = false;
+	}
+	else {
+		dirty_rect = rect_union(mesh.screen_bounds, mesh_bounds);
+	}
+	mesh.screen_bounds = mesh_bounds;
 
-			projected_points[j].x += (window_width / 2.0);
-			projected_points[j].y += (window_height / 2.0);
-		}
-		float avg_depth = (transformed_vertices[0].z +
-			transformed_vertices[1].z +
-			transformed_vertices[2].z) / 3.0;
-
-		//calculate shading intensity based on dot product between face normal and light angle
-		float light_intensity_factor = -vec3_dot(normal, light.direction);
-
-		//calculate triangle color based on the light angle
-		uint32_t triangle_color = light_apply_intensity(mesh_face.color, light_intensity_factor);
-
-		triangle_t projected_triangle = {
-			.points = {
-				{projected_points[0].x, projected_points[0].y},
-				{projected_points[1].x, projected_points[1].y},
-				{projected_points[2].x, projected_points[2].y}
-			 },
-			.color = triangle_color,
-			.avg_depth = avg_depth
-		};
-		array_push(triangles_to_render, projected_triangle);
-	}
-
-	// sort triangles by depth (bubble sort)
-	int num_triangles = array_length(triangles_to_render);
-	for (int i = 0; i < num_triangles; i++) {
-		for (int j = i; j < num_triangles; j++) {
-			if (triangles_to_render[i].avg_depth < triangles_to_render[j].avg_depth) {
-				triangle_t temp = triangles_to_render[i];
-				triangles_to_render[i] = triangles_to_render[j];
-				triangles_to_render[j] = temp;
-			}
-		}
+#ifdef ENABLE_PROFILER
+	if (profiler_hud_visible) {
+		dirty_rect = rect_union(dirty_rect, profiler_hud_rect());
 	}
+#endif
 }
 
 void render() {
-	
-	int num_triangles = array_length(triangles_to_render);
-
-	for (int i = 0; i < num_triangles; i++) {
-		triangle_t triangle = triangles_to_render[i];
-
-		if (display_mode == 3) {
-			draw_filled_triangle(
-				triangle.points[0].x,
-				triangle.points[0].y,
-				triangle.points[1].x,
-				triangle.points[1].y,
-				triangle.points[2].x,
-				triangle.points[2].y,
-				triangle.color);
-		}
-		else if (display_mode == 2) {
-			draw_triangle(
-				triangle.points[0].x,
-				triangle.points[0].y,
-				triangle.points[1].x,
-				triangle.points[1].y,
-				triangle.points[2].x,
-				triangle.points[2].y,
-				0xFFFFFFFF);
-		}
-		else if (display_mode == 1) {
-			draw_triangle(
-				triangle.points[0].x,
-				triangle.points[0].y,
-				triangle.points[1].x,
-				triangle.points[1].y,
-				triangle.points[2].x,
-				triangle.points[2].y,
-				0xFFFFFFFF);
-
-			draw_rectangle(triangle.points[0].x, triangle.points[0].y, 6, 6, 0xFFFF0000);
-			draw_rectangle(triangle.points[1].x, triangle.points[1].y, 6, 6, 0xFFFF0000);
-			draw_rectangle(triangle.points[2].x, triangle.points[2].y, 6, 6, 0xFFFF0000);
-		}
-		else if (display_mode == 4) {
-			draw_filled_triangle(
-				triangle.points[0].x,
-				triangle.points[0].y,
-				triangle.points[1].x,
-				triangle.points[1].y,
-				triangle.points[2].x,
-				triangle.points[2].y,
-				0xFFFFFFFF);
-			draw_triangle(
-				triangle.points[0].x,
-				triangle.points[0].y,
-				triangle.points[1].x,
-				triangle.points[1].y,
-				triangle.points[2].x,
-				triangle.points[2].y,
-				0xFFFF0000);
-		}
+	//idle frame, the texture still holds the last frame
+	if (rect_is_empty(dirty_rect)) {
+		PROFILE_BEGIN(PROFILE_PRESENT);
+		render_color_buffer_texture();
+		SDL_RenderPresent(renderer);
+		input_presented(&input);
+		PROFILE_END(PROFILE_PRESENT);
+		return;
 	}
 
-	array_free(triangles_to_render);
+	//only the dirty area gets cleared, rasterized and uploaded
+	Uint64 raster_start = SDL_GetPerformanceCounter();
+	render_triangles(dirty_rect);
 
-	render_color_buffer();
-	clear_color_buffer(0x00000000);
+#ifdef ENABLE_PROFILER
+	if (profiler_hud_visible) {
+		profiler_draw_hud();
+	}
+#endif
+
+	PROFILE_BEGIN(PROFILE_UPLOAD);
+	render_color_buffer_rect(dirty_rect);
+	PROFILE_END(PROFILE_UPLOAD);
+	float raster_ms = (float)((double)(SDL_GetPerformanceCounter() - raster_start) * 1000.0 / SDL_GetPerformanceFrequency());
 
+	PROFILE_BEGIN(PROFILE_PRESENT);
 	SDL_RenderPresent(renderer);
+	input_presented(&input);
+	PROFILE_END(PROFILE_PRESENT);
 
+	//a new size only takes effect with the next frame, which is then drawn in full
+	if (resolution_update(&resolution, raster_ms)) {
+		apply_render_resolution();
+	}
 }
 
 void free_resources(void) {
 	free(color_buffer);
-	array_free(mesh.faces);
-	array_free(mesh.vertices);
+	free(depth_buffer);
+	free(msaa_color_buffer);
+	free(msaa_depth_buffer);
+	free(overdraw_buffer);
+	free(oit_accum_buffer);
+	free(oit_revealage_buffer);
+	free_vertex_buffers();
+	shadow_map_free();
+	temporal_free();
+	mesh_free(&mesh);
+	skin_shutdown();
+	point_cloud_free(&point_cloud);
+	point_cloud_shutdown();
+	input_print_latency(&input);
+	cluster_stream_close(mesh_stream);
+#ifdef ENABLE_PROFILER
+	profiler_shutdown();
+#endif
 }
 
 int main(int argc, char* args[]) {
+	color_init();
+
+#ifdef ENABLE_PROFILER
+	profiler_init();
+#endif
+
+	//offline rendering of a batch job: 3dRenderer --batch job.txt
+	if (argc >= 3 && strcmp(args[1], "--batch") == 0) {
+		return run_batch_job(args[2]) ? 0 : 1;
+	}
+
+	//embedding: 3dRenderer --server /tmp/3drenderer.sock [width height], see server.h
+	if (argc >= 3 && strcmp(args[1], "--server") == 0) {
+		int width = argc >= 5 ? atoi(args[3]) : 1280;
+		int height = argc >= 5 ? atoi(args[4]) : 720;
+		return run_render_server(args[2], width, height) ? 0 : 1;
+	}
+
+	//splitting a large mesh for streaming: 3dRenderer --build-clusters scan.obj scan.clu [faces per cluster]
+	if (argc >= 4 && strcmp(args[1], "--build-clusters") == 0) {
+		int max_faces = argc >= 5 ? atoi(args[4]) : CLUSTER_DEFAULT_FACES;
+		return cluster_build_file(args[2], args[3], max_faces) ? 0 : 1;
+	}
+
+	//viewing it: 3dRenderer --stream scan.clu [memory budget in MB]
+	if (argc >= 3 && strcmp(args[1], "--stream") == 0) {
+		stream_filename = args[2];
+		if (argc >= 4 && atoi(args[3]) > 0) {
+			stream_budget = (size_t)atoi(args[3]) * 1024 * 1024;
+		}
+	}
+
+	//packing the vertices of a scan: 3dRenderer --build-points scan.obj scan.pts
+	if (argc >= 4 && strcmp(args[1], "--build-points") == 0) {
+		return point_cloud_build_file(args[2], args[3]) ? 0 : 1;
+	}
+
+	//viewing it: 3dRenderer --points scan.pts (or scan.obj), see point_cloud.h
+	if (argc >= 3 && strcmp(args[1], "--points") == 0) {
+		points_filename = args[2];
+	}
+
+	//compressed vertices and faces: 3dRenderer --packed
+	if (argc >= 2 && strcmp(args[1], "--packed") == 0) {
+		mesh_packing = true;
+	}
+
+	//skeletal animation of the mesh: 3dRenderer --skin assets/cube.skin, see skin.h
+	if (argc >= 3 && strcmp(args[1], "--skin") == 0) {
+		skin_filename = args[2];
+	}
 
 	is_running = initialize_window();
 
 	vec3_t myVec = { 2, 4, 6 };
 
-	setup();
+	is_running = is_running && setup();
 
 	while (is_running) {
+		PROFILE_BEGIN(PROFILE_FRAME);
 		process_input();
 		update();
 		render();
+		PROFILE_END(PROFILE_FRAME);
+#ifdef ENABLE_PROFILER
+		profiler_end_frame();
+#endif
 	}
 
 	destroy_window();
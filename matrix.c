@@ -73,6 +73,23 @@ mat4_t mat4_make_perspective(float fov, float aspect, float znear, float zfar) {
 	return m;
 }
 
+//view matrix for a camera at eye looking at target (left handed, +z forward)
+mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up) {
+	vec3_t z = vec3_sub(target, eye);
+	vec3_normalize(&z);
+	vec3_t x = vec3_cross(up, z);
+	vec3_normalize(&x);
+	vec3_t y = vec3_cross(z, x);
+
+	mat4_t view_matrix = {{
+		{ x.x, x.y, x.z, -vec3_dot(x, eye) },
+		{ y.x, y.y, y.z, -vec3_dot(y, eye) },
+		{ z.x, z.y, z.z, -vec3_dot(z, eye) },
+		{   0,   0,   0,                 1 }
+	}};
+	return view_matrix;
+}
+
 vec4_t mat4_mul_vec4_project(mat4_t mat_proj, vec4_t v) {
 	vec4_t result = mat4_mul_vec4(mat_proj, v);
 	if (result.w != 0.0) {
@@ -108,7 +125,21 @@ mat4_t mat4_mul_mat4(mat4_t m1, mat4_t m2) {
 	return m;
 }
 
-void mat4_mul_mat4_faster(mat4_t* res, mat4_t* m1, mat4_t* m2) {
+void mat4_mul_mat4_faster(mat4_t* RESTRICT res, const mat4_t* m1, const mat4_t* m2) {
+#if USE_SSE2
+	//every result row is a mix of the rows of m2
+	__m128 row0 = _mm_loadu_ps(m2->m[0]);
+	__m128 row1 = _mm_loadu_ps(m2->m[1]);
+	__m128 row2 = _mm_loadu_ps(m2->m[2]);
+	__m128 row3 = _mm_loadu_ps(m2->m[3]);
+	for (int row = 0; row < 4; ++row) {
+		__m128 result = _mm_mul_ps(_mm_set1_ps(m1->m[row][0]), row0);
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(m1->m[row][1]), row1));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(m1->m[row][2]), row2));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(m1->m[row][3]), row3));
+		_mm_storeu_ps(res->m[row], result);
+	}
+#else
 	for (int row = 0; row < 4; ++row) {
 		for (int col = 0; col < 4; ++col) {
 			res->m[row][col] =
@@ -118,4 +149,353 @@ void mat4_mul_mat4_faster(mat4_t* res, mat4_t* m1, mat4_t* m2) {
 				+ m1->m[row][3] * m2->m[3][col];
 		}
 	}
-}
\ No newline at end of file
+#endif
+}
+
+//translation * rotation_x * rotation_y * rotation_z * scale built directly,
+//one sine and one cosine per axis and no matrix multiplications
+void mat4_make_trs(mat4_t* RESTRICT res, vec3_t scale, vec3_t rotation, vec3_t translation) {
+	float sx = sinf(rotation.x), cx = cosf(rotation.x);
+	float sy = sinf(rotation.y), cy = cosf(rotation.y);
+	float sz = sinf(rotation.z), cz = cosf(rotation.z);
+
+	res->m[0][0] = cy * cz * scale.x;
+	res->m[0][1] = -cy * sz * scale.y;
+	res->m[0][2] = sy * scale.z;
+	res->m[0][3] = translation.x;
+
+	res->m[1][0] = (cx * sz + sx * sy * cz) * scale.x;
+	res->m[1][1] = (cx * cz - sx * sy * sz) * scale.y;
+	res->m[1][2] = -sx * cy * scale.z;
+	res->m[1][3] = translation.y;
+
+	res->m[2][0] = (sx * sz - cx * sy * cz) * scale.x;
+	res->m[2][1] = (sx * cz + cx * sy * sz) * scale.y;
+	res->m[2][2] = cx * cy * scale.z;
+	res->m[2][3] = translation.z;
+
+	res->m[3][0] = 0;
+	res->m[3][1] = 0;
+	res->m[3][2] = 0;
+	res->m[3][3] = 1;
+}
+
+void mat4_make_trs_quat(mat4_t* RESTRICT res, vec3_t scale, quat_t q, vec3_t translation) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	res->m[0][0] = (1 - 2 * (yy + zz)) * scale.x;
+	res->m[0][1] = 2 * (xy - wz) * scale.y;
+	res->m[0][2] = 2 * (xz + wy) * scale.z;
+	res->m[0][3] = translation.x;
+
+	res->m[1][0] = 2 * (xy + wz) * scale.x;
+	res->m[1][1] = (1 - 2 * (xx + zz)) * scale.y;
+	res->m[1][2] = 2 * (yz - wx) * scale.z;
+	res->m[1][3] = translation.y;
+
+	res->m[2][0] = 2 * (xz - wy) * scale.x;
+	res->m[2][1] = 2 * (yz + wx) * scale.y;
+	res->m[2][2] = (1 - 2 * (xx + yy)) * scale.z;
+	res->m[2][3] = translation.z;
+
+	res->m[3][0] = 0;
+	res->m[3][1] = 0;
+	res->m[3][2] = 0;
+	res->m[3][3] = 1;
+}
+
+//both matrices have 0 0 0 1 as their last row (no projection), which leaves
+//3x4 of the result to compute: 36 multiplications instead of 64
+void mat4_mul_mat4_affine(mat4_t* RESTRICT res, const mat4_t* m1, const mat4_t* m2) {
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			res->m[row][col] =
+				  m1->m[row][0] * m2->m[0][col]
+				+ m1->m[row][1] * m2->m[1][col]
+				+ m1->m[row][2] * m2->m[2][col];
+		}
+		res->m[row][3] += m1->m[row][3];
+	}
+	res->m[3][0] = 0;
+	res->m[3][1] = 0;
+	res->m[3][2] = 0;
+	res->m[3][3] = 1;
+}
+
+//general inverse by cofactors, returns false for singular matrices
+bool mat4_inverse(mat4_t* RESTRICT res, const mat4_t* m) {
+#if USE_SSE2
+	//Cramer's rule on four lanes at once (Intel AP-928), the loads transpose the matrix
+	const float* src = &m->m[0][0];
+	__m128 minor0, minor1, minor2, minor3;
+	__m128 row0, row1, row2, row3;
+	__m128 det, tmp1;
+
+	tmp1 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(src)), (const __m64*)(src + 4));
+	row1 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(src + 8)), (const __m64*)(src + 12));
+	row0 = _mm_shuffle_ps(tmp1, row1, 0x88);
+	row1 = _mm_shuffle_ps(row1, tmp1, 0xDD);
+	tmp1 = _mm_loadh_pi(_mm_loadl_pi(tmp1, (const __m64*)(src + 2)), (const __m64*)(src + 6));
+	row3 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(src + 10)), (const __m64*)(src + 14));
+	row2 = _mm_shuffle_ps(tmp1, row3, 0x88);
+	row3 = _mm_shuffle_ps(row3, tmp1, 0xDD);
+
+	tmp1 = _mm_mul_ps(row2, row3);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+	minor0 = _mm_mul_ps(row1, tmp1);
+	minor1 = _mm_mul_ps(row0, tmp1);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+	minor0 = _mm_sub_ps(_mm_mul_ps(row1, tmp1), minor0);
+	minor1 = _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor1);
+	minor1 = _mm_shuffle_ps(minor1, minor1, 0x4E);
+
+	tmp1 = _mm_mul_ps(row1, row2);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+	minor0 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor0);
+	minor3 = _mm_mul_ps(row0, tmp1);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+	minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row3, tmp1));
+	minor3 = _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor3);
+	minor3 = _mm_shuffle_ps(minor3, minor3, 0x4E);
+
+	tmp1 = _mm_mul_ps(_mm_shuffle_ps(row1, row1, 0x4E), row3);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+	row2 = _mm_shuffle_ps(row2, row2, 0x4E);
+	minor0 = _mm_add_ps(_mm_mul_ps(row2, tmp1), minor0);
+	minor2 = _mm_mul_ps(row0, tmp1);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+	minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row2, tmp1));
+	minor2 = _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor2);
+	minor2 = _mm_shuffle_ps(minor2, minor2, 0x4E);
+
+	tmp1 = _mm_mul_ps(row0, row1);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+	minor2 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor2);
+	minor3 = _mm_sub_ps(_mm_mul_ps(row2, tmp1), minor3);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+	minor2 = _mm_sub_ps(_mm_mul_ps(row3, tmp1), minor2);
+	minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row2, tmp1));
+
+	tmp1 = _mm_mul_ps(row0, row3);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+	minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row2, tmp1));
+	minor2 = _mm_add_ps(_mm_mul_ps(row1, tmp1), minor2);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+	minor1 = _mm_add_ps(_mm_mul_ps(row2, tmp1), minor1);
+	minor2 = _mm_sub_ps(minor2, _mm_mul_ps(row1, tmp1));
+
+	tmp1 = _mm_mul_ps(row0, row2);
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+	minor1 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor1);
+	minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row1, tmp1));
+	tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+	minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row3, tmp1));
+	minor3 = _mm_add_ps(_mm_mul_ps(row1, tmp1), minor3);
+
+	det = _mm_mul_ps(row0, minor0);
+	det = _mm_add_ps(_mm_shuffle_ps(det, det, 0x4E), det);
+	det = _mm_add_ss(_mm_shuffle_ps(det, det, 0xB1), det);
+	if (_mm_cvtss_f32(det) == 0.0f) {
+		return false;
+	}
+	det = _mm_div_ss(_mm_set_ss(1.0f), det);
+	det = _mm_shuffle_ps(det, det, 0x00);
+
+	float* dst = &res->m[0][0];
+	_mm_storeu_ps(dst, _mm_mul_ps(det, minor0));
+	_mm_storeu_ps(dst + 4, _mm_mul_ps(det, minor1));
+	_mm_storeu_ps(dst + 8, _mm_mul_ps(det, minor2));
+	_mm_storeu_ps(dst + 12, _mm_mul_ps(det, minor3));
+	return true;
+#else
+	const float* a = &m->m[0][0];
+	float inv[16];
+
+	inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+	inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+	inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+	inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+	inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+	inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+	inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+	inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+	inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+	inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+	inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+	inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+	inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+	inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+	inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+	inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+	float det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+	if (det == 0.0f) {
+		return false;
+	}
+	det = 1.0f / det;
+	float* dst = &res->m[0][0];
+	for (int i = 0; i < 16; i++) {
+		dst[i] = inv[i] * det;
+	}
+	return true;
+#endif
+}
+
+//inverse of a matrix with 0 0 0 1 as its last row: invert the 3x3 part
+//and move the translation through it
+bool mat4_inverse_affine(mat4_t* RESTRICT res, const mat4_t* m) {
+	float(*a)[4] = (float(*)[4])m->m;
+	float c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+	float c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+	float c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+	float det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02;
+	if (det == 0.0f) {
+		return false;
+	}
+	float inv_det = 1.0f / det;
+
+	res->m[0][0] = c00 * inv_det;
+	res->m[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * inv_det;
+	res->m[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * inv_det;
+	res->m[1][0] = c01 * inv_det;
+	res->m[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * inv_det;
+	res->m[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * inv_det;
+	res->m[2][0] = c02 * inv_det;
+	res->m[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * inv_det;
+	res->m[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * inv_det;
+
+	for (int row = 0; row < 3; row++) {
+		res->m[row][3] = -(res->m[row][0] * a[0][3] + res->m[row][1] * a[1][3] + res->m[row][2] * a[2][3]);
+	}
+	res->m[3][0] = 0;
+	res->m[3][1] = 0;
+	res->m[3][2] = 0;
+	res->m[3][3] = 1;
+	return true;
+}
+
+//transforms points (w = 1) by a matrix without projection, the result always has w = 1
+void mat4_transform_points_affine(const mat4_t* m, const vec3_t* RESTRICT points, vec4_t* RESTRICT out, int count) {
+#if USE_SSE2
+	__m128 col0 = _mm_setr_ps(m->m[0][0], m->m[1][0], m->m[2][0], 0.0f);
+	__m128 col1 = _mm_setr_ps(m->m[0][1], m->m[1][1], m->m[2][1], 0.0f);
+	__m128 col2 = _mm_setr_ps(m->m[0][2], m->m[1][2], m->m[2][2], 0.0f);
+	__m128 col3 = _mm_setr_ps(m->m[0][3], m->m[1][3], m->m[2][3], 1.0f);
+	for (int i = 0; i < count; i++) {
+		__m128 result = _mm_add_ps(col3, _mm_mul_ps(col0, _mm_set1_ps(points[i].x)));
+		result = _mm_add_ps(result, _mm_mul_ps(col1, _mm_set1_ps(points[i].y)));
+		result = _mm_add_ps(result, _mm_mul_ps(col2, _mm_set1_ps(points[i].z)));
+		_mm_storeu_ps(&out[i].x, result);
+	}
+#else
+	for (int i = 0; i < count; i++) {
+		vec3_t p = points[i];
+		out[i].x = m->m[0][0] * p.x + m->m[0][1] * p.y + m->m[0][2] * p.z + m->m[0][3];
+		out[i].y = m->m[1][0] * p.x + m->m[1][1] * p.y + m->m[1][2] * p.z + m->m[1][3];
+		out[i].z = m->m[2][0] * p.x + m->m[2][1] * p.y + m->m[2][2] * p.z + m->m[2][3];
+		out[i].w = 1.0f;
+	}
+#endif
+}
+
+void mat4_transform_vec4s(const mat4_t* m, const vec4_t* RESTRICT vectors, vec4_t* RESTRICT out, int count) {
+#if USE_SSE2
+	__m128 col0 = _mm_setr_ps(m->m[0][0], m->m[1][0], m->m[2][0], m->m[3][0]);
+	__m128 col1 = _mm_setr_ps(m->m[0][1], m->m[1][1], m->m[2][1], m->m[3][1]);
+	__m128 col2 = _mm_setr_ps(m->m[0][2], m->m[1][2], m->m[2][2], m->m[3][2]);
+	__m128 col3 = _mm_setr_ps(m->m[0][3], m->m[1][3], m->m[2][3], m->m[3][3]);
+	for (int i = 0; i < count; i++) {
+		__m128 v = _mm_loadu_ps(&vectors[i].x);
+		__m128 result = _mm_mul_ps(col0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+		result = _mm_add_ps(result, _mm_mul_ps(col1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		result = _mm_add_ps(result, _mm_mul_ps(col2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		result = _mm_add_ps(result, _mm_mul_ps(col3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm_storeu_ps(&out[i].x, result);
+	}
+#else
+	for (int i = 0; i < count; i++) {
+		vec4_t v = vectors[i];
+		out[i].x = m->m[0][0] * v.x + m->m[0][1] * v.y + m->m[0][2] * v.z + m->m[0][3] * v.w;
+		out[i].y = m->m[1][0] * v.x + m->m[1][1] * v.y + m->m[1][2] * v.z + m->m[1][3] * v.w;
+		out[i].z = m->m[2][0] * v.x + m->m[2][1] * v.y + m->m[2][2] * v.z + m->m[2][3] * v.w;
+		out[i].w = m->m[3][0] * v.x + m->m[3][1] * v.y + m->m[3][2] * v.z + m->m[3][3] * v.w;
+	}
+#endif
+}
+
+quat_t quat_identity(void) {
+	quat_t q = { 0, 0, 0, 1 };
+	return q;
+}
+
+quat_t quat_from_axis_angle(vec3_t axis, float angle) {
+	vec3_normalize(&axis);
+	float sine = sinf(angle * 0.5f);
+	quat_t q = { axis.x * sine, axis.y * sine, axis.z * sine, cosf(angle * 0.5f) };
+	return q;
+}
+
+//same rotation as rotation_x * rotation_y * rotation_z
+quat_t quat_from_euler(vec3_t rotation) {
+	float sx = sinf(rotation.x * 0.5f), cx = cosf(rotation.x * 0.5f);
+	float sy = sinf(rotation.y * 0.5f), cy = cosf(rotation.y * 0.5f);
+	float sz = sinf(rotation.z * 0.5f), cz = cosf(rotation.z * 0.5f);
+	quat_t q = {
+		sx * cy * cz + cx * sy * sz,
+		cx * sy * cz - sx * cy * sz,
+		cx * cy * sz + sx * sy * cz,
+		cx * cy * cz - sx * sy * sz
+	};
+	return q;
+}
+
+//rotation q2 followed by q1
+quat_t quat_mul(quat_t q1, quat_t q2) {
+	quat_t q = {
+		q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y,
+		q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x,
+		q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w,
+		q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z
+	};
+	return q;
+}
+
+void quat_normalize(quat_t* q) {
+	float length = sqrtf(q->x * q->x + q->y * q->y + q->z * q->z + q->w * q->w);
+	q->x /= length;
+	q->y /= length;
+	q->z /= length;
+	q->w /= length;
+}
+
+//spherical interpolation along the shorter arc, nearly equal rotations fall back to a normalized lerp
+quat_t quat_slerp(quat_t q1, quat_t q2, float t) {
+	float cosine = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+	if (cosine < 0) {
+		cosine = -cosine;
+		q2.x = -q2.x;
+		q2.y = -q2.y;
+		q2.z = -q2.z;
+		q2.w = -q2.w;
+	}
+
+	float w1 = 1.0f - t;
+	float w2 = t;
+	if (cosine < 0.9995f) {
+		float angle = acosf(cosine);
+		float inv_sine = 1.0f / sinf(angle);
+		w1 = sinf((1.0f - t) * angle) * inv_sine;
+		w2 = sinf(t * angle) * inv_sine;
+	}
+
+	quat_t q = {
+		q1.x * w1 + q2.x * w2,
+		q1.y * w1 + q2.y * w2,
+		q1.z * w1 + q2.z * w2,
+		q1.w * w1 + q2.w * w2
+	};
+	quat_normalize(&q);
+	return q;
+}
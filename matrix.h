@@ -1,12 +1,18 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <stdbool.h>
 #include "vector.h"
+#include "simd.h"
 
 typedef struct {
 	float m[4][4];
 } mat4_t;
 
+typedef struct {
+	float x, y, z, w;
+} quat_t;
+
 mat4_t mat4_identity(void);
 mat4_t mat4_make_scale(float scaleX, float scaleY, float scaleZ);
 mat4_t mat4_make_translation(float tX, float tY, float tZ);
@@ -16,10 +22,27 @@ mat4_t mat4_make_rotation_y(float angle);
 mat4_t mat4_make_rotation_z(float angle);
 
 mat4_t mat4_make_perspective(float fov, float aspect, float znear, float zfar);
+mat4_t mat4_look_at(vec3_t eye, vec3_t target, vec3_t up);
 vec4_t mat4_mul_vec4_project(mat4_t mat_proj, vec4_t v);
 
 vec4_t mat4_mul_vec4(mat4_t m, vec4_t v);
 mat4_t mat4_mul_mat4(mat4_t m1, mat4_t m2);
-void mat4_mul_mat4_faster(mat4_t* res, mat4_t* m1, mat4_t* m2);
+void mat4_mul_mat4_faster(mat4_t* RESTRICT res, const mat4_t* m1, const mat4_t* m2);
+
+//pointer based versions for hot paths, res must not overlap the inputs
+void mat4_make_trs(mat4_t* RESTRICT res, vec3_t scale, vec3_t rotation, vec3_t translation);
+void mat4_make_trs_quat(mat4_t* RESTRICT res, vec3_t scale, quat_t rotation, vec3_t translation);
+void mat4_mul_mat4_affine(mat4_t* RESTRICT res, const mat4_t* m1, const mat4_t* m2);
+bool mat4_inverse(mat4_t* RESTRICT res, const mat4_t* m);
+bool mat4_inverse_affine(mat4_t* RESTRICT res, const mat4_t* m);
+void mat4_transform_points_affine(const mat4_t* m, const vec3_t* RESTRICT points, vec4_t* RESTRICT out, int count);
+void mat4_transform_vec4s(const mat4_t* m, const vec4_t* RESTRICT vectors, vec4_t* RESTRICT out, int count);
+
+quat_t quat_identity(void);
+quat_t quat_from_axis_angle(vec3_t axis, float angle);
+quat_t quat_from_euler(vec3_t rotation);
+quat_t quat_mul(quat_t q1, quat_t q2);
+void quat_normalize(quat_t* q);
+quat_t quat_slerp(quat_t q1, quat_t q2, float t);
 
 #endif
@@ -1,13 +1,22 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 #include "array.h"
 #include "mesh.h"
+#include "obj_loader.h"
 
 mesh_t mesh = {
 	.vertices = NULL,
 	.faces = NULL,
+	.packed = NULL,
+	.edges = NULL,
 	.rotation = {0 , 0 , 0},
 	.scale = {1.0 , 1.0 , 1.0},
-	.translation = {0 , 0 , 0}
+	.translation = {0 , 0 , 0},
+	.screen_bounds = {0, 0, 0, 0},
+	.bounds_center = {0, 0, 0},
+	.bounds_radius = 0,
+	.skin = NULL
 };
 
 vec3_t cube_vertices[N_CUBE_VERTICES] = {
@@ -56,38 +65,195 @@ void load_cube_mesh_data(void) {
 
 }
 
+//the import runs on every core, see obj_loader.c
 void load_obj_file_data(char* filename) {
-	FILE* file;
-	char line[512];
+	obj_load_parallel(filename, &mesh, 0);
+}
+
+//sphere around the center of the axis aligned bounds, not the tightest one but cheap
+void mesh_compute_bounds(mesh_t* m) {
+	int num_vertices = array_length(m->vertices);
+	if (num_vertices == 0) {
+		m->bounds_center = (vec3_t){ 0, 0, 0 };
+		m->bounds_radius = 0;
+		return;
+	}
 
-	if (fopen_s(&file, filename, "r") != 0) {
-		fprintf(stderr, "cannot open file.\n");
-		return 1;
+	vec3_t min = m->vertices[0];
+	vec3_t max = m->vertices[0];
+	for (int i = 1; i < num_vertices; i++) {
+		vec3_t v = m->vertices[i];
+		if (v.x < min.x) min.x = v.x;
+		if (v.y < min.y) min.y = v.y;
+		if (v.z < min.z) min.z = v.z;
+		if (v.x > max.x) max.x = v.x;
+		if (v.y > max.y) max.y = v.y;
+		if (v.z > max.z) max.z = v.z;
 	}
 
-	while (fgets(line, 512, file)) {
-		if (line[0] == 'v' && line[1] == ' ') {
-			vec3_t vertex;
-			sscanf_s(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-			array_push(mesh.vertices, vertex);
+	m->bounds_center = vec3_mul(vec3_add(min, max), 0.5f);
+	m->bounds_radius = 0;
+	for (int i = 0; i < num_vertices; i++) {
+		float distance = vec3_length(vec3_sub(m->vertices[i], m->bounds_center));
+		if (distance > m->bounds_radius) {
+			m->bounds_radius = distance;
 		}
+	}
+}
+
+//replaces the vertices and faces with their compressed form, edges and bounds
+//have to be built before because they need the full precision geometry
+bool mesh_pack(mesh_t* m) {
+	if (m->skin) {
+		//skin_transform reads the float vertices, which packing would free and replace with
+		//positions quantized against the bounds of the whole mesh
+		fprintf(stderr, "A skinned mesh cannot be packed, it stays uncompressed.\n");
+		return true;
+	}
+	packed_mesh_t* packed = packed_mesh_create(m->vertices, array_length(m->vertices), m->faces, array_length(m->faces));
+	if (!packed) {
+		return false;
+	}
+
+	array_free(m->vertices);
+	array_free(m->faces);
+	m->vertices = NULL;
+	m->faces = NULL;
+	m->packed = packed;
+	return true;
+}
+
+//replaces the alpha of every face color, faces below 255 are drawn as transparent
+void mesh_set_alpha(mesh_t* m, uint8_t alpha) {
+	uint32_t alpha_bits = (uint32_t)alpha << 24;
+	int num_faces = array_length(m->faces);
+	for (int i = 0; i < num_faces; i++) {
+		m->faces[i].color = (m->faces[i].color & 0x00FFFFFF) | alpha_bits;
+	}
+	if (m->packed) {
+		m->packed->color = (m->packed->color & 0x00FFFFFF) | alpha_bits;
+		for (int i = 0; m->packed->face_colors && i < m->packed->num_faces; i++) {
+			m->packed->face_colors[i] = (m->packed->face_colors[i] & 0x00FFFFFF) | alpha_bits;
+		}
+	}
+}
+
+//zero based vertex indices of a face. cluster is a cursor into the clusters of a packed
+//mesh, it has to start at 0 and the faces have to be asked for in increasing order
+void mesh_face_indices(const mesh_t* m, int face, int* cluster, int indices[3]) {
+	if (m->packed) {
+		const packed_mesh_t* packed = m->packed;
+		while (face >= packed->clusters[*cluster + 1].first_face) {
+			(*cluster)++;
+		}
+		int vertex_base = packed->clusters[*cluster].vertex_base;
+		indices[0] = vertex_base + packed->faces[face].a;
+		indices[1] = vertex_base + packed->faces[face].b;
+		indices[2] = vertex_base + packed->faces[face].c;
+	}
+	else {
+		indices[0] = m->faces[face].a - 1;
+		indices[1] = m->faces[face].b - 1;
+		indices[2] = m->faces[face].c - 1;
+	}
+}
+
+int mesh_vertex_count(const mesh_t* m) {
+	return m->packed ? m->packed->num_vertices : array_length(m->vertices);
+}
+
+int mesh_face_count(const mesh_t* m) {
+	return m->packed ? m->packed->num_faces : array_length(m->faces);
+}
 
-		if (line[0] == 'f' && line[1] == ' ') {
-			int vertex_indices[3];
-			int textrue_indices[3];
-			int normal_indices[3];
-			sscanf_s(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-				&vertex_indices[0], &textrue_indices[0], &normal_indices[0],
-				&vertex_indices[1], &textrue_indices[1], &normal_indices[1], 
-				&vertex_indices[2], &textrue_indices[2], &normal_indices[2]);
-
-			face_t face = {
-				.a = vertex_indices[0],
-				.b = vertex_indices[1],
-				.c = vertex_indices[2],
-				.color = 0xFFFFFFFF
-			};
-			array_push(mesh.faces, face);
+//attaches the skeleton and animation of a .skin file to the vertices that are loaded
+bool mesh_load_skin(mesh_t* m, const char* filename) {
+	if (m->packed) {
+		fprintf(stderr, "A packed mesh cannot be skinned, load the skin before packing.\n");
+		return false;
+	}
+	skin_t* skin = skin_load(filename, m->vertices, array_length(m->vertices));
+	if (!skin) {
+		return false;
+	}
+	skin_free(m->skin);
+	m->skin = skin;
+	mesh_animate(m, 0.0f);
+	return true;
+}
+
+//poses a skinned mesh for a time in seconds, the bounds follow so culling keeps working
+void mesh_animate(mesh_t* m, float time) {
+	if (m->skin) {
+		skin_evaluate(m->skin, time, &m->bounds_center, &m->bounds_radius);
+	}
+}
+
+//releases the geometry so another file can be loaded into the mesh
+void mesh_free(mesh_t* m) {
+	skin_free(m->skin);
+	m->skin = NULL;
+	array_free(m->vertices);
+	array_free(m->faces);
+	array_free(m->edges);
+	packed_mesh_free(m->packed);
+	m->vertices = NULL;
+	m->faces = NULL;
+	m->edges = NULL;
+	m->packed = NULL;
+	m->screen_bounds = rect_empty();
+}
+
+//collects every edge once, using an open addressing hash table keyed by the sorted vertex pair
+void mesh_build_edges(mesh_t* m) {
+	array_free(m->edges);
+	m->edges = NULL;
+
+	int num_faces = array_length(m->faces);
+	int table_size = 16;
+	while (table_size < num_faces * 3 * 2) {
+		table_size *= 2;
+	}
+	int* table = (int*)malloc(sizeof(int) * table_size);
+	if (!table) {
+		fprintf(stderr, "Error creating the edge table. Probably not enough avaliable memory.\n");
+		return;
+	}
+	for (int i = 0; i < table_size; i++) {
+		table[i] = -1;
+	}
+
+	for (int i = 0; i < num_faces; i++) {
+		int indices[3] = { m->faces[i].a - 1, m->faces[i].b - 1, m->faces[i].c - 1 };
+		for (int j = 0; j < 3; j++) {
+			int a = indices[j];
+			int b = indices[(j + 1) % 3];
+			if (a > b) {
+				int temp = a;
+				a = b;
+				b = temp;
+			}
+
+			unsigned int hash = ((unsigned int)a * 73856093u) ^ ((unsigned int)b * 19349663u);
+			int slot = hash & (table_size - 1);
+			while (table[slot] != -1) {
+				mesh_edge_t* edge = &m->edges[table[slot]];
+				if (edge->a == a && edge->b == b) {
+					break;
+				}
+				slot = (slot + 1) & (table_size - 1);
+			}
+
+			if (table[slot] == -1) {
+				mesh_edge_t edge = { .a = a, .b = b, .faces = { i, -1 } };
+				table[slot] = array_length(m->edges);
+				array_push(m->edges, edge);
+			}
+			else if (m->edges[table[slot]].faces[1] == -1) {
+				m->edges[table[slot]].faces[1] = i;
+			}
 		}
 	}
-}
\ No newline at end of file
+
+	free(table);
+}
@@ -3,6 +3,9 @@
 
 #include "vector.h"
 #include "triangle.h"
+#include "rect.h"
+#include "packed_mesh.h"
+#include "skin.h"
 
 #define N_CUBE_VERTICES 8
 #define N_CUBE_FACES (6 * 2) //6 cube faces, 2 triangles per face
@@ -10,17 +13,41 @@
 extern vec3_t cube_vertices[N_CUBE_VERTICES];
 extern face_t cube_faces[N_CUBE_FACES];
 
+//edge shared by up to two faces, vertex indices are zero based,
+//faces[1] is -1 for edges on the border of an open mesh
+typedef struct {
+	int a;
+	int b;
+	int faces[2];
+} mesh_edge_t;
+
 typedef struct {
 	vec3_t* vertices;
 	face_t* faces;
+	packed_mesh_t* packed; //compressed geometry, vertices and faces are NULL while it is set
+	mesh_edge_t* edges; //unique edges, built once after loading
 	vec3_t rotation;
 	vec3_t scale;
 	vec3_t translation;
+	rect_t screen_bounds; //area the mesh covered on screen in the last rendered frame
+	vec3_t bounds_center; //bounding sphere in model space, for frustum culling
+	float bounds_radius;
+	skin_t* skin; //skeletal animation, NULL for a rigid mesh
 } mesh_t;
 
 extern mesh_t mesh;
 
 void load_cube_mesh_data(void);
 void load_obj_file_data(char* filename);
+void mesh_build_edges(mesh_t* m);
+void mesh_compute_bounds(mesh_t* m);
+bool mesh_pack(mesh_t* m);
+void mesh_set_alpha(mesh_t* m, uint8_t alpha);
+void mesh_face_indices(const mesh_t* m, int face, int* cluster, int indices[3]);
+int mesh_vertex_count(const mesh_t* m);
+int mesh_face_count(const mesh_t* m);
+bool mesh_load_skin(mesh_t* m, const char* filename);
+void mesh_animate(mesh_t* m, float time);
+void mesh_free(mesh_t* m);
 
 #endif
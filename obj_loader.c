@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <SDL.h>
+#include "array.h"
+#include "file.h"
+#include "thread_pool.h"
+#include "obj_loader.h"
+
+//more ranges than threads, so threads that got the cheaper vertex lines pick up more work
+#define OBJ_RANGES_PER_THREAD 4
+#define OBJ_READ_BLOCK (1 << 20)
+#define OBJ_MAX_FACE_CORNERS 64
+
+//corner of a face given relative to the vertices of its own range (negative index in the file)
+#define OBJ_RELATIVE_A 1
+#define OBJ_RELATIVE_B 2
+#define OBJ_RELATIVE_C 4
+
+//one byte range of the file: the parse job fills the blocks, the merge job copies them into the mesh
+typedef struct {
+	const char* filename;
+	uint64_t start;
+	uint64_t end;
+	bool ok;
+
+	vec3_t* vertices;
+	face_t* faces;
+	uint8_t* relative; //OBJ_RELATIVE_ flags per face
+
+	mesh_t* mesh;
+	int vertex_offset; //vertices the mesh had before this file
+	int vertex_base;   //vertices of the file in the ranges before this one
+	int face_base;
+	int total_vertices;
+	int invalid_faces;
+} obj_range_t;
+
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+//plain decimal and exponent notation, no locale, no allocation
+static const char* parse_float(const char* p, const char* end, float* value) {
+	while (p < end && is_space(*p)) p++;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa > 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa > 0;
+				exponent--;
+			}
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negative_exponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative_exponent = *p == '-';
+			p++;
+		}
+		int e = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++) {
+			if (e < 10000) {
+				e = e * 10 + (*p - '0');
+			}
+		}
+		exponent += negative_exponent ? -e : e;
+	}
+
+	double result = (double)mantissa;
+	if (exponent >= 0) {
+		result *= exponent <= 22 ? powers_of_ten[exponent] : pow(10.0, exponent);
+	}
+	else {
+		result /= -exponent <= 22 ? powers_of_ten[-exponent] : pow(10.0, -exponent);
+	}
+	*value = (float)(negative ? -result : result);
+	return p;
+}
+
+//one "f" corner: v, v/vt, v//vn or v/vt/vn, only the vertex index is used
+static const char* parse_corner(const char* p, const char* end, int* index, bool* found) {
+	while (p < end && is_space(*p)) p++;
+	*found = false;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	long long value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		*found = true;
+		if (value < INT32_MAX) {
+			value = value * 10 + (*p - '0');
+		}
+	}
+	*index = (int)(negative ? -value : value);
+
+	while (p < end && !is_space(*p)) p++;
+	return p;
+}
+
+static void parse_line(obj_range_t* range, const char* p, const char* end) {
+	while (p < end && is_space(*p)) p++;
+	if (end - p < 2 || !is_space(p[1])) {
+		return;
+	}
+
+	if (p[0] == 'v') {
+		vec3_t vertex;
+		p = parse_float(p + 1, end, &vertex.x);
+		p = parse_float(p, end, &vertex.y);
+		parse_float(p, end, &vertex.z);
+		array_push(range->vertices, vertex);
+	}
+	else if (p[0] == 'f') {
+		int corners[OBJ_MAX_FACE_CORNERS];
+		bool relative[OBJ_MAX_FACE_CORNERS];
+		int num_corners = 0;
+		int local_vertices = array_length(range->vertices);
+
+		p++;
+		while (num_corners < OBJ_MAX_FACE_CORNERS) {
+			bool found;
+			int index;
+			p = parse_corner(p, end, &index, &found);
+			if (!found) {
+				break;
+			}
+			//-1 is the last vertex before this line, which may be in an earlier range.
+			//resolved against this range here and against the file when merging
+			relative[num_corners] = index < 0;
+			corners[num_corners] = index < 0 ? local_vertices + index + 1 : index;
+			num_corners++;
+		}
+
+		//polygons become a triangle fan
+		for (int i = 1; i + 1 < num_corners; i++) {
+			face_t face = {
+				.a = corners[0],
+				.b = corners[i],
+				.c = corners[i + 1],
+				.color = 0xFFFFFFFF
+			};
+			uint8_t flags = (relative[0] ? OBJ_RELATIVE_A : 0) | (relative[i] ? OBJ_RELATIVE_B : 0) | (relative[i + 1] ? OBJ_RELATIVE_C : 0);
+			array_push(range->faces, face);
+			array_push(range->relative, flags);
+		}
+	}
+}
+
+//a range owns every line that starts inside of it, including the end of its last line
+static void parse_range_job(void* data) {
+	obj_range_t* range = (obj_range_t*)data;
+	range->ok = false;
+
+	FILE* file;
+	if (fopen_s(&file, range->filename, "rb") != 0 || !file) {
+		fprintf(stderr, "cannot open %s.\n", range->filename);
+		return;
+	}
+
+	uint64_t position = range->start;
+	if (position > 0) {
+		//the partial line at the start belongs to the previous range
+		file_seek(file, position - 1);
+		int c;
+		while ((c = fgetc(file)) != EOF && c != '\n') {
+			position++;
+		}
+	}
+	else {
+		file_seek(file, 0);
+	}
+
+	char* buffer = (char*)malloc(OBJ_READ_BLOCK);
+	if (!buffer) {
+		fprintf(stderr, "Error creating the obj read buffer. Probably not enough avaliable memory.\n");
+		fclose(file);
+		return;
+	}
+
+	size_t filled = 0;
+	bool done = false;
+	bool ok = true;
+	while (!done) {
+		if (filled == OBJ_READ_BLOCK) {
+			fprintf(stderr, "%s has a line longer than %d bytes.\n", range->filename, OBJ_READ_BLOCK);
+			ok = false;
+			break;
+		}
+		size_t read = fread(buffer + filled, 1, OBJ_READ_BLOCK - filled, file);
+		filled += read;
+		bool end_of_file = read == 0;
+
+		size_t line_start = 0;
+		while (!done) {
+			if (position + line_start >= range->end || line_start == filled) {
+				done = position + line_start >= range->end || end_of_file;
+				break;
+			}
+			char* newline = (char*)memchr(buffer + line_start, '\n', filled - line_start);
+			if (!newline) {
+				if (end_of_file) {
+					//last line of the file without a line break
+					parse_line(range, buffer + line_start, buffer + filled);
+					done = true;
+				}
+				break;
+			}
+			parse_line(range, buffer + line_start, newline);
+			line_start = newline - buffer + 1;
+		}
+
+		memmove(buffer, buffer + line_start, filled - line_start);
+		filled -= line_start;
+		position += line_start;
+	}
+
+	free(buffer);
+	fclose(file);
+	range->ok = ok;
+}
+
+//copies the blocks of one range into its slice of the mesh and turns every index absolute
+static void merge_range_job(void* data) {
+	obj_range_t* range = (obj_range_t*)data;
+	int num_vertices = array_length(range->vertices);
+	int num_faces = array_length(range->faces);
+
+	if (num_vertices > 0) {
+		memcpy(range->mesh->vertices + range->vertex_offset + range->vertex_base, range->vertices, sizeof(vec3_t) * num_vertices);
+	}
+
+	face_t* faces = range->mesh->faces + range->face_base;
+	for (int i = 0; i < num_faces; i++) {
+		face_t face = range->faces[i];
+		uint8_t flags = range->relative[i];
+		if (flags & OBJ_RELATIVE_A) face.a += range->vertex_base;
+		if (flags & OBJ_RELATIVE_B) face.b += range->vertex_base;
+		if (flags & OBJ_RELATIVE_C) face.c += range->vertex_base;
+
+		bool valid =
+			face.a >= 1 && face.a <= range->total_vertices &&
+			face.b >= 1 && face.b <= range->total_vertices &&
+			face.c >= 1 && face.c <= range->total_vertices;
+		if (!valid) {
+			//dropped after the merge
+			range->invalid_faces++;
+			face.a = 0;
+		}
+		else {
+			face.a += range->vertex_offset;
+			face.b += range->vertex_offset;
+			face.c += range->vertex_offset;
+		}
+		faces[i] = face;
+	}
+}
+
+static void run_job(thread_pool_t* pool, job_function_t function, void* data) {
+	if (pool) {
+		thread_pool_submit(pool, function, data);
+	}
+	else {
+		function(data);
+	}
+}
+
+//appends the geometry of an .obj file to the mesh. the file is split into byte ranges on
+//line boundaries that are parsed on all threads, then the blocks are merged in parallel.
+//num_threads 0 uses one thread per core
+bool obj_load_parallel(const char* filename, mesh_t* m, int num_threads) {
+	FILE* file;
+	if (fopen_s(&file, filename, "rb") != 0 || !file) {
+		fprintf(stderr, "cannot open %s.\n", filename);
+		return false;
+	}
+	uint64_t size = file_size(file);
+	fclose(file);
+
+	if (num_threads <= 0) {
+		num_threads = SDL_GetCPUCount();
+	}
+	uint64_t num_ranges = size / OBJ_MIN_RANGE_SIZE;
+	uint64_t max_ranges = (uint64_t)num_threads * OBJ_RANGES_PER_THREAD;
+	num_ranges = num_ranges < 1 ? 1 : (num_ranges > max_ranges ? max_ranges : num_ranges);
+
+	obj_range_t* ranges = (obj_range_t*)calloc((size_t)num_ranges, sizeof(obj_range_t));
+	if (!ranges) {
+		fprintf(stderr, "Error creating the obj ranges. Probably not enough avaliable memory.\n");
+		return false;
+	}
+
+	//small files are parsed right here
+	int pool_threads = num_threads < (int)num_ranges ? num_threads : (int)num_ranges;
+	thread_pool_t* pool = pool_threads > 1 ? thread_pool_create(pool_threads, "obj import") : NULL;
+
+	for (uint64_t i = 0; i < num_ranges; i++) {
+		ranges[i].filename = filename;
+		ranges[i].start = size * i / num_ranges;
+		ranges[i].end = size * (i + 1) / num_ranges;
+		run_job(pool, parse_range_job, &ranges[i]);
+	}
+	if (pool) {
+		thread_pool_wait(pool);
+	}
+
+	bool ok = true;
+	int total_vertices = 0;
+	int total_faces = 0;
+	for (uint64_t i = 0; i < num_ranges; i++) {
+		ok = ok && ranges[i].ok;
+		ranges[i].vertex_base = total_vertices;
+		ranges[i].face_base = total_faces;
+		total_vertices += array_length(ranges[i].vertices);
+		total_faces += array_length(ranges[i].faces);
+	}
+
+	int invalid_faces = 0;
+	if (ok) {
+		int vertex_offset = array_length(m->vertices);
+		int face_offset = array_length(m->faces);
+		m->vertices = (vec3_t*)array_hold(m->vertices, total_vertices, sizeof(vec3_t));
+		m->faces = (face_t*)array_hold(m->faces, total_faces, sizeof(face_t));
+
+		for (uint64_t i = 0; i < num_ranges; i++) {
+			ranges[i].mesh = m;
+			ranges[i].vertex_offset = vertex_offset;
+			ranges[i].face_base += face_offset;
+			ranges[i].total_vertices = total_vertices;
+			run_job(pool, merge_range_job, &ranges[i]);
+		}
+		if (pool) {
+			thread_pool_wait(pool);
+		}
+
+		for (uint64_t i = 0; i < num_ranges; i++) {
+			invalid_faces += ranges[i].invalid_faces;
+		}
+		if (invalid_faces > 0) {
+			fprintf(stderr, "%s: %d faces reference missing vertices and were dropped.\n", filename, invalid_faces);
+			int kept = face_offset;
+			for (int i = face_offset; i < face_offset + total_faces; i++) {
+				if (m->faces[i].a != 0) {
+					m->faces[kept++] = m->faces[i];
+				}
+			}
+			array_truncate(m->faces, kept);
+		}
+	}
+
+	thread_pool_destroy(pool);
+	for (uint64_t i = 0; i < num_ranges; i++) {
+		array_free(ranges[i].vertices);
+		array_free(ranges[i].faces);
+		array_free(ranges[i].relative);
+	}
+	free(ranges);
+	return ok;
+}
@@ -0,0 +1,14 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <stdbool.h>
+#include "mesh.h"
+
+//byte range of the file each parse job works on, ranges smaller than this are not split further
+#ifndef OBJ_MIN_RANGE_SIZE
+#define OBJ_MIN_RANGE_SIZE (1 << 20)
+#endif
+
+bool obj_load_parallel(const char* filename, mesh_t* m, int num_threads);
+
+#endif
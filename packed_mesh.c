@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "packed_mesh.h"
+
+static float sign_not_zero(float v) {
+	return v < 0.0f ? -1.0f : 1.0f;
+}
+
+//projects the unit vector onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the upper one
+static void encode_octahedral(vec3_t n, int8_t out[2]) {
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum == 0.0f) {
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float x = n.x / sum;
+	float y = n.y / sum;
+	if (n.z < 0.0f) {
+		float folded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+		y = (1.0f - fabsf(x)) * sign_not_zero(y);
+		x = folded_x;
+	}
+	out[0] = (int8_t)lrintf(x * 127.0f);
+	out[1] = (int8_t)lrintf(y * 127.0f);
+}
+
+static vec3_t decode_octahedral(const int8_t in[2]) {
+	vec3_t n = { in[0] / 127.0f, in[1] / 127.0f, 0.0f };
+	n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+	if (n.z < 0.0f) {
+		float unfolded_x = (1.0f - fabsf(n.y)) * sign_not_zero(n.x);
+		n.y = (1.0f - fabsf(n.x)) * sign_not_zero(n.y);
+		n.x = unfolded_x;
+	}
+	return n;
+}
+
+static uint16_t quantize(float v, float offset, float step) {
+	if (step == 0.0f) {
+		return 0;
+	}
+	long q = lrintf((v - offset) / step);
+	return (uint16_t)(q < 0 ? 0 : (q > 65535 ? 65535 : q));
+}
+
+//face indices are 1 based like in face_t, the packed mesh keeps its own copy of everything
+packed_mesh_t* packed_mesh_create(const vec3_t* vertices, int num_vertices, const face_t* faces, int num_faces) {
+	packed_mesh_t* packed = (packed_mesh_t*)calloc(1, sizeof(packed_mesh_t));
+	if (!packed) {
+		fprintf(stderr, "Error creating the packed mesh. Probably not enough avaliable memory.\n");
+		return NULL;
+	}
+	packed->num_vertices = num_vertices;
+	packed->num_faces = num_faces;
+	packed->positions = (packed_position_t*)calloc(num_vertices + 1, sizeof(packed_position_t));
+	packed->faces = (packed_face_t*)malloc(sizeof(packed_face_t) * (num_faces > 0 ? num_faces : 1));
+	packed->clusters = (packed_cluster_t*)malloc(sizeof(packed_cluster_t) * (num_faces + 1));
+	if (!packed->positions || !packed->faces || !packed->clusters) {
+		fprintf(stderr, "Error creating the packed mesh. Probably not enough avaliable memory.\n");
+		packed_mesh_free(packed);
+		return NULL;
+	}
+
+	//positions, 65535 steps between the smallest and the largest coordinate on every axis
+	vec3_t min = { 0, 0, 0 };
+	vec3_t max = { 0, 0, 0 };
+	for (int i = 0; i < num_vertices; i++) {
+		vec3_t v = vertices[i];
+		if (i == 0 || v.x < min.x) min.x = v.x;
+		if (i == 0 || v.y < min.y) min.y = v.y;
+		if (i == 0 || v.z < min.z) min.z = v.z;
+		if (i == 0 || v.x > max.x) max.x = v.x;
+		if (i == 0 || v.y > max.y) max.y = v.y;
+		if (i == 0 || v.z > max.z) max.z = v.z;
+	}
+	packed->quantization_offset = min;
+	packed->quantization_step = vec3_div(vec3_sub(max, min), 65535.0f);
+	for (int i = 0; i < num_vertices; i++) {
+		packed->positions[i].x = quantize(vertices[i].x, min.x, packed->quantization_step.x);
+		packed->positions[i].y = quantize(vertices[i].y, min.y, packed->quantization_step.y);
+		packed->positions[i].z = quantize(vertices[i].z, min.z, packed->quantization_step.z);
+	}
+
+	//clusters, a new one starts whenever the next face would not fit into 16 bit indices
+	int lowest = 0;
+	int highest = 0;
+	for (int i = 0; i < num_faces; i++) {
+		int a = faces[i].a - 1, b = faces[i].b - 1, c = faces[i].c - 1;
+		int face_lowest = a < b ? (a < c ? a : c) : (b < c ? b : c);
+		int face_highest = a > b ? (a > c ? a : c) : (b > c ? b : c);
+		if (face_highest - face_lowest >= PACKED_CLUSTER_SPAN) {
+			fprintf(stderr, "cannot pack face %d, its vertices are too far apart.\n", i + 1);
+			packed_mesh_free(packed);
+			return NULL;
+		}
+
+		int new_lowest = face_lowest < lowest ? face_lowest : lowest;
+		int new_highest = face_highest > highest ? face_highest : highest;
+		if (packed->num_clusters == 0 || new_highest - new_lowest >= PACKED_CLUSTER_SPAN) {
+			if (packed->num_clusters > 0) {
+				packed->clusters[packed->num_clusters - 1].vertex_base = lowest;
+			}
+			packed->clusters[packed->num_clusters].first_face = i;
+			packed->num_clusters++;
+			lowest = face_lowest;
+			highest = face_highest;
+		}
+		else {
+			lowest = new_lowest;
+			highest = new_highest;
+		}
+	}
+	if (packed->num_clusters > 0) {
+		packed->clusters[packed->num_clusters - 1].vertex_base = lowest;
+	}
+	packed->clusters[packed->num_clusters].first_face = num_faces;
+	packed->clusters[packed->num_clusters].vertex_base = 0;
+
+	//faces, the normal comes from the full precision positions
+	for (int cluster = 0; cluster < packed->num_clusters; cluster++) {
+		int base = packed->clusters[cluster].vertex_base;
+		for (int i = packed->clusters[cluster].first_face; i < packed->clusters[cluster + 1].first_face; i++) {
+			face_t face = faces[i];
+			packed_face_t* packed_face = &packed->faces[i];
+			packed_face->a = (uint16_t)(face.a - 1 - base);
+			packed_face->b = (uint16_t)(face.b - 1 - base);
+			packed_face->c = (uint16_t)(face.c - 1 - base);
+
+			vec3_t ab = vec3_sub(vertices[face.b - 1], vertices[face.a - 1]);
+			vec3_t ac = vec3_sub(vertices[face.c - 1], vertices[face.a - 1]);
+			vec3_t normal = vec3_cross(ab, ac);
+			if (vec3_length(normal) > 0.0f) {
+				vec3_normalize(&normal);
+			}
+			encode_octahedral(normal, packed_face->normal);
+		}
+	}
+
+	//one color for the whole mesh unless the faces actually differ
+	packed->color = num_faces > 0 ? faces[0].color : 0xFFFFFFFF;
+	for (int i = 1; i < num_faces; i++) {
+		if (faces[i].color != packed->color) {
+			packed->face_colors = (uint32_t*)malloc(sizeof(uint32_t) * num_faces);
+			if (!packed->face_colors) {
+				fprintf(stderr, "Error creating the packed mesh. Probably not enough avaliable memory.\n");
+				packed_mesh_free(packed);
+				return NULL;
+			}
+			for (int j = 0; j < num_faces; j++) {
+				packed->face_colors[j] = faces[j].color;
+			}
+			break;
+		}
+	}
+
+	return packed;
+}
+
+void packed_mesh_free(packed_mesh_t* packed) {
+	if (!packed) {
+		return;
+	}
+	free(packed->positions);
+	free(packed->faces);
+	free(packed->clusters);
+	free(packed->face_colors);
+	free(packed);
+}
+
+size_t packed_mesh_bytes(const packed_mesh_t* packed) {
+	size_t bytes = sizeof(packed_mesh_t);
+	bytes += sizeof(packed_position_t) * (packed->num_vertices + 1);
+	bytes += sizeof(packed_face_t) * packed->num_faces;
+	bytes += sizeof(packed_cluster_t) * (packed->num_clusters + 1);
+	if (packed->face_colors) {
+		bytes += sizeof(uint32_t) * packed->num_faces;
+	}
+	return bytes;
+}
+
+//decodes and transforms every position in one pass, the dequantization is folded into the matrix:
+//world * (offset + step * q) = (world * translation(offset) * scale(step)) * q
+void packed_mesh_transform(const packed_mesh_t* packed, const mat4_t* world_matrix, vec4_t* out) {
+	const mat4_t* w = world_matrix;
+	vec3_t offset = packed->quantization_offset;
+	vec3_t step = packed->quantization_step;
+
+	mat4_t decode;
+	for (int row = 0; row < 3; row++) {
+		decode.m[row][0] = w->m[row][0] * step.x;
+		decode.m[row][1] = w->m[row][1] * step.y;
+		decode.m[row][2] = w->m[row][2] * step.z;
+		decode.m[row][3] = w->m[row][0] * offset.x + w->m[row][1] * offset.y + w->m[row][2] * offset.z + w->m[row][3];
+	}
+
+	const packed_position_t* positions = packed->positions;
+	int count = packed->num_vertices;
+#if USE_SSE2
+	__m128 col0 = _mm_setr_ps(decode.m[0][0], decode.m[1][0], decode.m[2][0], 0.0f);
+	__m128 col1 = _mm_setr_ps(decode.m[0][1], decode.m[1][1], decode.m[2][1], 0.0f);
+	__m128 col2 = _mm_setr_ps(decode.m[0][2], decode.m[1][2], decode.m[2][2], 0.0f);
+	__m128 col3 = _mm_setr_ps(decode.m[0][3], decode.m[1][3], decode.m[2][3], 1.0f);
+	__m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < count; i++) {
+		//8 byte load, the last two bytes belong to the next position (or the padding entry) and are ignored
+		__m128i raw = _mm_loadl_epi64((const __m128i*)&positions[i]);
+		__m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zero));
+		__m128 result = _mm_add_ps(col3, _mm_mul_ps(col0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))));
+		result = _mm_add_ps(result, _mm_mul_ps(col1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		result = _mm_add_ps(result, _mm_mul_ps(col2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		_mm_storeu_ps(&out[i].x, result);
+	}
+#else
+	for (int i = 0; i < count; i++) {
+		float x = positions[i].x, y = positions[i].y, z = positions[i].z;
+		out[i].x = decode.m[0][0] * x + decode.m[0][1] * y + decode.m[0][2] * z + decode.m[0][3];
+		out[i].y = decode.m[1][0] * x + decode.m[1][1] * y + decode.m[1][2] * z + decode.m[1][3];
+		out[i].z = decode.m[2][0] * x + decode.m[2][1] * y + decode.m[2][2] * z + decode.m[2][3];
+		out[i].w = 1.0f;
+	}
+#endif
+}
+
+//cofactor matrix of the upper 3x3 of the world matrix, it maps model space normals to the same
+//direction the cross product of the transformed edges has, including mirroring scales
+void packed_mesh_normal_matrix(mat4_t* RESTRICT res, const mat4_t* world_matrix) {
+	vec3_t rows[3];
+	for (int row = 0; row < 3; row++) {
+		rows[row] = (vec3_t){ world_matrix->m[row][0], world_matrix->m[row][1], world_matrix->m[row][2] };
+	}
+
+	*res = mat4_identity();
+	for (int row = 0; row < 3; row++) {
+		vec3_t cofactor = vec3_cross(rows[(row + 1) % 3], rows[(row + 2) % 3]);
+		res->m[row][0] = cofactor.x;
+		res->m[row][1] = cofactor.y;
+		res->m[row][2] = cofactor.z;
+	}
+}
+
+//world space unit normal of a packed face
+vec3_t packed_mesh_face_normal(const packed_face_t* face, const mat4_t* normal_matrix) {
+	vec3_t n = decode_octahedral(face->normal);
+	const mat4_t* m = normal_matrix;
+	vec3_t normal = {
+		m->m[0][0] * n.x + m->m[0][1] * n.y + m->m[0][2] * n.z,
+		m->m[1][0] * n.x + m->m[1][1] * n.y + m->m[1][2] * n.z,
+		m->m[2][0] * n.x + m->m[2][1] * n.y + m->m[2][2] * n.z
+	};
+	vec3_normalize(&normal);
+	return normal;
+}
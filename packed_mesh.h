@@ -0,0 +1,59 @@
+#ifndef PACKED_MESH_H
+#define PACKED_MESH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "vector.h"
+#include "matrix.h"
+#include "triangle.h"
+
+//faces index at most this many vertices above the vertex base of their cluster
+#define PACKED_CLUSTER_SPAN 65536
+
+//position quantized to 16 bits per axis inside of the mesh bounds
+typedef struct {
+	uint16_t x;
+	uint16_t y;
+	uint16_t z;
+} packed_position_t;
+
+//indices relative to the vertex base of the cluster the face belongs to and
+//the model space face normal, octahedral encoded into two signed bytes
+typedef struct {
+	uint16_t a;
+	uint16_t b;
+	uint16_t c;
+	int8_t normal[2];
+} packed_face_t;
+
+//a run of consecutive faces whose vertices all lie within PACKED_CLUSTER_SPAN of vertex_base
+typedef struct {
+	int first_face;
+	int vertex_base; //zero based
+} packed_cluster_t;
+
+//compressed copy of a mesh: 6 bytes per vertex and 8 per face instead of 12 and 16,
+//positions are decoded inside of the world transform and never exist as floats in memory
+typedef struct {
+	int num_vertices;
+	int num_faces;
+	int num_clusters;
+	packed_position_t* positions; //one entry more than num_vertices, see packed_mesh_transform
+	packed_face_t* faces;
+	packed_cluster_t* clusters; //one entry more than num_clusters, marking the end of the faces
+	uint32_t* face_colors; //NULL when every face has the same color
+	uint32_t color;
+	vec3_t quantization_offset; //position of a quantized 0
+	vec3_t quantization_step; //size of one quantized unit
+} packed_mesh_t;
+
+packed_mesh_t* packed_mesh_create(const vec3_t* vertices, int num_vertices, const face_t* faces, int num_faces);
+void packed_mesh_free(packed_mesh_t* packed);
+size_t packed_mesh_bytes(const packed_mesh_t* packed);
+
+void packed_mesh_transform(const packed_mesh_t* packed, const mat4_t* world_matrix, vec4_t* out);
+void packed_mesh_normal_matrix(mat4_t* RESTRICT res, const mat4_t* world_matrix);
+vec3_t packed_mesh_face_normal(const packed_face_t* face, const mat4_t* normal_matrix);
+
+#endif
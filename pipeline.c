@@ -0,0 +1,780 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "display.h"
+#include "mesh.h"
+#include "light.h"
+#include "camera.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "shadow.h"
+#include "point_cloud.h"
+#include "temporal.h"
+#include "simd.h"
+
+triangle_t* triangles_to_render = NULL;
+
+vec4_t* transformed_vertices = NULL;
+vec4_t* clip_vertices = NULL;
+vec2_fixed_t* screen_vertices = NULL;
+float* screen_depths = NULL;
+bool* vertex_is_visible = NULL;
+bool* face_is_visible = NULL;
+
+int display_mode = 2; //default 2
+int backface_culling_mode = 1; //default 1 (enabled)
+bool wireframe_antialiasing = false;
+bool depth_test_enabled = false;
+bool msaa_enabled = false;
+
+//colors and light factors of the emitted faces, shaded together once the face loop is done.
+//dynamic arrays kept between frames, only their length is reset
+static uint32_t* shading_colors = NULL;
+static float* shading_factors = NULL;
+
+//model space positions of a packed or skinned mesh for display mode 6, decoded or posed
+//once a frame by transform_mesh. a dynamic array like the ones above
+static vec3_t* mesh_points = NULL;
+
+//perspective projection for the current window size, the camera rebuilds
+//its matrices on the next update only if the size actually changed
+void setup_projection(void) {
+	camera_set_viewport(&camera, window_width, window_height);
+}
+
+//has to be called again whenever a different mesh gets loaded
+bool setup_vertex_buffers(void) {
+	free_vertex_buffers();
+
+	//at least one entry each, a streamed mesh starts out empty
+	int num_vertices = mesh_vertex_count(&mesh) > 0 ? mesh_vertex_count(&mesh) : 1;
+	int num_faces = mesh_face_count(&mesh) > 0 ? mesh_face_count(&mesh) : 1;
+
+	transformed_vertices = (vec4_t*)malloc(sizeof(vec4_t) * num_vertices);
+	clip_vertices = (vec4_t*)malloc(sizeof(vec4_t) * num_vertices);
+	screen_vertices = (vec2_fixed_t*)malloc(sizeof(vec2_fixed_t) * num_vertices);
+	screen_depths = (float*)malloc(sizeof(float) * num_vertices);
+	vertex_is_visible = (bool*)malloc(sizeof(bool) * num_vertices);
+	face_is_visible = (bool*)malloc(sizeof(bool) * num_faces);
+
+	if (!transformed_vertices || !clip_vertices || !screen_vertices || !screen_depths || !vertex_is_visible || !face_is_visible) {
+		fprintf(stderr, "Error creating the vertex buffers. Probably not enough avaliable memory.\n");
+		return false;
+	}
+	return true;
+}
+
+void free_vertex_buffers(void) {
+	array_free(shading_colors);
+	array_free(shading_factors);
+	shading_colors = NULL;
+	shading_factors = NULL;
+	array_free(mesh_points);
+	mesh_points = NULL;
+	free(transformed_vertices);
+	free(clip_vertices);
+	free(screen_vertices);
+	free(screen_depths);
+	free(vertex_is_visible);
+	free(face_is_visible);
+	transformed_vertices = NULL;
+	clip_vertices = NULL;
+	screen_vertices = NULL;
+	screen_depths = NULL;
+	vertex_is_visible = NULL;
+	face_is_visible = NULL;
+}
+
+//a packed mesh has no vertex array and a skinned one holds the bind pose there, both get
+//their current positions written to mesh_points through the usual transforms without a world
+static void update_mesh_points(void) {
+	if (point_cloud.num_points > 0 || (!mesh.packed && !mesh.skin)) {
+		return;
+	}
+	int num_vertices = mesh_vertex_count(&mesh);
+	mat4_t identity = mat4_identity();
+	if (mesh.skin) {
+		skin_transform(mesh.skin, &identity, mesh.vertices, transformed_vertices);
+	}
+	else {
+		packed_mesh_transform(mesh.packed, &identity, transformed_vertices);
+	}
+	array_truncate(mesh_points, 0);
+	mesh_points = array_hold(mesh_points, num_vertices, sizeof(vec3_t));
+	for (int i = 0; i < num_vertices; i++) {
+		mesh_points[i] = vec3_from_vec4(transformed_vertices[i]);
+	}
+}
+
+//the loaded point cloud, otherwise the vertices of the mesh
+static const point_cloud_t* displayed_points(point_cloud_t* mesh_view) {
+	if (point_cloud.num_points > 0) {
+		return &point_cloud;
+	}
+	if (mesh.packed || mesh.skin) {
+		point_cloud_view_mesh(mesh_view, mesh_points, array_length(mesh_points), mesh.bounds_center, mesh.bounds_radius);
+	}
+	else {
+		point_cloud_view_mesh(mesh_view, mesh.vertices, array_length(mesh.vertices), mesh.bounds_center, mesh.bounds_radius);
+	}
+	return mesh_view;
+}
+
+//perspective divide and viewport mapping of one clip space point, the point has to be in front
+//of the near plane. screen positions leave here as 28.4 fixed point and stay that way until
+//rasterization
+static FORCE_INLINE void project_clip_point(vec4_t projected_point, vec2_fixed_t* point, float* depth) {
+	if (projected_point.w != 0.0) {
+		projected_point.x /= projected_point.w;
+		projected_point.y /= projected_point.w;
+		projected_point.z /= projected_point.w;
+	}
+
+	//scale and translate projected points to middle of screen
+	projected_point.x *= (window_width / 2.0);
+	projected_point.y *= (window_height / 2.0);
+
+	projected_point.y *= -1;
+
+	projected_point.x += (window_width / 2.0);
+	projected_point.y += (window_height / 2.0);
+
+	*point = vec2_fixed_from_floats(projected_point.x, projected_point.y);
+	*depth = projected_point.z;
+}
+
+//where the segment from a point in front of the near plane to one behind it crosses the plane.
+//z / w is 0 at znear with this projection, so in clip space the plane is z = 0 and w is
+//positive on the near side. always called in that order so that a face and its edges get
+//the same point
+static FORCE_INLINE vec4_t near_plane_intersection(vec4_t inside, vec4_t outside) {
+	float t = inside.z / (inside.z - outside.z);
+	vec4_t p = {
+		inside.x + (outside.x - inside.x) * t,
+		inside.y + (outside.y - inside.y) * t,
+		0.0f,
+		inside.w + (outside.w - inside.w) * t
+	};
+	return p;
+}
+
+//sutherland-hodgman against the near plane, a vertex behind the camera would be divided by
+//a negative w and come out mirrored. returns the number of corners left, 0, 3 or 4
+static int clip_face_near(const vec4_t face[3], vec4_t out[4]) {
+	int count = 0;
+	for (int i = 0; i < 3; i++) {
+		vec4_t a = face[i];
+		vec4_t b = face[i == 2 ? 0 : i + 1];
+		bool a_inside = a.z >= 0.0f;
+		bool b_inside = b.z >= 0.0f;
+		if (a_inside) {
+			out[count++] = a;
+		}
+		if (a_inside != b_inside) {
+			out[count++] = a_inside ? near_plane_intersection(a, b) : near_plane_intersection(b, a);
+		}
+	}
+	return count;
+}
+
+//vertex and face stages: fills triangles_to_render for the current mesh and returns
+//the screen area everything drawn for the mesh will cover
+rect_t transform_mesh(void) {
+	triangles_to_render = NULL;
+	shadow_map.valid = false;
+
+	PROFILE_BEGIN(PROFILE_TRANSFORM);
+	//translation * rotation_x * rotation_y * rotation_z * scale in one go
+	mat4_t world_matrix;
+	mat4_make_trs(&world_matrix, mesh.scale, mesh.rotation, mesh.translation);
+
+	camera_update(&camera);
+	PROFILE_END(PROFILE_TRANSFORM);
+
+	int num_vertices = mesh_vertex_count(&mesh);
+	int num_faces = mesh_face_count(&mesh);
+	PROFILE_COUNT(PROFILE_FACES_IN, num_faces);
+
+	PROFILE_BEGIN(PROFILE_CULL);
+
+	//skip the whole mesh when its bounding sphere is outside of the view frustum
+	float max_scale = fabsf(mesh.scale.x);
+	if (fabsf(mesh.scale.y) > max_scale) max_scale = fabsf(mesh.scale.y);
+	if (fabsf(mesh.scale.z) > max_scale) max_scale = fabsf(mesh.scale.z);
+
+	if (display_mode == POINT_DISPLAY_MODE) {
+		//points are transformed while they are splatted, only their bounds are needed here.
+		//draw_points reuses the positions decoded for this frame
+		update_mesh_points();
+		point_cloud_t mesh_view;
+		const point_cloud_t* cloud = displayed_points(&mesh_view);
+		vec4_t cloud_center;
+		mat4_transform_points_affine(&world_matrix, &cloud->bounds_center, &cloud_center, 1);
+		bool visible = cloud->num_points > 0 && camera_sphere_visible(&camera, vec3_from_vec4(cloud_center), cloud->bounds_radius * max_scale);
+		PROFILE_END(PROFILE_CULL);
+		return visible ? rect_make(0, 0, window_width, window_height) : rect_empty();
+	}
+
+	vec4_t world_center;
+	mat4_transform_points_affine(&world_matrix, &mesh.bounds_center, &world_center, 1);
+	if (!camera_sphere_visible(&camera, vec3_from_vec4(world_center), mesh.bounds_radius * max_scale)) {
+		memset(vertex_is_visible, 0, sizeof(bool) * num_vertices);
+		memset(face_is_visible, 0, sizeof(bool) * num_faces);
+		PROFILE_COUNT(PROFILE_FACES_CULLED, num_faces);
+		PROFILE_END(PROFILE_CULL);
+		return rect_empty();
+	}
+	PROFILE_END(PROFILE_CULL);
+
+	//transform and project every unique vertex once, faces and edges only index into these.
+	//both matrix passes run over the whole vertex array before anything else touches it
+	PROFILE_BEGIN(PROFILE_TRANSFORM);
+	const packed_mesh_t* packed = mesh.packed;
+	if (mesh.skin) {
+		//the pose and the world transform in one pass, mesh_animate already moved the bounds
+		skin_transform(mesh.skin, &world_matrix, mesh.vertices, transformed_vertices);
+	}
+	else if (packed) {
+		packed_mesh_transform(packed, &world_matrix, transformed_vertices);
+	}
+	else {
+		mat4_transform_points_affine(&world_matrix, mesh.vertices, transformed_vertices, num_vertices);
+	}
+	PROFILE_END(PROFILE_TRANSFORM);
+
+	//shadows are only looked up for depth tested filled triangles, the map needs all faces
+	//and has to be rendered before culling decides which ones the camera sees
+	if (shadow_map.enabled && display_mode == 3 && depth_test_enabled) {
+		PROFILE_BEGIN(PROFILE_SHADOW);
+		shadow_map_render(&mesh, transformed_vertices, vec3_from_vec4(world_center), mesh.bounds_radius * max_scale);
+		PROFILE_END(PROFILE_SHADOW);
+	}
+
+	PROFILE_BEGIN(PROFILE_PROJECT);
+	mat4_transform_vec4s(&camera.view_projection_matrix, transformed_vertices, clip_vertices, num_vertices);
+
+	//points behind the near plane get projected as well, only faces and edges that lie
+	//completely in front of it use them directly
+	for (int i = 0; i < num_vertices; i++) {
+		project_clip_point(clip_vertices[i], &screen_vertices[i], &screen_depths[i]);
+		vertex_is_visible[i] = false;
+	}
+	PROFILE_END(PROFILE_PROJECT);
+
+	PROFILE_BEGIN(PROFILE_CULL);
+	rect_t mesh_bounds = rect_empty();
+
+	//packed faces carry their model space normal, only its transform is left to do
+	mat4_t normal_matrix;
+	if (packed) {
+		packed_mesh_normal_matrix(&normal_matrix, &world_matrix);
+	}
+	int cluster = 0;
+	array_truncate(shading_colors, 0);
+	array_truncate(shading_factors, 0);
+
+	//loop all triangle faces of cube mesh
+	for (int i = 0; i < num_faces; i++) {
+		int face_indices[3];
+		mesh_face_indices(&mesh, i, &cluster, face_indices);
+		uint32_t face_color;
+		const packed_face_t* packed_face = NULL;
+		if (packed) {
+			packed_face = &packed->faces[i];
+			face_color = packed->face_colors ? packed->face_colors[i] : packed->color;
+		}
+		else {
+			face_color = mesh.faces[i].color;
+		}
+
+		face_is_visible[i] = false;
+
+		//backface culling
+		
+		vec3_t vector_a = vec3_from_vec4(transformed_vertices[face_indices[0]]);
+		vec3_t vector_b = vec3_from_vec4(transformed_vertices[face_indices[1]]);
+		vec3_t vector_c = vec3_from_vec4(transformed_vertices[face_indices[2]]);
+
+		vec3_t normal;
+		if (packed_face) {
+			normal = packed_mesh_face_normal(packed_face, &normal_matrix);
+		}
+		else {
+			vec3_t vector_ab = vec3_sub(vector_b, vector_a);
+			vec3_t vector_ac = vec3_sub(vector_c, vector_a);
+			vec3_normalize(&vector_ab);
+			vec3_normalize(&vector_ac);
+
+			normal = vec3_cross(vector_ab, vector_ac);
+			vec3_normalize(&normal);
+		}
+
+		vec3_t camera_ray = vec3_sub(camera.position, vector_a);
+		float dot_normal_camera = vec3_dot(normal, camera_ray);
+
+		if (backface_culling_mode) {
+			if (dot_normal_camera < 0) {
+				PROFILE_COUNT(PROFILE_FACES_CULLED, 1);
+				continue;
+			}
+		}
+
+		//only the near plane is clipped against, faces reaching out of the rest of the view
+		//volume are left to the guard band and the scissor
+		vec4_t face_clip[3] = {
+			clip_vertices[face_indices[0]],
+			clip_vertices[face_indices[1]],
+			clip_vertices[face_indices[2]]
+		};
+		bool crosses_near = face_clip[0].z < 0.0f || face_clip[1].z < 0.0f || face_clip[2].z < 0.0f;
+		vec4_t clipped[4];
+		int num_clipped = crosses_near ? clip_face_near(face_clip, clipped) : 3;
+		if (num_clipped == 0) {
+			PROFILE_COUNT(PROFILE_FACES_CULLED, 1);
+			continue;
+		}
+
+		face_is_visible[i] = true;
+		PROFILE_COUNT(PROFILE_FACES_EMITTED, 1);
+
+#ifdef ENABLE_PROFILER
+		for (int j = 0; j < 3; j++) {
+			vec4_t clip = face_clip[j];
+			if (fabsf(clip.x) > clip.w || fabsf(clip.y) > clip.w || clip.z < 0 || clip.z > clip.w) {
+				PROFILE_COUNT(PROFILE_FACES_CLIPPED, 1);
+				break;
+			}
+		}
+#endif
+
+		//distance of the face center along the view direction
+		vec3_t face_center = vec3_div(vec3_add(vec3_add(vector_a, vector_b), vector_c), 3.0);
+		float avg_depth = vec3_dot(vec3_sub(face_center, camera.position), camera.forward);
+
+		//calculate shading intensity based on dot product between face normal and light angle
+		float light_intensity_factor = -vec3_dot(normal, light.direction);
+
+		if (!crosses_near) {
+			array_push(shading_colors, face_color);
+			array_push(shading_factors, light_intensity_factor);
+
+			triangle_t projected_triangle = {
+				.points = {
+					screen_vertices[face_indices[0]],
+					screen_vertices[face_indices[1]],
+					screen_vertices[face_indices[2]]
+				 },
+				.depths = {
+					screen_depths[face_indices[0]],
+					screen_depths[face_indices[1]],
+					screen_depths[face_indices[2]]
+				},
+				.color = face_color,
+				.avg_depth = avg_depth
+			};
+			array_push(triangles_to_render, projected_triangle);
+
+			for (int j = 0; j < 3; j++) {
+				vertex_is_visible[face_indices[j]] = true;
+				rect_include_point(&mesh_bounds,
+					fixed_floor_to_int(projected_triangle.points[j].x),
+					fixed_floor_to_int(projected_triangle.points[j].y));
+			}
+			continue;
+		}
+
+		//what is left of a clipped face fans out from its first corner, one or two triangles
+		vec2_fixed_t clipped_points[4];
+		float clipped_depths[4];
+		for (int j = 0; j < num_clipped; j++) {
+			project_clip_point(clipped[j], &clipped_points[j], &clipped_depths[j]);
+			rect_include_point(&mesh_bounds,
+				fixed_floor_to_int(clipped_points[j].x),
+				fixed_floor_to_int(clipped_points[j].y));
+		}
+		for (int j = 1; j + 1 < num_clipped; j++) {
+			array_push(shading_colors, face_color);
+			array_push(shading_factors, light_intensity_factor);
+
+			triangle_t projected_triangle = {
+				.points = { clipped_points[0], clipped_points[j], clipped_points[j + 1] },
+				.depths = { clipped_depths[0], clipped_depths[j], clipped_depths[j + 1] },
+				.color = face_color,
+				.avg_depth = avg_depth
+			};
+			array_push(triangles_to_render, projected_triangle);
+		}
+		for (int j = 0; j < 3; j++) {
+			if (face_clip[j].z >= 0.0f) {
+				vertex_is_visible[face_indices[j]] = true;
+			}
+		}
+	}
+
+	//calculate triangle colors based on the light angle, four faces at a time
+	int num_shaded = array_length(shading_colors);
+	light_apply_intensities(shading_colors, shading_factors, shading_colors, num_shaded);
+	for (int i = 0; i < num_shaded; i++) {
+		triangles_to_render[i].color = shading_colors[i];
+	}
+
+	//vertex markers in display mode 1 reach 6 pixels right and down of the vertex
+	mesh_bounds = rect_expand(mesh_bounds, 1);
+	mesh_bounds.x1 += 6;
+	mesh_bounds.y1 += 6;
+	PROFILE_END(PROFILE_CULL);
+
+	PROFILE_BEGIN(PROFILE_SORT);
+	// sort triangles by depth (bubble sort), wireframe modes do not depend on the order
+	// and filled triangles only need it without the z-buffer (mode 4 always sorts for its edges),
+	// the overdraw mode sorts whenever mode 3 does so that it shows the cost of mode 3
+	if (((display_mode == 3 || display_mode == 5) && !depth_test_enabled) || display_mode == 4) {
+		int num_triangles = array_length(triangles_to_render);
+		for (int i = 0; i < num_triangles; i++) {
+			for (int j = i; j < num_triangles; j++) {
+				if (triangles_to_render[i].avg_depth < triangles_to_render[j].avg_depth) {
+					triangle_t temp = triangles_to_render[i];
+					triangles_to_render[i] = triangles_to_render[j];
+					triangles_to_render[j] = temp;
+				}
+			}
+		}
+	}
+	PROFILE_END(PROFILE_SORT);
+
+	return mesh_bounds;
+}
+
+//what the raster stage does for a frame. every supported combination is compiled into its
+//own specialization of draw_pipeline, picked once per frame from the pipelines table, so
+//a feature costs nothing in the pipelines that leave it out
+#define PIPELINE_EDGES 0x001 //every mesh edge once (modes 1 and 2)
+#define PIPELINE_VERTICES 0x002 //vertex markers (mode 1)
+#define PIPELINE_ANTIALIASED 0x004 //anti-aliased edges
+#define PIPELINE_FILL 0x008 //filled triangles (modes 3 and 4)
+#define PIPELINE_OUTLINES 0x010 //triangle outlines drawn together with the fill (mode 4)
+#define PIPELINE_SHADED 0x020 //light shaded face colors, otherwise white with the face alpha
+#define PIPELINE_DEPTH 0x040 //z-buffer test
+#define PIPELINE_MSAA 0x080 //filled through the multisample buffers
+#define PIPELINE_BLEND 0x100 //faces with alpha go through the transparency buffers
+#define PIPELINE_OVERDRAW 0x200 //write counts only (mode 5)
+#define PIPELINE_CHECKERBOARD 0x400 //half of the pixels, the temporal pass fills in the rest
+
+//wireframe modes draw every edge of the mesh once instead of three lines per triangle,
+//an edge is drawn when at least one of the faces using it survived culling
+static FORCE_INLINE void draw_edges(int features) {
+	int num_edges = array_length(mesh.edges);
+	for (int i = 0; i < num_edges; i++) {
+		mesh_edge_t edge = mesh.edges[i];
+		bool visible = face_is_visible[edge.faces[0]] || (edge.faces[1] >= 0 && face_is_visible[edge.faces[1]]);
+		if (!visible) {
+			continue;
+		}
+
+		//a face in front of the camera can still have an edge reaching behind it
+		vec2_fixed_t a = screen_vertices[edge.a];
+		vec2_fixed_t b = screen_vertices[edge.b];
+		vec4_t clip_a = clip_vertices[edge.a];
+		vec4_t clip_b = clip_vertices[edge.b];
+		if (clip_a.z < 0.0f || clip_b.z < 0.0f) {
+			if (clip_a.z < 0.0f && clip_b.z < 0.0f) {
+				continue;
+			}
+			float depth;
+			if (clip_a.z < 0.0f) {
+				project_clip_point(near_plane_intersection(clip_b, clip_a), &a, &depth);
+			}
+			else {
+				project_clip_point(near_plane_intersection(clip_a, clip_b), &b, &depth);
+			}
+		}
+
+		if (features & PIPELINE_ANTIALIASED) {
+			draw_line_antialiased(a, b, 0xFFFFFFFF);
+		}
+		else {
+			draw_line_fixed(a, b, 0xFFFFFFFF);
+		}
+	}
+
+	if (features & PIPELINE_VERTICES) {
+		int num_vertices = mesh_vertex_count(&mesh);
+		for (int i = 0; i < num_vertices; i++) {
+			if (vertex_is_visible[i]) {
+				draw_rectangle(
+					fixed_floor_to_int(screen_vertices[i].x),
+					fixed_floor_to_int(screen_vertices[i].y),
+					6, 6, 0xFFFF0000);
+			}
+		}
+	}
+}
+
+//resolves to a direct call of the rasterizer specialized for the features
+static FORCE_INLINE void fill_triangle(const triangle_t* triangle, uint32_t color, int features) {
+	if (features & PIPELINE_OVERDRAW) {
+		if (features & PIPELINE_DEPTH) draw_filled_triangle_overdraw_depth(triangle, color);
+		else draw_filled_triangle_overdraw(triangle, color);
+	}
+	else if (features & PIPELINE_MSAA) {
+		if (features & PIPELINE_DEPTH) draw_filled_triangle_msaa_depth(triangle, color);
+		else draw_filled_triangle_msaa(triangle, color);
+	}
+	else {
+		if (features & PIPELINE_CHECKERBOARD) draw_filled_triangle_depth_checkerboard(triangle, color);
+		else if (features & PIPELINE_DEPTH) draw_filled_triangle_depth(triangle, color);
+		else draw_filled_triangle(triangle, color);
+	}
+}
+
+static FORCE_INLINE void blend_triangle(const triangle_t* triangle, uint32_t color, int features) {
+	if (!(features & PIPELINE_DEPTH)) draw_filled_triangle_oit(triangle, color);
+	else if (features & PIPELINE_MSAA) draw_filled_triangle_oit_msaa_depth(triangle, color);
+	else draw_filled_triangle_oit_depth(triangle, color);
+}
+
+static FORCE_INLINE uint32_t fill_color(const triangle_t* triangle, int features) {
+	return (features & PIPELINE_SHADED) ? triangle->color : (triangle->color | 0x00FFFFFF);
+}
+
+//filled triangles and their outlines have to be drawn together, otherwise outlines
+//of triangles further back would show through the ones in front. with PIPELINE_BLEND
+//transparent triangles are drawn after all opaque ones into the weighted blended
+//transparency buffers, so they never need sorting. without the depth test they end up on top
+static FORCE_INLINE void draw_pipeline(int features) {
+	if (features & PIPELINE_EDGES) {
+		draw_edges(features);
+		return;
+	}
+
+	int num_triangles = array_length(triangles_to_render);
+	for (int i = 0; i < num_triangles; i++) {
+		const triangle_t* triangle = &triangles_to_render[i];
+		uint32_t color = fill_color(triangle, features);
+		//transparent triangles are only accumulated below, resolved over the opaque pixels at the end
+		if (!(features & PIPELINE_BLEND) || (color >> 24) == 0xFF) {
+			fill_triangle(triangle, color, features);
+		}
+
+		if (features & PIPELINE_OUTLINES) {
+			if (features & PIPELINE_MSAA) {
+				draw_triangle_msaa(triangle->points[0], triangle->points[1], triangle->points[2], 0xFFFF0000);
+			}
+			else {
+				draw_triangle(triangle->points[0], triangle->points[1], triangle->points[2], 0xFFFF0000);
+			}
+		}
+	}
+
+	if (features & PIPELINE_BLEND) {
+		for (int i = 0; i < num_triangles; i++) {
+			const triangle_t* triangle = &triangles_to_render[i];
+			uint32_t color = fill_color(triangle, features);
+			if ((color >> 24) != 0xFF) {
+				blend_triangle(triangle, color, features);
+			}
+		}
+	}
+}
+
+#define PIPELINE_WIREFRAME PIPELINE_EDGES
+#define PIPELINE_MODE_3 (PIPELINE_FILL | PIPELINE_SHADED)
+#define PIPELINE_MODE_4 (PIPELINE_FILL | PIPELINE_OUTLINES)
+
+//every combination render_triangles can ask for
+#define PIPELINE_VARIANTS(X) \
+	X(wireframe, PIPELINE_WIREFRAME) \
+	X(wireframe_aa, PIPELINE_WIREFRAME | PIPELINE_ANTIALIASED) \
+	X(wireframe_vertices, PIPELINE_WIREFRAME | PIPELINE_VERTICES) \
+	X(wireframe_vertices_aa, PIPELINE_WIREFRAME | PIPELINE_VERTICES | PIPELINE_ANTIALIASED) \
+	X(shaded, PIPELINE_MODE_3) \
+	X(shaded_depth, PIPELINE_MODE_3 | PIPELINE_DEPTH) \
+	X(shaded_depth_checkerboard, PIPELINE_MODE_3 | PIPELINE_DEPTH | PIPELINE_CHECKERBOARD) \
+	X(shaded_msaa, PIPELINE_MODE_3 | PIPELINE_MSAA) \
+	X(shaded_msaa_depth, PIPELINE_MODE_3 | PIPELINE_MSAA | PIPELINE_DEPTH) \
+	X(shaded_blend, PIPELINE_MODE_3 | PIPELINE_BLEND) \
+	X(shaded_blend_depth, PIPELINE_MODE_3 | PIPELINE_BLEND | PIPELINE_DEPTH) \
+	X(shaded_blend_msaa, PIPELINE_MODE_3 | PIPELINE_BLEND | PIPELINE_MSAA) \
+	X(shaded_blend_msaa_depth, PIPELINE_MODE_3 | PIPELINE_BLEND | PIPELINE_MSAA | PIPELINE_DEPTH) \
+	X(outlined, PIPELINE_MODE_4) \
+	X(outlined_depth, PIPELINE_MODE_4 | PIPELINE_DEPTH) \
+	X(outlined_msaa, PIPELINE_MODE_4 | PIPELINE_MSAA) \
+	X(outlined_msaa_depth, PIPELINE_MODE_4 | PIPELINE_MSAA | PIPELINE_DEPTH) \
+	X(outlined_blend, PIPELINE_MODE_4 | PIPELINE_BLEND) \
+	X(outlined_blend_depth, PIPELINE_MODE_4 | PIPELINE_BLEND | PIPELINE_DEPTH) \
+	X(outlined_blend_msaa, PIPELINE_MODE_4 | PIPELINE_BLEND | PIPELINE_MSAA) \
+	X(outlined_blend_msaa_depth, PIPELINE_MODE_4 | PIPELINE_BLEND | PIPELINE_MSAA | PIPELINE_DEPTH) \
+	X(overdraw, PIPELINE_OVERDRAW) \
+	X(overdraw_depth, PIPELINE_OVERDRAW | PIPELINE_DEPTH)
+
+#define DEFINE_PIPELINE(name, features) \
+	static void draw_pipeline_##name(void) { \
+		draw_pipeline(features); \
+	}
+PIPELINE_VARIANTS(DEFINE_PIPELINE)
+
+typedef void (*pipeline_draw_t)(void);
+
+typedef struct {
+	int features;
+	pipeline_draw_t draw;
+} pipeline_variant_t;
+
+#define PIPELINE_ENTRY(name, features) { features, draw_pipeline_##name },
+static const pipeline_variant_t pipelines[] = {
+	PIPELINE_VARIANTS(PIPELINE_ENTRY)
+};
+
+static int pipeline_features(bool transparency, bool checkerboard) {
+	switch (display_mode) {
+	case 1:
+		return PIPELINE_WIREFRAME | PIPELINE_VERTICES | (wireframe_antialiasing ? PIPELINE_ANTIALIASED : 0);
+	case 2:
+		return PIPELINE_WIREFRAME | (wireframe_antialiasing ? PIPELINE_ANTIALIASED : 0);
+	case 5:
+		return PIPELINE_OVERDRAW | (depth_test_enabled ? PIPELINE_DEPTH : 0);
+	default:
+		return (display_mode == 3 ? PIPELINE_MODE_3 : PIPELINE_MODE_4)
+			| (depth_test_enabled ? PIPELINE_DEPTH : 0)
+			| (msaa_active ? PIPELINE_MSAA : 0)
+			| (transparency ? PIPELINE_BLEND : 0)
+			| (checkerboard ? PIPELINE_CHECKERBOARD : 0);
+	}
+}
+
+static pipeline_draw_t select_pipeline(int features) {
+	int num_pipelines = sizeof(pipelines) / sizeof(pipelines[0]);
+	for (int i = 0; i < num_pipelines; i++) {
+		if (pipelines[i].features == features) {
+			return pipelines[i].draw;
+		}
+	}
+	return NULL;
+}
+
+//display mode 6, every point splatted once with the depth test
+static void draw_points(rect_t area) {
+	mat4_t world_matrix;
+	mat4_make_trs(&world_matrix, mesh.scale, mesh.rotation, mesh.translation);
+	float max_scale = fmaxf(fabsf(mesh.scale.x), fmaxf(fabsf(mesh.scale.y), fabsf(mesh.scale.z)));
+	point_cloud_t mesh_view;
+	point_cloud_render(displayed_points(&mesh_view), &world_matrix, max_scale, area);
+}
+
+//temporal mode reconstructs from the depth of opaque, single sampled mode 3 frames
+static bool temporal_frame(bool transparency) {
+	return temporal.enabled && display_mode == 3 && depth_test_enabled && !msaa_enabled && !transparency;
+}
+
+//model space to pixels and z / w, what the temporal pass reprojects with
+static void object_to_screen_matrix(mat4_t* res) {
+	mat4_t world_matrix;
+	mat4_make_trs(&world_matrix, mesh.scale, mesh.rotation, mesh.translation);
+	mat4_t viewport = mat4_identity();
+	viewport.m[0][0] = window_width / 2.0f;
+	viewport.m[0][3] = window_width / 2.0f;
+	viewport.m[1][1] = -window_height / 2.0f;
+	viewport.m[1][3] = window_height / 2.0f;
+	*res = mat4_mul_mat4(viewport, mat4_mul_mat4(camera.view_projection_matrix, world_matrix));
+}
+
+static bool has_transparent_triangles(void) {
+	int num_triangles = array_length(triangles_to_render);
+	for (int i = 0; i < num_triangles; i++) {
+		if ((triangles_to_render[i].color >> 24) != 0xFF) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//clears and rasterizes triangles_to_render inside of area through the pipeline variant
+//matching the current settings, the triangle list is freed afterwards
+void render_triangles(rect_t area) {
+	bool filled_mode = display_mode == 3 || display_mode == 4;
+	bool overdraw_mode = display_mode == 5;
+	bool point_mode = display_mode == POINT_DISPLAY_MODE;
+	bool transparency = filled_mode && has_transparent_triangles() && allocate_oit_buffers();
+	bool temporal_mode = temporal_frame(transparency);
+	bool checkerboard = false;
+	if (temporal_mode) {
+		mat4_t object_to_screen;
+		object_to_screen_matrix(&object_to_screen);
+		checkerboard = temporal_begin_frame(&object_to_screen);
+	}
+	else {
+		temporal_reset();
+	}
+	PROFILE_BEGIN(PROFILE_CLEAR);
+	set_clip_rect(area);
+	clear_color_buffer_rect(area, 0x00000000);
+	PROFILE_CLEAR_RECT(area);
+
+	//filled modes can render through the multisample buffers, resolved into color_buffer at the end
+	msaa_active = msaa_enabled && filled_mode;
+	if (msaa_active) {
+		clear_msaa_buffers_rect(area, 0x00000000);
+	}
+	else if ((depth_test_enabled && (filled_mode || overdraw_mode)) || point_mode) {
+		clear_depth_buffer_rect(area);
+	}
+	if (overdraw_mode) {
+		clear_overdraw_buffer_rect(area);
+	}
+	if (transparency) {
+		clear_oit_buffers_rect(area);
+	}
+	PROFILE_END(PROFILE_CLEAR);
+
+	PROFILE_BEGIN(PROFILE_RASTER_MODE_1 + display_mode - 1);
+	pipeline_draw_t draw = point_mode ? NULL : select_pipeline(pipeline_features(transparency, checkerboard));
+	if (draw) {
+		draw();
+	}
+	else if (point_mode) {
+		draw_points(area);
+	}
+	PROFILE_END(PROFILE_RASTER_MODE_1 + display_mode - 1);
+
+	bool resolved_msaa = msaa_active;
+	if (msaa_active) {
+		PROFILE_BEGIN(PROFILE_RESOLVE);
+		resolve_msaa_buffer_rect(area);
+		msaa_active = false;
+		PROFILE_END(PROFILE_RESOLVE);
+	}
+
+	if (shadow_map.valid && display_mode == 3) {
+		PROFILE_BEGIN(PROFILE_SHADOW);
+		shadow_map_apply_rect(area, &camera.view_projection_matrix,
+			resolved_msaa ? msaa_depth_buffer : depth_buffer, resolved_msaa ? MSAA_SAMPLES : 1);
+		PROFILE_END(PROFILE_SHADOW);
+	}
+
+	if (transparency) {
+		PROFILE_BEGIN(PROFILE_RESOLVE);
+		resolve_oit_rect(area);
+		PROFILE_END(PROFILE_RESOLVE);
+	}
+
+	//the pixels left out by the checkerboard are still cleared, so shadows skipped them above
+	if (temporal_mode) {
+		PROFILE_BEGIN(PROFILE_RESOLVE);
+		temporal_end_frame(area);
+		PROFILE_END(PROFILE_RESOLVE);
+	}
+
+	if (overdraw_mode) {
+		PROFILE_BEGIN(PROFILE_RESOLVE);
+		int64_t histogram[OVERDRAW_LEVELS] = { 0 };
+		resolve_overdraw_heatmap_rect(area, histogram);
+		PROFILE_OVERDRAW_HISTOGRAM(histogram);
+		PROFILE_END(PROFILE_RESOLVE);
+	}
+
+	reset_clip_rect();
+
+	array_free(triangles_to_render);
+	triangles_to_render = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+#include "triangle.h"
+#include "rect.h"
+#include "fixed.h"
+
+extern triangle_t* triangles_to_render;
+
+//per frame results of the vertex stage, one entry per mesh vertex / face
+extern vec4_t* transformed_vertices;
+extern vec4_t* clip_vertices;
+extern vec2_fixed_t* screen_vertices;
+extern float* screen_depths;
+extern bool* vertex_is_visible;
+extern bool* face_is_visible;
+
+extern int display_mode;
+extern int backface_culling_mode;
+extern bool wireframe_antialiasing;
+extern bool depth_test_enabled;
+extern bool msaa_enabled;
+
+void setup_projection(void);
+bool setup_vertex_buffers(void);
+void free_vertex_buffers(void);
+rect_t transform_mesh(void);
+void render_triangles(rect_t area);
+
+#endif
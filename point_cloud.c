@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <SDL.h>
+#include "array.h"
+#include "display.h"
+#include "camera.h"
+#include "mesh.h"
+#include "obj_loader.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "point_cloud.h"
+
+point_cloud_t point_cloud = { 0 };
+float point_size_scale = 1.0f;
+
+//projected point waiting in the bin of a screen band
+typedef struct {
+	int16_t x; //top left pixel of the splat
+	int16_t y;
+	uint8_t size;
+	float depth;
+	uint32_t color;
+} point_splat_t;
+
+typedef struct {
+	const point_cloud_t* cloud;
+	size_t first;
+	size_t end;
+	int job;
+} point_job_t;
+
+//per frame settings of the splatter and the bins every transform job sorts its points into.
+//a band is only ever written by its own splat job, so no pixel needs a lock and the
+//result does not depend on the number of threads
+typedef struct {
+	thread_pool_t* pool;
+	int num_threads; //0 until the pool has been created
+	point_job_t* jobs; //dynamic array
+	point_splat_t** bins; //num_jobs * num_bands dynamic arrays, job major
+	int num_bins;
+	int num_jobs;
+	int num_bands;
+	bool direct; //single threaded, points go straight into the frame
+
+	mat4_t model_view_projection;
+	float half_width;
+	float half_height;
+	float size_factor; //point size in pixels is size_factor / w
+	rect_t area;
+} point_splatter_t;
+
+static point_splatter_t splatter = { 0 };
+
+//a scan samples surfaces, so its points are spread over an area rather than a volume
+static float point_spacing(float bounds_radius, size_t num_points) {
+	return num_points > 0 ? 2.0f * bounds_radius / sqrtf((float)num_points) : 0.0f;
+}
+
+//every vertex of the file becomes a point, faces are ignored
+static bool load_obj_points(point_cloud_t* cloud, const char* filename) {
+	mesh_t vertices = { 0 };
+	obj_load_parallel(filename, &vertices, 0);
+	int num_points = array_length(vertices.vertices);
+	if (num_points == 0) {
+		fprintf(stderr, "%s has no vertices.\n", filename);
+		mesh_free(&vertices);
+		return false;
+	}
+	mesh_compute_bounds(&vertices);
+
+	cloud->points = (vec3_t*)malloc(sizeof(vec3_t) * num_points);
+	if (!cloud->points) {
+		fprintf(stderr, "Error creating the point cloud. Probably not enough avaliable memory.\n");
+		mesh_free(&vertices);
+		return false;
+	}
+	memcpy(cloud->points, vertices.vertices, sizeof(vec3_t) * num_points);
+	cloud->colors = NULL;
+	cloud->num_points = num_points;
+	cloud->bounds_center = vertices.bounds_center;
+	cloud->bounds_radius = vertices.bounds_radius;
+	cloud->spacing = point_spacing(cloud->bounds_radius, cloud->num_points);
+	mesh_free(&vertices);
+	return true;
+}
+
+static bool load_binary_points(point_cloud_t* cloud, FILE* file, const point_cloud_file_header_t* header, const char* filename) {
+	if (header->num_points == 0 || header->num_points > SIZE_MAX / sizeof(vec3_t)) {
+		fprintf(stderr, "%s has no points or more than can be addressed.\n", filename);
+		return false;
+	}
+	size_t num_points = (size_t)header->num_points;
+	cloud->points = (vec3_t*)malloc(sizeof(vec3_t) * num_points);
+	cloud->colors = (header->flags & POINT_CLOUD_HAS_COLORS) ? (uint32_t*)malloc(sizeof(uint32_t) * num_points) : NULL;
+	if (!cloud->points || ((header->flags & POINT_CLOUD_HAS_COLORS) && !cloud->colors)) {
+		fprintf(stderr, "Error creating the point cloud. Probably not enough avaliable memory.\n");
+		return false;
+	}
+
+	bool ok = fread(cloud->points, sizeof(vec3_t), num_points, file) == num_points
+		&& (!cloud->colors || fread(cloud->colors, sizeof(uint32_t), num_points, file) == num_points);
+	if (!ok) {
+		fprintf(stderr, "%s is cut short.\n", filename);
+		return false;
+	}
+	cloud->num_points = num_points;
+	cloud->bounds_center = header->bounds_center;
+	cloud->bounds_radius = header->bounds_radius;
+	cloud->spacing = point_spacing(cloud->bounds_radius, cloud->num_points);
+	return true;
+}
+
+//.pts files are recognized by their header, anything else is read as an .obj
+bool point_cloud_load(point_cloud_t* cloud, const char* filename) {
+	point_cloud_free(cloud);
+	FILE* file;
+	if (fopen_s(&file, filename, "rb") != 0 || !file) {
+		fprintf(stderr, "cannot open point cloud file %s.\n", filename);
+		return false;
+	}
+
+	point_cloud_file_header_t header;
+	bool binary = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "PTS1", 4) == 0;
+	bool ok;
+	if (binary) {
+		ok = load_binary_points(cloud, file, &header, filename);
+		fclose(file);
+	}
+	else {
+		fclose(file);
+		ok = load_obj_points(cloud, filename);
+	}
+
+	if (!ok) {
+		point_cloud_free(cloud);
+		return false;
+	}
+	printf("loaded %zu points from %s\n", cloud->num_points, filename);
+	return true;
+}
+
+//converts the vertices of an .obj, loading the .pts later skips all the text parsing
+bool point_cloud_build_file(const char* obj_filename, const char* points_filename) {
+	point_cloud_t cloud = { 0 };
+	if (!load_obj_points(&cloud, obj_filename)) {
+		return false;
+	}
+
+	FILE* file;
+	bool ok = fopen_s(&file, points_filename, "wb") == 0 && file;
+	if (!ok) {
+		fprintf(stderr, "cannot open %s.\n", points_filename);
+		point_cloud_free(&cloud);
+		return false;
+	}
+	point_cloud_file_header_t header = { { 'P', 'T', 'S', '1' }, 0, cloud.num_points, cloud.bounds_center, cloud.bounds_radius };
+	ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(cloud.points, sizeof(vec3_t), cloud.num_points, file) == cloud.num_points;
+	ok = fclose(file) == 0 && ok;
+	if (ok) {
+		printf("wrote %zu points to %s\n", cloud.num_points, points_filename);
+	}
+	else {
+		fprintf(stderr, "cannot write %s.\n", points_filename);
+	}
+	point_cloud_free(&cloud);
+	return ok;
+}
+
+//borrows the vertices of a mesh, the view must not be freed
+void point_cloud_view_mesh(point_cloud_t* cloud, vec3_t* vertices, int num_vertices, vec3_t bounds_center, float bounds_radius) {
+	cloud->points = vertices;
+	cloud->colors = NULL;
+	cloud->num_points = vertices ? num_vertices : 0;
+	cloud->bounds_center = bounds_center;
+	cloud->bounds_radius = bounds_radius;
+	cloud->spacing = point_spacing(bounds_radius, cloud->num_points);
+}
+
+void point_cloud_free(point_cloud_t* cloud) {
+	free(cloud->points);
+	free(cloud->colors);
+	memset(cloud, 0, sizeof(point_cloud_t));
+}
+
+//a square of size pixels at the depth of the point, limited to the rows of one band
+static void splat_point(point_splat_t splat, int row_begin, int row_end) {
+	rect_t area = splatter.area;
+	int x0 = splat.x > area.x0 ? splat.x : area.x0;
+	int x1 = splat.x + splat.size < area.x1 ? splat.x + splat.size : area.x1;
+	int y0 = splat.y > row_begin ? splat.y : row_begin;
+	int y1 = splat.y + splat.size < row_end ? splat.y + splat.size : row_end;
+	for (int y = y0; y < y1; y++) {
+		int row = window_width * y;
+		for (int x = x0; x < x1; x++) {
+			if (splat.depth < depth_buffer[row + x]) {
+				depth_buffer[row + x] = splat.depth;
+				color_buffer[row + x] = splat.color;
+			}
+		}
+	}
+}
+
+static FORCE_INLINE void emit_point(int job, float screen_x, float screen_y, float depth, float size, uint32_t color) {
+	//points right next to the near plane can project far outside of any int
+	rect_t area = splatter.area;
+	if (!(screen_x > area.x0 - POINT_MAX_SIZE && screen_x < area.x1 + POINT_MAX_SIZE
+		&& screen_y > area.y0 - POINT_MAX_SIZE && screen_y < area.y1 + POINT_MAX_SIZE)) {
+		return;
+	}
+	int pixels = size < POINT_MAX_SIZE ? (int)(size + 0.5f) : POINT_MAX_SIZE;
+	pixels = pixels < 1 ? 1 : pixels;
+	int x = (int)floorf(screen_x - pixels * 0.5f + 0.5f);
+	int y = (int)floorf(screen_y - pixels * 0.5f + 0.5f);
+	if (x >= area.x1 || y >= area.y1 || x + pixels <= area.x0 || y + pixels <= area.y0) {
+		return;
+	}
+
+	point_splat_t splat = { (int16_t)x, (int16_t)y, (uint8_t)pixels, depth, color };
+	if (splatter.direct) {
+		splat_point(splat, area.y0, area.y1);
+		return;
+	}
+	int first_band = (y > area.y0 ? y : area.y0) / POINT_BAND_HEIGHT;
+	int last_band = ((y + pixels < area.y1 ? y + pixels : area.y1) - 1) / POINT_BAND_HEIGHT;
+	for (int band = first_band; band <= last_band; band++) {
+		array_push(splatter.bins[job * splatter.num_bands + band], splat);
+	}
+}
+
+//clip space to screen for one point, false when it is behind the near plane or past the far one
+static FORCE_INLINE bool project_point(vec3_t p, float* screen_x, float* screen_y, float* depth, float* size) {
+	const float(*m)[4] = splatter.model_view_projection.m;
+	float w = m[3][0] * p.x + m[3][1] * p.y + m[3][2] * p.z + m[3][3];
+	float z = m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3];
+	if (!(w > 0.0f) || z < 0.0f || z > w) {
+		return false;
+	}
+	float x = m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3];
+	float y = m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3];
+	float inverse_w = 1.0f / w;
+	*screen_x = x * inverse_w * splatter.half_width + splatter.half_width;
+	*screen_y = splatter.half_height - y * inverse_w * splatter.half_height;
+	*depth = z * inverse_w;
+	*size = splatter.size_factor * inverse_w;
+	return true;
+}
+
+//transforms four points per step, only the ones in front of the camera leave the registers
+static void transform_points(const point_cloud_t* cloud, size_t first, size_t end, int job) {
+	const vec3_t* RESTRICT points = cloud->points;
+	const uint32_t* colors = cloud->colors;
+	size_t i = first;
+#if USE_SSE2
+	const float(*m)[4] = splatter.model_view_projection.m;
+	__m128 rows[4][4];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			rows[r][c] = _mm_set1_ps(m[r][c]);
+		}
+	}
+	__m128 half_width = _mm_set1_ps(splatter.half_width);
+	__m128 half_height = _mm_set1_ps(splatter.half_height);
+	__m128 size_factor = _mm_set1_ps(splatter.size_factor);
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+
+	for (; i + 4 <= end; i += 4) {
+		const vec3_t* p = &points[i];
+		__m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+		__m128 y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+		__m128 z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+#define POINT_ROW(r) _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rows[r][0], x), _mm_mul_ps(rows[r][1], y)), _mm_mul_ps(rows[r][2], z)), rows[r][3])
+		__m128 clip_w = POINT_ROW(3);
+		__m128 clip_z = POINT_ROW(2);
+		__m128 visible = _mm_and_ps(_mm_cmpgt_ps(clip_w, zero), _mm_and_ps(_mm_cmpge_ps(clip_z, zero), _mm_cmple_ps(clip_z, clip_w)));
+		int mask = _mm_movemask_ps(visible);
+		if (mask == 0) {
+			continue;
+		}
+		__m128 inverse_w = _mm_div_ps(one, clip_w);
+		float screen_x[4], screen_y[4], depth[4], size[4];
+		_mm_storeu_ps(screen_x, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(POINT_ROW(0), inverse_w), half_width), half_width));
+		_mm_storeu_ps(screen_y, _mm_sub_ps(half_height, _mm_mul_ps(_mm_mul_ps(POINT_ROW(1), inverse_w), half_height)));
+		_mm_storeu_ps(depth, _mm_mul_ps(clip_z, inverse_w));
+		_mm_storeu_ps(size, _mm_mul_ps(size_factor, inverse_w));
+#undef POINT_ROW
+		for (int k = 0; k < 4; k++) {
+			if (mask & (1 << k)) {
+				emit_point(job, screen_x[k], screen_y[k], depth[k], size[k], colors ? colors[i + k] : POINT_CLOUD_COLOR);
+			}
+		}
+	}
+#endif
+	for (; i < end; i++) {
+		float screen_x, screen_y, depth, size;
+		if (project_point(points[i], &screen_x, &screen_y, &depth, &size)) {
+			emit_point(job, screen_x, screen_y, depth, size, colors ? colors[i] : POINT_CLOUD_COLOR);
+		}
+	}
+}
+
+static void transform_job(void* data) {
+	point_job_t* job = (point_job_t*)data;
+	transform_points(job->cloud, job->first, job->end, job->job);
+}
+
+static void splat_band_job(void* data) {
+	int band = (int)(intptr_t)data;
+	int row_begin = band * POINT_BAND_HEIGHT;
+	int row_end = row_begin + POINT_BAND_HEIGHT;
+	row_begin = row_begin > splatter.area.y0 ? row_begin : splatter.area.y0;
+	row_end = row_end < splatter.area.y1 ? row_end : splatter.area.y1;
+	//jobs in order, so points of a band are splatted in the order of the cloud
+	for (int job = 0; job < splatter.num_jobs; job++) {
+		const point_splat_t* bin = splatter.bins[job * splatter.num_bands + band];
+		int count = array_length((void*)bin);
+		for (int i = 0; i < count; i++) {
+			splat_point(bin[i], row_begin, row_end);
+		}
+	}
+}
+
+static bool prepare_bins(void) {
+	splatter.num_jobs = splatter.num_threads;
+	splatter.num_bands = (window_height + POINT_BAND_HEIGHT - 1) / POINT_BAND_HEIGHT;
+	int num_bins = splatter.num_jobs * splatter.num_bands;
+	if (num_bins > splatter.num_bins) {
+		point_splat_t** bins = (point_splat_t**)realloc(splatter.bins, sizeof(point_splat_t*) * num_bins);
+		if (!bins) {
+			fprintf(stderr, "Error creating the point bins. Probably not enough avaliable memory.\n");
+			return false;
+		}
+		memset(bins + splatter.num_bins, 0, sizeof(point_splat_t*) * (num_bins - splatter.num_bins));
+		splatter.bins = bins;
+		splatter.num_bins = num_bins;
+	}
+	return true;
+}
+
+//splats every point once into color_buffer and depth_buffer inside of area, which has to be
+//cleared before. the points go through in chunks: the transform jobs sort a chunk into screen
+//bands, then every band is splatted by its own job
+void point_cloud_render(const point_cloud_t* cloud, const mat4_t* world, float max_scale, rect_t area) {
+	splatter.area = rect_intersect(area, rect_make(0, 0, window_width, window_height));
+	if (cloud->num_points == 0 || rect_is_empty(splatter.area)) {
+		return;
+	}
+	splatter.model_view_projection = mat4_mul_mat4(camera.view_projection_matrix, *world);
+	splatter.half_width = window_width / 2.0f;
+	splatter.half_height = window_height / 2.0f;
+	//a point covers its share of the surface: the spacing seen from w away
+	splatter.size_factor = cloud->spacing * max_scale * point_size_scale * camera.projection_matrix.m[1][1] * splatter.half_height;
+
+	if (splatter.num_threads == 0) {
+		splatter.num_threads = SDL_GetCPUCount() > 1 ? SDL_GetCPUCount() : 1;
+		splatter.pool = splatter.num_threads > 1 ? thread_pool_create(splatter.num_threads, "points") : NULL;
+		splatter.num_threads = splatter.pool ? splatter.num_threads : 1;
+	}
+	splatter.direct = !splatter.pool || cloud->num_points < POINT_CHUNK_POINTS / 16 || !prepare_bins();
+	if (splatter.direct) {
+		transform_points(cloud, 0, cloud->num_points, 0);
+		return;
+	}
+
+	int first_band = splatter.area.y0 / POINT_BAND_HEIGHT;
+	int last_band = (splatter.area.y1 - 1) / POINT_BAND_HEIGHT;
+	for (size_t chunk = 0; chunk < cloud->num_points; chunk += POINT_CHUNK_POINTS) {
+		size_t chunk_end = chunk + POINT_CHUNK_POINTS < cloud->num_points ? chunk + POINT_CHUNK_POINTS : cloud->num_points;
+		size_t per_job = (chunk_end - chunk + splatter.num_jobs - 1) / splatter.num_jobs;
+		for (int i = 0; i < splatter.num_bins; i++) {
+			array_truncate(splatter.bins[i], 0);
+		}
+
+		array_truncate(splatter.jobs, 0);
+		for (int job = 0; job < splatter.num_jobs; job++) {
+			size_t first = chunk + per_job * job;
+			point_job_t range = { cloud, first < chunk_end ? first : chunk_end, first + per_job < chunk_end ? first + per_job : chunk_end, job };
+			array_push(splatter.jobs, range);
+		}
+		for (int job = 0; job < splatter.num_jobs; job++) {
+			thread_pool_submit(splatter.pool, transform_job, &splatter.jobs[job]);
+		}
+		thread_pool_wait(splatter.pool);
+
+		for (int band = first_band; band <= last_band; band++) {
+			thread_pool_submit(splatter.pool, splat_band_job, (void*)(intptr_t)band);
+		}
+		thread_pool_wait(splatter.pool);
+	}
+}
+
+void point_cloud_shutdown(void) {
+	thread_pool_destroy(splatter.pool);
+	for (int i = 0; i < splatter.num_bins; i++) {
+		array_free(splatter.bins[i]);
+	}
+	free(splatter.bins);
+	array_free(splatter.jobs);
+	memset(&splatter, 0, sizeof(splatter));
+}
@@ -0,0 +1,53 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "vector.h"
+#include "matrix.h"
+#include "rect.h"
+
+//display mode that splats points instead of rasterizing faces
+#define POINT_DISPLAY_MODE 6
+#define POINT_CLOUD_COLOR 0xFFFFFFFF //of points without their own color
+#define POINT_MAX_SIZE 8 //pixels, closer points stop growing
+//points transformed between two splat passes, bounds the memory of the screen space bins
+#define POINT_CHUNK_POINTS (1 << 20)
+//rows of the screen splatted by one job
+#define POINT_BAND_HEIGHT 32
+
+//a point cloud file (.pts) is a point_cloud_file_header_t, the positions (vec3_t) and, when
+//POINT_CLOUD_HAS_COLORS is set, one ARGB8888 color per point. little endian
+#define POINT_CLOUD_HAS_COLORS 1
+
+typedef struct {
+	char magic[4]; //"PTS1"
+	uint32_t flags;
+	uint64_t num_points;
+	vec3_t bounds_center;
+	float bounds_radius;
+} point_cloud_file_header_t;
+
+typedef struct {
+	vec3_t* points;
+	uint32_t* colors; //NULL draws every point in POINT_CLOUD_COLOR
+	size_t num_points;
+	vec3_t bounds_center; //bounding sphere in model space, for frustum culling
+	float bounds_radius;
+	float spacing; //typical distance between neighbouring points, sets their size on screen
+} point_cloud_t;
+
+//loaded with --points, display mode 6 draws the vertices of the mesh while it is empty
+extern point_cloud_t point_cloud;
+//multiplies the adaptive point size
+extern float point_size_scale;
+
+bool point_cloud_load(point_cloud_t* cloud, const char* filename);
+bool point_cloud_build_file(const char* obj_filename, const char* points_filename);
+void point_cloud_view_mesh(point_cloud_t* cloud, vec3_t* vertices, int num_vertices, vec3_t bounds_center, float bounds_radius);
+void point_cloud_render(const point_cloud_t* cloud, const mat4_t* world, float max_scale, rect_t area);
+void point_cloud_free(point_cloud_t* cloud);
+void point_cloud_shutdown(void);
+
+#endif
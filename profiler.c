@@ -0,0 +1,383 @@
+#ifdef ENABLE_PROFILER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <SDL.h>
+#include "display.h"
+#include "profiler.h"
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+#define PROFILER_MAX_THREADS 32
+#define PROFILER_RING_SIZE 8192 //power of two
+#define PROFILER_MAX_DEPTH 16
+
+typedef struct {
+	uint64_t start;
+	uint64_t end;
+	int stage;
+} profile_event_t;
+
+//every thread writes only to its own ring, the index is published after the event
+//is complete so the reader never needs a lock. the reader (profiler_end_frame and the
+//trace export) runs on the main thread between frames, while the workers are idle
+typedef struct {
+	profile_event_t events[PROFILER_RING_SIZE];
+	SDL_atomic_t write_index;
+	int read_index;
+	//open scopes, the stage is kept to catch PROFILE_END calls not matching their PROFILE_BEGIN
+	uint64_t stack[PROFILER_MAX_DEPTH];
+	int stack_stages[PROFILER_MAX_DEPTH];
+	int depth;
+	int dropped_depth; //scopes opened while the stack was full, they are not recorded
+	bool reported_mismatch;
+	int64_t counters[PROFILE_COUNTERS];
+	char name[32];
+} profile_thread_t;
+
+static const char* stage_names[PROFILE_STAGES] = {
+	"frame", "input", "transform", "cull", "project", "sort", "shadow", "clear",
+	"raster mode 1", "raster mode 2", "raster mode 3", "raster mode 4", "raster mode 5",
+	"raster mode 6",
+	"resolve", "upload", "present", "write image"
+};
+
+static const char* counter_names[PROFILE_COUNTERS] = {
+	"faces in", "culled", "clipped", "emitted", "pixels", "overdraw", "input latency"
+};
+
+static profile_thread_t* profile_threads[PROFILER_MAX_THREADS];
+static SDL_atomic_t profile_thread_count;
+static THREAD_LOCAL profile_thread_t* current_thread = NULL;
+static THREAD_LOCAL bool current_thread_registered = false;
+
+static uint64_t start_ticks = 0;
+static double ticks_per_ms = 1.0;
+
+//how often every pixel of the current frame has been written, for the overdraw counter
+static uint8_t* pixel_writes = NULL;
+static int pixel_writes_width = 0;
+static int pixel_writes_height = 0;
+
+//filled in by the rendering thread during the frame
+static int64_t frame_overdraw_histogram[OVERDRAW_LEVELS];
+
+profile_frame_t profile_last_frame;
+bool profiler_hud_visible = false;
+
+void profiler_init(void) {
+	start_ticks = SDL_GetPerformanceCounter();
+	ticks_per_ms = SDL_GetPerformanceFrequency() / 1000.0;
+	profiler_set_thread_name("main");
+}
+
+bool profiler_set_viewport(int width, int height) {
+	free(pixel_writes);
+	pixel_writes = (uint8_t*)calloc((size_t)width * height, sizeof(uint8_t));
+	pixel_writes_width = pixel_writes ? width : 0;
+	pixel_writes_height = pixel_writes ? height : 0;
+	if (!pixel_writes) {
+		fprintf(stderr, "Error creating the overdraw buffer. Probably not enough avaliable memory.\n");
+		return false;
+	}
+	return true;
+}
+
+void profiler_shutdown(void) {
+	int count = SDL_AtomicGet(&profile_thread_count);
+	for (int i = 0; i < count && i < PROFILER_MAX_THREADS; i++) {
+		free(profile_threads[i]);
+		profile_threads[i] = NULL;
+	}
+	SDL_AtomicSet(&profile_thread_count, 0);
+	free(pixel_writes);
+	pixel_writes = NULL;
+}
+
+//threads register themselves on their first event, threads beyond the limit are not recorded
+static profile_thread_t* get_thread(void) {
+	if (current_thread_registered) {
+		return current_thread;
+	}
+	current_thread_registered = true;
+
+	int slot = SDL_AtomicAdd(&profile_thread_count, 1);
+	if (slot >= PROFILER_MAX_THREADS) {
+		return NULL;
+	}
+	profile_thread_t* thread = (profile_thread_t*)calloc(1, sizeof(profile_thread_t));
+	if (thread) {
+		snprintf(thread->name, sizeof(thread->name), "thread %d", slot);
+	}
+	SDL_AtomicSetPtr((void**)&profile_threads[slot], thread);
+	current_thread = thread;
+	return thread;
+}
+
+void profiler_set_thread_name(const char* name) {
+	profile_thread_t* thread = get_thread();
+	if (thread) {
+		snprintf(thread->name, sizeof(thread->name), "%s", name);
+	}
+}
+
+void profiler_begin(int stage) {
+	profile_thread_t* thread = get_thread();
+	if (!thread) {
+		return;
+	}
+	if (thread->depth == PROFILER_MAX_DEPTH) {
+		thread->dropped_depth++;
+		return;
+	}
+	thread->stack_stages[thread->depth] = stage;
+	thread->stack[thread->depth++] = SDL_GetPerformanceCounter();
+}
+
+void profiler_end(int stage) {
+	profile_thread_t* thread = current_thread;
+	if (!thread) {
+		return;
+	}
+	if (thread->dropped_depth > 0) {
+		thread->dropped_depth--;
+		return;
+	}
+	if (thread->depth == 0) {
+		return;
+	}
+	uint64_t start = thread->stack[--thread->depth];
+	int begun_stage = thread->stack_stages[thread->depth];
+	if (begun_stage != stage) {
+		//the span would be attributed to the wrong stage, it is left out
+		if (!thread->reported_mismatch) {
+			thread->reported_mismatch = true;
+			fprintf(stderr, "profiler: PROFILE_END(%s) closes PROFILE_BEGIN(%s) on %s.\n",
+				stage_names[stage], stage_names[begun_stage], thread->name);
+		}
+		return;
+	}
+	int index = SDL_AtomicGet(&thread->write_index);
+	profile_event_t* event = &thread->events[index & (PROFILER_RING_SIZE - 1)];
+	event->start = start;
+	event->end = SDL_GetPerformanceCounter();
+	event->stage = stage;
+	SDL_AtomicSet(&thread->write_index, index + 1);
+}
+
+void profiler_count(int counter, int64_t amount) {
+	profile_thread_t* thread = get_thread();
+	if (thread) {
+		thread->counters[counter] += amount;
+	}
+}
+
+void profiler_count_pixel(int index) {
+	profile_thread_t* thread = get_thread();
+	if (!thread) {
+		return;
+	}
+	thread->counters[PROFILE_PIXELS_WRITTEN]++;
+	if (pixel_writes && index >= 0 && index < pixel_writes_width * pixel_writes_height) {
+		if (pixel_writes[index] != 0) {
+			thread->counters[PROFILE_OVERDRAW]++;
+		}
+		if (pixel_writes[index] != 255) {
+			pixel_writes[index]++;
+		}
+	}
+}
+
+void profiler_clear_rect(rect_t r) {
+	r = rect_intersect(r, rect_make(0, 0, pixel_writes_width, pixel_writes_height));
+	for (int y = r.y0; y < r.y1; y++) {
+		memset(pixel_writes + pixel_writes_width * y + r.x0, 0, r.x1 - r.x0);
+	}
+}
+
+void profiler_add_overdraw_histogram(const int64_t histogram[OVERDRAW_LEVELS]) {
+	for (int i = 0; i < OVERDRAW_LEVELS; i++) {
+		frame_overdraw_histogram[i] += histogram[i];
+	}
+}
+
+//collects the events and counters of every thread since the last call into profile_last_frame
+void profiler_end_frame(void) {
+	profile_frame_t frame;
+	memset(&frame, 0, sizeof(frame));
+
+	int count = SDL_AtomicGet(&profile_thread_count);
+	for (int i = 0; i < count && i < PROFILER_MAX_THREADS; i++) {
+		profile_thread_t* thread = (profile_thread_t*)SDL_AtomicGetPtr((void**)&profile_threads[i]);
+		if (!thread) {
+			continue;
+		}
+		int write_index = SDL_AtomicGet(&thread->write_index);
+		//events older than one ring have been overwritten already
+		if (write_index - thread->read_index > PROFILER_RING_SIZE) {
+			thread->read_index = write_index - PROFILER_RING_SIZE;
+		}
+		for (int e = thread->read_index; e != write_index; e++) {
+			profile_event_t* event = &thread->events[e & (PROFILER_RING_SIZE - 1)];
+			frame.stage_ms[event->stage] += (event->end - event->start) / ticks_per_ms;
+		}
+		thread->read_index = write_index;
+
+		for (int c = 0; c < PROFILE_COUNTERS; c++) {
+			frame.counters[c] += thread->counters[c];
+			thread->counters[c] = 0;
+		}
+	}
+	memcpy(frame.overdraw_histogram, frame_overdraw_histogram, sizeof(frame_overdraw_histogram));
+	memset(frame_overdraw_histogram, 0, sizeof(frame_overdraw_histogram));
+	profile_last_frame = frame;
+}
+
+//3x5 pixel font for ' ' to 'Z', one bit per pixel, rows from the top
+static const uint16_t hud_font[] = {
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x52A5, 0x0000, 0x0000,
+	0x2922, 0x224A, 0x0000, 0x0000, 0x0000, 0x01C0, 0x0002, 0x12A4,
+	0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249,
+	0x7BEF, 0x7BCF, 0x0410, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B,
+	0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED, 0x6B6D, 0x2B6A,
+	0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A, 0x5BFD,
+	0x5AAD, 0x5A92, 0x72A7,
+};
+
+#define HUD_SCALE 2
+#define HUD_CHAR_WIDTH (4 * HUD_SCALE)
+#define HUD_LINE_HEIGHT (7 * HUD_SCALE)
+#define HUD_MARGIN 8
+#define HUD_COLUMNS 28
+#define HUD_HISTOGRAM_HEIGHT (3 * HUD_LINE_HEIGHT)
+#define HUD_LINES (PROFILE_STAGES + 4 + 3)
+
+rect_t profiler_hud_rect(void) {
+	rect_t hud = rect_make(HUD_MARGIN, HUD_MARGIN,
+		HUD_COLUMNS * HUD_CHAR_WIDTH + 2 * HUD_MARGIN,
+		HUD_LINES * HUD_LINE_HEIGHT + 2 * HUD_MARGIN);
+	return rect_intersect(hud, rect_make(0, 0, window_width, window_height));
+}
+
+//the hud writes into color_buffer directly so that it does not show up in the pixel counters
+static void hud_fill_rect(rect_t r, uint32_t color) {
+	r = rect_intersect(r, rect_make(0, 0, window_width, window_height));
+	for (int y = r.y0; y < r.y1; y++) {
+		for (int x = r.x0; x < r.x1; x++) {
+			color_buffer[window_width * y + x] = color;
+		}
+	}
+}
+
+static void hud_draw_text(int x, int y, const char* text, uint32_t color) {
+	for (; *text; text++, x += HUD_CHAR_WIDTH) {
+		int c = toupper((unsigned char)*text);
+		if (c < ' ' || c > 'Z') {
+			continue;
+		}
+		uint16_t glyph = hud_font[c - ' '];
+		for (int row = 0; row < 5; row++) {
+			for (int col = 0; col < 3; col++) {
+				if (glyph & (1 << (14 - row * 3 - col))) {
+					hud_fill_rect(rect_make(x + col * HUD_SCALE, y + row * HUD_SCALE, HUD_SCALE, HUD_SCALE), color);
+				}
+			}
+		}
+	}
+}
+
+void profiler_draw_hud(void) {
+	rect_t hud = profiler_hud_rect();
+	hud_fill_rect(hud, 0xFF202020);
+
+	char line[64];
+	int x = hud.x0 + HUD_MARGIN;
+	int y = hud.y0 + HUD_MARGIN;
+	for (int stage = 0; stage < PROFILE_STAGES; stage++) {
+		snprintf(line, sizeof(line), "%-14s%8.3f ms", stage_names[stage], profile_last_frame.stage_ms[stage]);
+		hud_draw_text(x, y, line, stage == PROFILE_FRAME ? 0xFFFFFF00 : 0xFFFFFFFF);
+		y += HUD_LINE_HEIGHT;
+	}
+
+	int64_t* counters = profile_last_frame.counters;
+	snprintf(line, sizeof(line), "%s %lld %s %lld", counter_names[PROFILE_FACES_IN], (long long)counters[PROFILE_FACES_IN],
+		counter_names[PROFILE_FACES_EMITTED], (long long)counters[PROFILE_FACES_EMITTED]);
+	hud_draw_text(x, y, line, 0xFF80FF80);
+	y += HUD_LINE_HEIGHT;
+	snprintf(line, sizeof(line), "%s %lld %s %lld", counter_names[PROFILE_FACES_CULLED], (long long)counters[PROFILE_FACES_CULLED],
+		counter_names[PROFILE_FACES_CLIPPED], (long long)counters[PROFILE_FACES_CLIPPED]);
+	hud_draw_text(x, y, line, 0xFF80FF80);
+	y += HUD_LINE_HEIGHT;
+	snprintf(line, sizeof(line), "%s %lld %s %lld", counter_names[PROFILE_PIXELS_WRITTEN], (long long)counters[PROFILE_PIXELS_WRITTEN],
+		counter_names[PROFILE_OVERDRAW], (long long)counters[PROFILE_OVERDRAW]);
+	hud_draw_text(x, y, line, 0xFF80FF80);
+	y += HUD_LINE_HEIGHT;
+	snprintf(line, sizeof(line), "%s %lld ms", counter_names[PROFILE_INPUT_LATENCY], (long long)counters[PROFILE_INPUT_LATENCY]);
+	hud_draw_text(x, y, line, 0xFF80FF80);
+	y += HUD_LINE_HEIGHT;
+
+	//overdraw histogram of the covered pixels, one bar per write count in the heatmap colors
+	int64_t* histogram = profile_last_frame.overdraw_histogram;
+	int64_t covered = 0;
+	for (int level = 1; level < OVERDRAW_LEVELS; level++) {
+		covered += histogram[level];
+	}
+	if (covered == 0) {
+		return;
+	}
+	int bar_width = (HUD_COLUMNS * HUD_CHAR_WIDTH) / (OVERDRAW_LEVELS - 1);
+	int bottom = y + HUD_HISTOGRAM_HEIGHT - HUD_SCALE;
+	for (int level = 1; level < OVERDRAW_LEVELS; level++) {
+		int height = (int)(histogram[level] * (HUD_HISTOGRAM_HEIGHT - HUD_SCALE) / covered);
+		int bar_x = x + (level - 1) * bar_width;
+		hud_fill_rect(rect_make(bar_x, bottom - height, bar_width - HUD_SCALE, height), overdraw_palette[level]);
+		hud_fill_rect(rect_make(bar_x, bottom, bar_width - HUD_SCALE, HUD_SCALE), 0xFF808080);
+	}
+}
+
+//writes every event still held by the rings in the Chrome trace event format (chrome://tracing, Perfetto)
+bool profiler_write_chrome_trace(const char* filename) {
+	FILE* file;
+	fopen_s(&file, filename, "w");
+	if (!file) {
+		fprintf(stderr, "cannot open %s.\n", filename);
+		return false;
+	}
+
+	double ticks_per_us = ticks_per_ms / 1000.0;
+	bool first = true;
+	fprintf(file, "{\"traceEvents\":[\n");
+	int count = SDL_AtomicGet(&profile_thread_count);
+	for (int i = 0; i < count && i < PROFILER_MAX_THREADS; i++) {
+		profile_thread_t* thread = (profile_thread_t*)SDL_AtomicGetPtr((void**)&profile_threads[i]);
+		if (!thread) {
+			continue;
+		}
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", i, thread->name);
+		first = false;
+
+		int write_index = SDL_AtomicGet(&thread->write_index);
+		int oldest = write_index > PROFILER_RING_SIZE ? write_index - PROFILER_RING_SIZE : 0;
+		for (int e = oldest; e < write_index; e++) {
+			profile_event_t* event = &thread->events[e & (PROFILER_RING_SIZE - 1)];
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				stage_names[event->stage], i,
+				(double)(int64_t)(event->start - start_ticks) / ticks_per_us,
+				(double)(event->end - event->start) / ticks_per_us);
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rect.h"
+#include "display.h"
+
+//pipeline stages that get timed, the raster stages follow the display modes
+enum {
+	PROFILE_FRAME,
+	PROFILE_INPUT,
+	PROFILE_TRANSFORM,
+	PROFILE_CULL,
+	PROFILE_PROJECT,
+	PROFILE_SORT,
+	PROFILE_SHADOW,
+	PROFILE_CLEAR,
+	PROFILE_RASTER_MODE_1,
+	PROFILE_RASTER_MODE_2,
+	PROFILE_RASTER_MODE_3,
+	PROFILE_RASTER_MODE_4,
+	PROFILE_RASTER_MODE_5,
+	PROFILE_RASTER_MODE_6,
+	PROFILE_RESOLVE,
+	PROFILE_UPLOAD,
+	PROFILE_PRESENT,
+	PROFILE_WRITE_IMAGE,
+	PROFILE_STAGES
+};
+
+//per frame counters
+enum {
+	PROFILE_FACES_IN,
+	PROFILE_FACES_CULLED,
+	PROFILE_FACES_CLIPPED,
+	PROFILE_FACES_EMITTED,
+	PROFILE_PIXELS_WRITTEN,
+	PROFILE_OVERDRAW,
+	PROFILE_INPUT_LATENCY, //ms from the oldest input shown in the frame to its present
+	PROFILE_COUNTERS
+};
+
+//everything below only exists in builds with ENABLE_PROFILER defined (Debug by default),
+//otherwise the macros expand to nothing and the hot paths carry no trace of it
+#ifdef ENABLE_PROFILER
+
+#define PROFILE_BEGIN(stage) profiler_begin(stage)
+#define PROFILE_END(stage) profiler_end(stage)
+#define PROFILE_COUNT(counter, amount) profiler_count(counter, amount)
+#define PROFILE_PIXEL(index) profiler_count_pixel(index)
+#define PROFILE_CLEAR_RECT(r) profiler_clear_rect(r)
+#define PROFILE_THREAD_NAME(name) profiler_set_thread_name(name)
+#define PROFILE_OVERDRAW_HISTOGRAM(histogram) profiler_add_overdraw_histogram(histogram)
+
+typedef struct {
+	double stage_ms[PROFILE_STAGES];
+	int64_t counters[PROFILE_COUNTERS];
+	int64_t overdraw_histogram[OVERDRAW_LEVELS]; //pixels per write count, display mode 5 only
+} profile_frame_t;
+
+extern profile_frame_t profile_last_frame;
+extern bool profiler_hud_visible;
+
+void profiler_init(void);
+bool profiler_set_viewport(int width, int height);
+void profiler_shutdown(void);
+void profiler_set_thread_name(const char* name);
+void profiler_begin(int stage);
+void profiler_end(int stage);
+void profiler_count(int counter, int64_t amount);
+void profiler_count_pixel(int index);
+void profiler_clear_rect(rect_t r);
+void profiler_add_overdraw_histogram(const int64_t histogram[OVERDRAW_LEVELS]);
+void profiler_end_frame(void);
+rect_t profiler_hud_rect(void);
+void profiler_draw_hud(void);
+bool profiler_write_chrome_trace(const char* filename);
+
+#else
+
+#define PROFILE_BEGIN(stage) ((void)0)
+#define PROFILE_END(stage) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_PIXEL(index) ((void)0)
+#define PROFILE_CLEAR_RECT(r) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_OVERDRAW_HISTOGRAM(histogram) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#include "rect.h"
+
+rect_t rect_empty(void) {
+	rect_t r = { 0, 0, 0, 0 };
+	return r;
+}
+
+rect_t rect_make(int x, int y, int width, int height) {
+	rect_t r = { x, y, x + width, y + height };
+	return r;
+}
+
+bool rect_is_empty(rect_t r) {
+	return r.x0 >= r.x1 || r.y0 >= r.y1;
+}
+
+rect_t rect_union(rect_t r1, rect_t r2) {
+	if (rect_is_empty(r1)) {
+		return r2;
+	}
+	if (rect_is_empty(r2)) {
+		return r1;
+	}
+	rect_t r = {
+		r1.x0 < r2.x0 ? r1.x0 : r2.x0,
+		r1.y0 < r2.y0 ? r1.y0 : r2.y0,
+		r1.x1 > r2.x1 ? r1.x1 : r2.x1,
+		r1.y1 > r2.y1 ? r1.y1 : r2.y1
+	};
+	return r;
+}
+
+rect_t rect_intersect(rect_t r1, rect_t r2) {
+	rect_t r = {
+		r1.x0 > r2.x0 ? r1.x0 : r2.x0,
+		r1.y0 > r2.y0 ? r1.y0 : r2.y0,
+		r1.x1 < r2.x1 ? r1.x1 : r2.x1,
+		r1.y1 < r2.y1 ? r1.y1 : r2.y1
+	};
+	if (rect_is_empty(r)) {
+		return rect_empty();
+	}
+	return r;
+}
+
+rect_t rect_expand(rect_t r, int amount) {
+	if (rect_is_empty(r)) {
+		return r;
+	}
+	r.x0 -= amount;
+	r.y0 -= amount;
+	r.x1 += amount;
+	r.y1 += amount;
+	return r;
+}
+
+//grows the rectangle so the pixel at (x, y) is inside of it
+void rect_include_point(rect_t* r, int x, int y) {
+	if (rect_is_empty(*r)) {
+		r->x0 = x;
+		r->y0 = y;
+		r->x1 = x + 1;
+		r->y1 = y + 1;
+		return;
+	}
+	if (x < r->x0) r->x0 = x;
+	if (y < r->y0) r->y0 = y;
+	if (x + 1 > r->x1) r->x1 = x + 1;
+	if (y + 1 > r->y1) r->y1 = y + 1;
+}
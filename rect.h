@@ -0,0 +1,20 @@
+#ifndef RECT_H
+#define RECT_H
+
+#include <stdbool.h>
+
+//screen space rectangle, min inclusive and max exclusive
+typedef struct {
+	int x0, y0;
+	int x1, y1;
+} rect_t;
+
+rect_t rect_empty(void);
+rect_t rect_make(int x, int y, int width, int height);
+bool rect_is_empty(rect_t r);
+rect_t rect_union(rect_t r1, rect_t r2);
+rect_t rect_intersect(rect_t r1, rect_t r2);
+rect_t rect_expand(rect_t r, int amount);
+void rect_include_point(rect_t* r, int x, int y);
+
+#endif
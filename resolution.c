@@ -0,0 +1,58 @@
+#include <math.h>
+#include "resolution.h"
+
+resolution_controller_t resolution = {
+	.enabled = false,
+	.budget_ms = RESOLUTION_DEFAULT_BUDGET_MS,
+	.scale = 1.0f,
+	.smoothed_ms = 0.0f
+};
+
+//takes the raster time of the last frame, returns true when the scale changed.
+//raster time grows with the pixel count, so the scale that would just fit the budget is
+//the current one times the square root of budget / time. it drops quickly when a frame
+//gets too slow and grows back by at most one step per frame
+bool resolution_update(resolution_controller_t* c, float raster_ms) {
+	if (!c->enabled || raster_ms <= 0.0f) {
+		return false;
+	}
+	c->smoothed_ms = c->smoothed_ms > 0.0f ? c->smoothed_ms + (raster_ms - c->smoothed_ms) * 0.25f : raster_ms;
+
+	float ideal = c->scale * sqrtf(c->budget_ms / c->smoothed_ms);
+	if (ideal > c->scale) {
+		//growing aims under the budget, so noise right at the budget does not flip between two steps
+		ideal = fmaxf(c->scale, c->scale * sqrtf(c->budget_ms * 0.9f / c->smoothed_ms));
+	}
+	float lowest = c->scale * 0.85f;
+	float highest = c->scale + RESOLUTION_SCALE_STEP;
+	ideal = ideal < lowest ? lowest : (ideal > highest ? highest : ideal);
+	ideal = ideal < RESOLUTION_MIN_SCALE ? RESOLUTION_MIN_SCALE : (ideal > 1.0f ? 1.0f : ideal);
+
+	//snapping down to a whole step means growing needs room for a whole step
+	float scale = floorf(ideal / RESOLUTION_SCALE_STEP + 0.001f) * RESOLUTION_SCALE_STEP;
+	scale = scale < RESOLUTION_MIN_SCALE ? RESOLUTION_MIN_SCALE : scale;
+	if (scale == c->scale) {
+		return false;
+	}
+
+	//expect the new pixel count right away instead of waiting for the average to catch up
+	c->smoothed_ms *= (scale * scale) / (c->scale * c->scale);
+	c->scale = scale;
+	return true;
+}
+
+//back to the full resolution, returns the controller to its starting state
+void resolution_reset(resolution_controller_t* c) {
+	c->scale = 1.0f;
+	c->smoothed_ms = 0.0f;
+}
+
+void resolution_size(const resolution_controller_t* c, int output_width, int output_height, int* width, int* height) {
+	float scale = c->enabled ? c->scale : 1.0f;
+	*width = (int)(output_width * scale + 0.5f);
+	*height = (int)(output_height * scale + 0.5f);
+	if (*width < 1) *width = 1;
+	if (*height < 1) *height = 1;
+	if (*width > output_width) *width = output_width;
+	if (*height > output_height) *height = output_height;
+}
@@ -0,0 +1,29 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <stdbool.h>
+
+//dynamic resolution: the frame is rendered into the top left part of the buffers and
+//scaled up to the window when it is shown. the controller picks that part per frame so
+//that the raster time stays inside of a budget
+
+//leaves room in a 60 fps frame for transform, present and the vsync wait
+#define RESOLUTION_DEFAULT_BUDGET_MS 10.0f
+#define RESOLUTION_MIN_SCALE 0.5f
+//scales are multiples of this, so small changes in frame time do not resize every frame
+#define RESOLUTION_SCALE_STEP (1.0f / 32.0f)
+
+typedef struct {
+	bool enabled;
+	float budget_ms; //raster time to hold
+	float scale; //of the width and height, RESOLUTION_MIN_SCALE - 1
+	float smoothed_ms; //recent raster times, 0 before the first one
+} resolution_controller_t;
+
+extern resolution_controller_t resolution;
+
+bool resolution_update(resolution_controller_t* c, float raster_ms);
+void resolution_reset(resolution_controller_t* c);
+void resolution_size(const resolution_controller_t* c, int output_width, int output_height, int* width, int* height);
+
+#endif
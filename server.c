@@ -0,0 +1,559 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "server.h"
+
+//Windows 10 has Unix domain sockets too, the frame ring is a named file mapping there
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+typedef SOCKET socket_t;
+#define NO_SOCKET INVALID_SOCKET
+#define close_socket closesocket
+#define socket_error() WSAGetLastError()
+#define SOCKET_INTERRUPTED WSAEINTR
+#else
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+typedef int socket_t;
+#define NO_SOCKET (-1)
+#define close_socket close
+#define socket_error() errno
+#define SOCKET_INTERRUPTED EINTR
+#endif
+
+//the commands only read numbers, which the _s variant takes without buffer sizes
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
+
+#include <SDL.h>
+#include "array.h"
+#include "display.h"
+#include "mesh.h"
+#include "obj_loader.h"
+#include "pipeline.h"
+#include "camera.h"
+#include "light.h"
+#include "shadow.h"
+#include "point_cloud.h"
+
+#define SERVER_LINE_SIZE 1024
+#define SERVER_REPLY_SIZE 256
+
+//a mesh kept loaded between requests, mesh points at it while it renders
+typedef struct {
+	int id;
+	mesh_t mesh;
+	int alpha; //currently set on its faces
+} server_mesh_t;
+
+typedef struct {
+	char shm_name[64];
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+	server_ring_header_t* ring;
+	size_t ring_size;
+	server_mesh_t* meshes; //dynamic array
+	int vertex_buffers_mesh; //id the vertex buffers are set up for, -1 for none
+	int alpha;
+	bool packed;
+	uint32_t sequence;
+	bool running;
+} render_server_t;
+
+static const mesh_t no_mesh = { .scale = { 1.0f, 1.0f, 1.0f } };
+
+static bool create_ring(render_server_t* server, int width, int height) {
+	size_t frame_size = sizeof(uint32_t) * width * height;
+	//frames start on a cache line
+	size_t frame_offset = (sizeof(server_ring_header_t) + 63) & ~(size_t)63;
+	server->ring_size = frame_offset + frame_size * SERVER_RING_FRAMES;
+
+#ifdef _WIN32
+	snprintf(server->shm_name, sizeof(server->shm_name), "Local\\3drenderer-%lu", (unsigned long)GetCurrentProcessId());
+	uint64_t mapping_size = server->ring_size;
+	server->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)(mapping_size >> 32), (DWORD)mapping_size, server->shm_name);
+	if (!server->mapping || GetLastError() == ERROR_ALREADY_EXISTS) {
+		fprintf(stderr, "cannot create the shared memory %s.\n", server->shm_name);
+		if (server->mapping) {
+			CloseHandle(server->mapping);
+			server->mapping = NULL;
+		}
+		return false;
+	}
+	void* memory = MapViewOfFile(server->mapping, FILE_MAP_ALL_ACCESS, 0, 0, server->ring_size);
+	if (!memory) {
+		fprintf(stderr, "Error creating the frame ring. Probably not enough avaliable memory.\n");
+		CloseHandle(server->mapping);
+		server->mapping = NULL;
+		return false;
+	}
+#else
+	snprintf(server->shm_name, sizeof(server->shm_name), "/3drenderer-%d", (int)getpid());
+	int fd = shm_open(server->shm_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "cannot create the shared memory %s.\n", server->shm_name);
+		return false;
+	}
+	void* memory = MAP_FAILED;
+	if (ftruncate(fd, (off_t)server->ring_size) == 0) {
+		memory = mmap(NULL, server->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (memory == MAP_FAILED) {
+		fprintf(stderr, "Error creating the frame ring. Probably not enough avaliable memory.\n");
+		shm_unlink(server->shm_name);
+		return false;
+	}
+#endif
+
+	server->ring = (server_ring_header_t*)memory;
+	server->ring->magic = SERVER_RING_MAGIC;
+	server->ring->width = width;
+	server->ring->height = height;
+	server->ring->num_frames = SERVER_RING_FRAMES;
+	server->ring->frame_offset = frame_offset;
+	server->ring->frame_size = frame_size;
+	for (int i = 0; i < SERVER_RING_FRAMES; i++) {
+		server->ring->fences[i] = 0;
+	}
+	return true;
+}
+
+static void destroy_ring(render_server_t* server) {
+	if (server->ring) {
+#ifdef _WIN32
+		UnmapViewOfFile(server->ring);
+		CloseHandle(server->mapping);
+		server->mapping = NULL;
+#else
+		munmap(server->ring, server->ring_size);
+		shm_unlink(server->shm_name);
+#endif
+		server->ring = NULL;
+	}
+}
+
+static server_mesh_t* find_mesh(render_server_t* server, int id) {
+	int num_meshes = array_length(server->meshes);
+	for (int i = 0; i < num_meshes; i++) {
+		if (server->meshes[i].id == id) {
+			return &server->meshes[i];
+		}
+	}
+	return NULL;
+}
+
+static void unload_mesh(render_server_t* server, int id) {
+	server_mesh_t* entry = find_mesh(server, id);
+	if (!entry) {
+		return;
+	}
+	mesh_free(&entry->mesh);
+	*entry = server->meshes[array_length(server->meshes) - 1];
+	array_truncate(server->meshes, array_length(server->meshes) - 1);
+	if (server->vertex_buffers_mesh == id) {
+		server->vertex_buffers_mesh = -1;
+	}
+}
+
+static bool load_mesh(render_server_t* server, int id, const char* path, char* reply) {
+	server_mesh_t entry = { .id = id, .mesh = no_mesh, .alpha = 255 };
+	obj_load_parallel(path, &entry.mesh, 0);
+	if (array_length(entry.mesh.vertices) == 0) {
+		mesh_free(&entry.mesh);
+		snprintf(reply, SERVER_REPLY_SIZE, "error %s has no vertices", path);
+		return false;
+	}
+	mesh_build_edges(&entry.mesh);
+	mesh_compute_bounds(&entry.mesh);
+	if (server->packed && !mesh_pack(&entry.mesh)) {
+		mesh_free(&entry.mesh);
+		snprintf(reply, SERVER_REPLY_SIZE, "error cannot pack %s", path);
+		return false;
+	}
+
+	unload_mesh(server, id);
+	array_push(server->meshes, entry);
+	snprintf(reply, SERVER_REPLY_SIZE, "ok %d", mesh_face_count(&entry.mesh));
+	return true;
+}
+
+//renders straight into the next slot of the ring, the pixels are never copied
+static bool render_mesh(render_server_t* server, int id, char* reply) {
+	server_mesh_t* entry = find_mesh(server, id);
+	if (!entry) {
+		snprintf(reply, SERVER_REPLY_SIZE, "error no mesh %d", id);
+		return false;
+	}
+	if (entry->alpha != server->alpha) {
+		mesh_set_alpha(&entry->mesh, (uint8_t)server->alpha);
+		entry->alpha = server->alpha;
+	}
+
+	mesh = entry->mesh;
+	if (server->vertex_buffers_mesh != id) {
+		server->vertex_buffers_mesh = setup_vertex_buffers() ? id : -1;
+		if (server->vertex_buffers_mesh != id) {
+			mesh = no_mesh;
+			snprintf(reply, SERVER_REPLY_SIZE, "error out of memory");
+			return false;
+		}
+	}
+
+	//0 marks a slot being written, so the sequence skips it when it wraps around
+	if (++server->sequence == 0) {
+		server->sequence = 1;
+	}
+	int slot = (server->sequence - 1) % SERVER_RING_FRAMES;
+	server->ring->fences[slot] = 0;
+	SDL_MemoryBarrierRelease();
+
+	color_buffer = (uint32_t*)((uint8_t*)server->ring + server->ring->frame_offset + server->ring->frame_size * slot);
+	transform_mesh();
+	render_triangles(rect_make(0, 0, window_width, window_height));
+
+	SDL_MemoryBarrierRelease();
+	server->ring->fences[slot] = server->sequence;
+
+	entry->mesh = mesh;
+	mesh = no_mesh;
+	snprintf(reply, SERVER_REPLY_SIZE, "frame %u %d", server->sequence, slot);
+	return true;
+}
+
+static char* skip_spaces(char* text) {
+	while (*text == ' ' || *text == '\t') {
+		text++;
+	}
+	return text;
+}
+
+static bool starts_with_keyword(const char* line, const char* keyword) {
+	size_t length = strlen(keyword);
+	return strncmp(line, keyword, length) == 0 && (line[length] == ' ' || line[length] == '\t' || line[length] == '\0');
+}
+
+//one command line, reply gets the answer without the line end
+static void handle_command(render_server_t* server, char* text, char* reply) {
+	int value = 0;
+	bool parsed = false;
+	snprintf(reply, SERVER_REPLY_SIZE, "ok");
+
+	if (starts_with_keyword(text, "load")) {
+		int offset = 0;
+		parsed = sscanf_s(text, "load %d %n", &value, &offset) == 1 && offset > 0 && text[offset] != '\0';
+		if (parsed) {
+			load_mesh(server, value, text + offset, reply);
+		}
+	}
+	else if (starts_with_keyword(text, "unload")) {
+		parsed = sscanf_s(text, "unload %d", &value) == 1;
+		if (parsed) {
+			unload_mesh(server, value);
+		}
+	}
+	else if (starts_with_keyword(text, "skin")) {
+		int offset = 0;
+		parsed = sscanf_s(text, "skin %d %n", &value, &offset) == 1 && offset > 0 && text[offset] != '\0';
+		server_mesh_t* entry = parsed ? find_mesh(server, value) : NULL;
+		if (parsed && !entry) {
+			snprintf(reply, SERVER_REPLY_SIZE, "error no mesh %d", value);
+		}
+		else if (entry && !mesh_load_skin(&entry->mesh, text + offset)) {
+			snprintf(reply, SERVER_REPLY_SIZE, "error cannot skin mesh %d with %s", value, text + offset);
+		}
+	}
+	else if (starts_with_keyword(text, "pose")) {
+		float time;
+		parsed = sscanf_s(text, "pose %d %f", &value, &time) == 2;
+		server_mesh_t* entry = parsed ? find_mesh(server, value) : NULL;
+		if (parsed && !entry) {
+			snprintf(reply, SERVER_REPLY_SIZE, "error no mesh %d", value);
+		}
+		else if (entry) {
+			mesh_animate(&entry->mesh, time);
+		}
+	}
+	else if (starts_with_keyword(text, "render")) {
+		parsed = sscanf_s(text, "render %d", &value) == 1;
+		if (parsed) {
+			render_mesh(server, value, reply);
+		}
+	}
+	else if (starts_with_keyword(text, "display_mode")) {
+		parsed = sscanf_s(text, "display_mode %d", &value) == 1 && value >= 1 && value <= POINT_DISPLAY_MODE;
+		if (parsed && value == 5 && !allocate_overdraw_buffer()) {
+			snprintf(reply, SERVER_REPLY_SIZE, "error out of memory");
+		}
+		else if (parsed) {
+			display_mode = value;
+		}
+	}
+	else if (starts_with_keyword(text, "depth_test")) {
+		parsed = sscanf_s(text, "depth_test %d", &value) == 1;
+		if (parsed) {
+			depth_test_enabled = value != 0;
+		}
+	}
+	else if (starts_with_keyword(text, "msaa")) {
+		parsed = sscanf_s(text, "msaa %d", &value) == 1;
+		if (parsed) {
+			msaa_enabled = value != 0 && allocate_msaa_buffers();
+			if (value != 0 && !msaa_enabled) {
+				snprintf(reply, SERVER_REPLY_SIZE, "error out of memory");
+			}
+		}
+	}
+	else if (starts_with_keyword(text, "gamma_correct")) {
+		parsed = sscanf_s(text, "gamma_correct %d", &value) == 1;
+		if (parsed) {
+			light.gamma_correct = value != 0;
+		}
+	}
+	else if (starts_with_keyword(text, "alpha")) {
+		parsed = sscanf_s(text, "alpha %d", &value) == 1 && value >= 0 && value <= 255;
+		if (parsed) {
+			server->alpha = value;
+		}
+	}
+	else if (starts_with_keyword(text, "packed")) {
+		parsed = sscanf_s(text, "packed %d", &value) == 1;
+		if (parsed) {
+			server->packed = value != 0;
+		}
+	}
+	else if (starts_with_keyword(text, "shadows")) {
+		parsed = sscanf_s(text, "shadows %d", &value) == 1;
+		if (parsed) {
+			shadow_map.enabled = value != 0 && shadow_map_init();
+			if (value != 0 && !shadow_map.enabled) {
+				snprintf(reply, SERVER_REPLY_SIZE, "error out of memory");
+			}
+		}
+	}
+	else if (starts_with_keyword(text, "pcf")) {
+		parsed = sscanf_s(text, "pcf %d", &value) == 1;
+		if (parsed) {
+			shadow_map.pcf = value != 0;
+		}
+	}
+	else if (starts_with_keyword(text, "light_direction")) {
+		vec3_t direction;
+		parsed = sscanf_s(text, "light_direction %f %f %f", &direction.x, &direction.y, &direction.z) == 3
+			&& vec3_length(direction) > 0.0f;
+		if (parsed) {
+			vec3_normalize(&direction);
+			light.direction = direction;
+		}
+	}
+	else if (starts_with_keyword(text, "orbit")) {
+		float yaw, pitch, distance;
+		parsed = sscanf_s(text, "orbit %f %f %f", &yaw, &pitch, &distance) == 3;
+		if (parsed) {
+			vec3_t eye = {
+				-distance * sinf(yaw) * cosf(pitch),
+				distance * sinf(pitch),
+				-distance * cosf(yaw) * cosf(pitch)
+			};
+			camera_look_at(&camera, eye, (vec3_t){ 0, 0, 0 });
+		}
+	}
+	else if (starts_with_keyword(text, "look_at")) {
+		vec3_t eye, target;
+		parsed = sscanf_s(text, "look_at %f %f %f %f %f %f", &eye.x, &eye.y, &eye.z, &target.x, &target.y, &target.z) == 6;
+		if (parsed) {
+			camera_look_at(&camera, eye, target);
+		}
+	}
+	else if (starts_with_keyword(text, "quit")) {
+		parsed = true;
+		server->running = false;
+	}
+
+	if (!parsed) {
+		snprintf(reply, SERVER_REPLY_SIZE, "error cannot understand \"%.200s\"", text);
+	}
+}
+
+static bool send_line(socket_t client, const char* text) {
+	char line[SERVER_REPLY_SIZE + 1];
+	int length = snprintf(line, sizeof(line), "%s\n", text);
+	for (int sent = 0; sent < length; ) {
+		int written = (int)send(client, line + sent, length - sent, 0);
+		if (written <= 0) {
+			return false;
+		}
+		sent += (int)written;
+	}
+	return true;
+}
+
+//one client at a time, the next ones wait in the listen backlog
+static void serve_client(render_server_t* server, socket_t client) {
+	char reply[SERVER_REPLY_SIZE];
+	snprintf(reply, sizeof(reply), "ring %s %zu", server->shm_name, server->ring_size);
+	if (!send_line(client, reply)) {
+		return;
+	}
+
+	char buffer[SERVER_LINE_SIZE];
+	int used = 0;
+	while (server->running) {
+		int received = (int)recv(client, buffer + used, (int)sizeof(buffer) - 1 - used, 0);
+		if (received <= 0) {
+			return;
+		}
+		used += (int)received;
+		buffer[used] = '\0';
+
+		//every complete line is a command, a partial one waits for the rest
+		char* line = buffer;
+		char* end;
+		while (server->running && (end = strchr(line, '\n')) != NULL) {
+			*end = '\0';
+			if (end > line && end[-1] == '\r') {
+				end[-1] = '\0';
+			}
+			char* text = skip_spaces(line);
+			if (text[0] != '\0') {
+				handle_command(server, text, reply);
+				if (!send_line(client, reply)) {
+					return;
+				}
+			}
+			line = end + 1;
+		}
+		used -= (int)(line - buffer);
+		memmove(buffer, line, used);
+		if (used == sizeof(buffer) - 1) {
+			send_line(client, "error line too long");
+			return;
+		}
+	}
+}
+
+static socket_t open_socket(const char* socket_path) {
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (strlen(socket_path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "the socket path %s is too long.\n", socket_path);
+		return NO_SOCKET;
+	}
+	memcpy(address.sun_path, socket_path, strlen(socket_path) + 1);
+
+	socket_t listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == NO_SOCKET) {
+		fprintf(stderr, "cannot create a socket.\n");
+		return NO_SOCKET;
+	}
+	//the socket file of an earlier run would make bind fail
+	remove(socket_path);
+	if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 8) != 0) {
+		fprintf(stderr, "cannot listen on %s.\n", socket_path);
+		close_socket(listener);
+		return NO_SOCKET;
+	}
+	return listener;
+}
+
+//headless like a batch job, the settings start out as in load_batch_job
+bool run_render_server(const char* socket_path, int width, int height) {
+	if (width <= 0 || height <= 0) {
+		fprintf(stderr, "the render server resolution has to be positive.\n");
+		return false;
+	}
+
+	render_server_t server = { .vertex_buffers_mesh = -1, .alpha = 255, .running = true };
+	set_output_size(width, height);
+	display_mode = 3;
+	mesh = no_mesh;
+	depth_buffer = (float*)malloc(sizeof(float) * window_width * window_height);
+	setup_projection();
+	if (!depth_buffer) {
+		fprintf(stderr, "Error creating the depth buffer. Probably not enough avaliable memory.\n");
+	}
+
+#ifdef _WIN32
+	WSADATA winsock;
+	bool winsock_started = WSAStartup(MAKEWORD(2, 2), &winsock) == 0;
+	if (!winsock_started) {
+		fprintf(stderr, "cannot start Winsock.\n");
+	}
+	bool ok = winsock_started && depth_buffer && create_ring(&server, width, height);
+#else
+	bool ok = depth_buffer && create_ring(&server, width, height);
+#endif
+	socket_t listener = ok ? open_socket(socket_path) : NO_SOCKET;
+	ok = ok && listener != NO_SOCKET;
+	if (ok) {
+#ifndef _WIN32
+		//a client going away in the middle of a reply must not end the server
+		signal(SIGPIPE, SIG_IGN);
+#endif
+		printf("render server listening on %s, %dx%d frames in %s\n", socket_path, width, height, server.shm_name);
+		fflush(stdout);
+	}
+
+	while (ok && server.running) {
+		socket_t client = accept(listener, NULL, NULL);
+		if (client == NO_SOCKET) {
+			//a signal only interrupts the wait, anything else would fail again right away
+			int error = socket_error();
+			if (error == SOCKET_INTERRUPTED) {
+				continue;
+			}
+			fprintf(stderr, "render server could not accept a client (error %d), stopping.\n", error);
+			ok = false;
+			break;
+		}
+		serve_client(&server, client);
+		close_socket(client);
+	}
+
+	if (listener != NO_SOCKET) {
+		close_socket(listener);
+		remove(socket_path);
+	}
+#ifdef _WIN32
+	if (winsock_started) {
+		WSACleanup();
+	}
+#endif
+	color_buffer = NULL;
+	destroy_ring(&server);
+	int num_meshes = array_length(server.meshes);
+	for (int i = 0; i < num_meshes; i++) {
+		mesh_free(&server.meshes[i].mesh);
+	}
+	array_free(server.meshes);
+	skin_shutdown();
+	point_cloud_shutdown();
+	mesh = no_mesh;
+
+	free(depth_buffer);
+	free(msaa_color_buffer);
+	free(msaa_depth_buffer);
+	free(overdraw_buffer);
+	free(oit_accum_buffer);
+	free(oit_revealage_buffer);
+	depth_buffer = NULL;
+	msaa_color_buffer = NULL;
+	msaa_depth_buffer = NULL;
+	overdraw_buffer = NULL;
+	oit_accum_buffer = NULL;
+	oit_revealage_buffer = NULL;
+	free_vertex_buffers();
+	shadow_map_free();
+	return ok;
+}
@@ -0,0 +1,54 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//render server: a long lived headless renderer driven over a Unix domain socket,
+//3dRenderer --server /tmp/3drenderer.sock [width height]. Windows 10 supports those as well,
+//there the socket path is a file path like C:\Temp\3drenderer.sock
+//
+//every command is one line of text and gets one line back, "ok ..." or "error <reason>":
+//
+//  load <id> <path>                  keeps the .obj resident under the id, replies "ok <faces>"
+//  unload <id>
+//  skin <id> <path>                  animates a loaded mesh with a .skin file, see skin.h.
+//                                    not for meshes loaded while packed is on
+//  pose <id> <time>                  poses a skinned mesh at a time in seconds
+//  display_mode 3                    6 splats the vertices as points, also of vertex only files
+//  depth_test 1
+//  msaa 1
+//  gamma_correct 1
+//  alpha 128                         of every face of the rendered meshes, 0 - 255
+//  shadows 1
+//  pcf 1
+//  light_direction 0.5 -1 1
+//  orbit <yaw> <pitch> <distance>    camera around the origin, like the batch job keys
+//  look_at <eye x y z> <target x y z>
+//  render <id>                       replies "frame <sequence> <slot>"
+//  quit                              stops the server
+//
+//frames never go through the socket. right after connecting the client gets
+//"ring <shared memory name> <size in bytes>" and maps that POSIX shared memory object, on
+//Windows the named file mapping (OpenFileMappingA). it holds a server_ring_header_t
+//followed by SERVER_RING_FRAMES ARGB8888 frames. render writes into
+//slot (sequence - 1) % SERVER_RING_FRAMES, whose fence is 0 while it is being written and
+//the sequence number once the frame is complete. a client reading a slot checks that the
+//fence still holds its sequence afterwards, otherwise the slot was reused in the meantime
+
+#define SERVER_RING_MAGIC 0x52445233 //"3RDR"
+#define SERVER_RING_FRAMES 3
+
+typedef struct {
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t num_frames;
+	uint64_t frame_offset; //bytes from the start of the ring to the first frame
+	uint64_t frame_size; //bytes per frame, the frames follow each other
+	volatile uint32_t fences[SERVER_RING_FRAMES];
+} server_ring_header_t;
+
+bool run_render_server(const char* socket_path, int width, int height);
+
+#endif
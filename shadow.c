@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <SDL.h>
+#include "array.h"
+#include "display.h"
+#include "triangle.h"
+#include "color.h"
+#include "light.h"
+#include "shadow.h"
+
+shadow_map_t shadow_map = {
+	.enabled = false,
+	.pcf = true,
+	.valid = false,
+	.depth = NULL,
+	.bias = 2.0f / SHADOW_MAP_SIZE
+};
+
+//rows of the screen shaded by one job
+#define SHADOW_APPLY_ROWS 32
+
+bool shadow_map_init(void) {
+	if (shadow_map.depth) {
+		return true;
+	}
+	shadow_map.depth = (float*)malloc(sizeof(float) * SHADOW_MAP_SIZE * SHADOW_MAP_SIZE);
+	if (!shadow_map.depth) {
+		fprintf(stderr, "Error creating the shadow map. Probably not enough avaliable memory.\n");
+		return false;
+	}
+	int num_threads = SDL_GetCPUCount();
+	shadow_map.pool = num_threads > 1 ? thread_pool_create(num_threads, "shadow") : NULL;
+	return true;
+}
+
+void shadow_map_free(void) {
+	thread_pool_destroy(shadow_map.pool);
+	free(shadow_map.depth);
+	free(shadow_map.light_vertices);
+	free(shadow_map.light_points);
+	for (int i = 0; i < SHADOW_BANDS; i++) {
+		array_free(shadow_map.band_faces[i]);
+		shadow_map.band_faces[i] = NULL;
+	}
+	shadow_map.pool = NULL;
+	shadow_map.depth = NULL;
+	shadow_map.light_vertices = NULL;
+	shadow_map.light_points = NULL;
+	shadow_map.vertex_capacity = 0;
+	shadow_map.valid = false;
+}
+
+static void run_job(job_function_t function, void* data) {
+	if (shadow_map.pool) {
+		thread_pool_submit(shadow_map.pool, function, data);
+	}
+	else {
+		function(data);
+	}
+}
+
+static void wait_jobs(void) {
+	if (shadow_map.pool) {
+		thread_pool_wait(shadow_map.pool);
+	}
+}
+
+//orthographic projection looking along the light direction, the sphere fills the map
+//and its depth range goes from 0 (towards the light) to 1
+static void light_matrix_setup(mat4_t* res, vec3_t center, float radius) {
+	vec3_t forward = light.direction;
+	vec3_normalize(&forward);
+	vec3_t up = fabsf(forward.y) < 0.99f ? (vec3_t){ 0, 1, 0 } : (vec3_t){ 1, 0, 0 };
+	vec3_t right = vec3_cross(up, forward);
+	vec3_normalize(&right);
+	up = vec3_cross(forward, right);
+
+	float half_size = SHADOW_MAP_SIZE * 0.5f;
+	vec3_t axes[3] = {
+		vec3_mul(right, half_size / radius),
+		vec3_mul(up, -half_size / radius),
+		vec3_mul(forward, 0.5f / radius)
+	};
+	float offsets[3] = { half_size, half_size, 0.5f };
+
+	*res = mat4_identity();
+	for (int row = 0; row < 3; row++) {
+		res->m[row][0] = axes[row].x;
+		res->m[row][1] = axes[row].y;
+		res->m[row][2] = axes[row].z;
+		res->m[row][3] = offsets[row] - vec3_dot(axes[row], center);
+	}
+}
+
+static void render_band_job(void* data) {
+	int band = (int)(intptr_t)data;
+	rect_t clip = rect_make(0, band * SHADOW_BAND_HEIGHT, SHADOW_MAP_SIZE, SHADOW_BAND_HEIGHT);
+
+	for (int y = clip.y0; y < clip.y1; y++) {
+		float* row = shadow_map.depth + SHADOW_MAP_SIZE * y;
+		for (int x = 0; x < SHADOW_MAP_SIZE; x++) {
+			row[x] = 1.0f;
+		}
+	}
+
+	const int* indices = shadow_map.band_faces[band];
+	int num_indices = array_length(shadow_map.band_faces[band]);
+	for (int i = 0; i < num_indices; i += 3) {
+		int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		draw_depth_only_triangle(
+			shadow_map.light_points[a], shadow_map.light_vertices[a].z,
+			shadow_map.light_points[b], shadow_map.light_vertices[b].z,
+			shadow_map.light_points[c], shadow_map.light_vertices[c].z,
+			shadow_map.depth, SHADOW_MAP_SIZE, clip);
+	}
+}
+
+//every face is drawn, faces turned away from the camera or the light still cast shadows.
+//the faces are binned into horizontal bands first, then the bands render in parallel
+void shadow_map_render(const mesh_t* m, const vec4_t* world_vertices, vec3_t world_center, float world_radius) {
+	shadow_map.valid = false;
+	int num_vertices = mesh_vertex_count(m);
+	int num_faces = mesh_face_count(m);
+	if (!shadow_map.depth || world_radius <= 0.0f) {
+		return;
+	}
+
+	if (num_vertices > shadow_map.vertex_capacity) {
+		free(shadow_map.light_vertices);
+		free(shadow_map.light_points);
+		shadow_map.light_vertices = (vec4_t*)malloc(sizeof(vec4_t) * num_vertices);
+		shadow_map.light_points = (vec2_fixed_t*)malloc(sizeof(vec2_fixed_t) * num_vertices);
+		shadow_map.vertex_capacity = num_vertices;
+		if (!shadow_map.light_vertices || !shadow_map.light_points) {
+			fprintf(stderr, "Error creating the shadow vertex buffers. Probably not enough avaliable memory.\n");
+			free(shadow_map.light_vertices);
+			free(shadow_map.light_points);
+			shadow_map.light_vertices = NULL;
+			shadow_map.light_points = NULL;
+			shadow_map.vertex_capacity = 0;
+			return;
+		}
+	}
+
+	light_matrix_setup(&shadow_map.light_matrix, world_center, world_radius);
+	mat4_transform_vec4s(&shadow_map.light_matrix, world_vertices, shadow_map.light_vertices, num_vertices);
+	for (int i = 0; i < num_vertices; i++) {
+		shadow_map.light_points[i] = vec2_fixed_from_floats(shadow_map.light_vertices[i].x, shadow_map.light_vertices[i].y);
+	}
+
+	for (int band = 0; band < SHADOW_BANDS; band++) {
+		array_truncate(shadow_map.band_faces[band], 0);
+	}
+	int cluster = 0;
+	for (int i = 0; i < num_faces; i++) {
+		int indices[3];
+		mesh_face_indices(m, i, &cluster, indices);
+		float min_y = shadow_map.light_vertices[indices[0]].y;
+		float max_y = min_y;
+		for (int j = 1; j < 3; j++) {
+			float y = shadow_map.light_vertices[indices[j]].y;
+			min_y = y < min_y ? y : min_y;
+			max_y = y > max_y ? y : max_y;
+		}
+
+		int first_band = (int)floorf(min_y) / SHADOW_BAND_HEIGHT;
+		int last_band = (int)floorf(max_y) / SHADOW_BAND_HEIGHT;
+		first_band = first_band < 0 ? 0 : first_band;
+		last_band = last_band > SHADOW_BANDS - 1 ? SHADOW_BANDS - 1 : last_band;
+		for (int band = first_band; band <= last_band; band++) {
+			array_push(shadow_map.band_faces[band], indices[0]);
+			array_push(shadow_map.band_faces[band], indices[1]);
+			array_push(shadow_map.band_faces[band], indices[2]);
+		}
+	}
+
+	for (int band = 0; band < SHADOW_BANDS; band++) {
+		run_job(render_band_job, (void*)(intptr_t)band);
+	}
+	wait_jobs();
+	shadow_map.valid = true;
+}
+
+//share of the light reaching a point in shadow map space, 0 - 1
+static float light_visibility(float x, float y, float depth) {
+	int tx = (int)floorf(x);
+	int ty = (int)floorf(y);
+	float reference = depth - shadow_map.bias;
+	if (!shadow_map.pcf) {
+		if (tx < 0 || ty < 0 || tx >= SHADOW_MAP_SIZE || ty >= SHADOW_MAP_SIZE) {
+			return 1.0f;
+		}
+		return reference <= shadow_map.depth[SHADOW_MAP_SIZE * ty + tx] ? 1.0f : 0.0f;
+	}
+
+	int lit = 0;
+	if (tx >= 1 && ty >= 1 && tx < SHADOW_MAP_SIZE - 1 && ty < SHADOW_MAP_SIZE - 1) {
+		//the whole 3x3 block is inside of the map
+		const float* texel = shadow_map.depth + SHADOW_MAP_SIZE * (ty - 1) + tx - 1;
+		for (int dy = 0; dy < 3; dy++) {
+			lit += (reference <= texel[0]) + (reference <= texel[1]) + (reference <= texel[2]);
+			texel += SHADOW_MAP_SIZE;
+		}
+		return lit / 9.0f;
+	}
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			int sx = tx + dx, sy = ty + dy;
+			if (sx < 0 || sy < 0 || sx >= SHADOW_MAP_SIZE || sy >= SHADOW_MAP_SIZE
+				|| reference <= shadow_map.depth[SHADOW_MAP_SIZE * sy + sx]) {
+				lit++;
+			}
+		}
+	}
+	return lit / 9.0f;
+}
+
+typedef struct {
+	rect_t rows;
+	mat4_t screen_to_shadow;
+	const float* depths;
+	int depth_stride;
+} shadow_apply_t;
+
+//depth at the pixel center. the multisample points are symmetric around the center, so
+//on a fully covered pixel their mean is exactly that. partly covered edge pixels take
+//the first covered sample
+static float pixel_depth(const float* samples, int num_samples) {
+	float sum = 0.0f;
+	for (int s = 0; s < num_samples; s++) {
+		if (samples[s] >= 1.0f) {
+			for (s = 0; s < num_samples; s++) {
+				if (samples[s] < 1.0f) {
+					return samples[s];
+				}
+			}
+			return 1.0f;
+		}
+		sum += samples[s];
+	}
+	return sum / num_samples;
+}
+
+static void apply_rows_job(void* data) {
+	shadow_apply_t* job = (shadow_apply_t*)data;
+	const mat4_t* m = &job->screen_to_shadow;
+	for (int y = job->rows.y0; y < job->rows.y1; y++) {
+		uint32_t* pixels = color_buffer + window_width * y;
+		const float* depth_row = job->depths + (size_t)window_width * y * job->depth_stride;
+		float py = y + 0.5f;
+		for (int x = job->rows.x0; x < job->rows.x1; x++) {
+			float z = pixel_depth(depth_row + x * job->depth_stride, job->depth_stride);
+			if (z >= 1.0f) {
+				continue; //nothing drawn here
+			}
+			float px = x + 0.5f;
+			float inverse_w = 1.0f / (m->m[3][0] * px + m->m[3][1] * py + m->m[3][2] * z + m->m[3][3]);
+			float sx = (m->m[0][0] * px + m->m[0][1] * py + m->m[0][2] * z + m->m[0][3]) * inverse_w;
+			float sy = (m->m[1][0] * px + m->m[1][1] * py + m->m[1][2] * z + m->m[1][3]) * inverse_w;
+			float sz = (m->m[2][0] * px + m->m[2][1] * py + m->m[2][2] * z + m->m[2][3]) * inverse_w;
+
+			float visibility = light_visibility(sx, sy, sz);
+			if (visibility < 1.0f) {
+				pixels[x] = color_mix(0xFF000000, pixels[x], (uint32_t)(visibility * 256.0f));
+			}
+		}
+	}
+}
+
+//shading pass over the opaque pixels of area: every pixel gets its world position back from
+//its depth, is looked up in the shadow map and loses the share of the light that is blocked.
+//depths is the z / w buffer of the frame, depth_stride floats apart per pixel
+void shadow_map_apply_rect(rect_t area, const mat4_t* view_projection, const float* depths, int depth_stride) {
+	area = rect_intersect(area, rect_make(0, 0, window_width, window_height));
+	if (!shadow_map.valid || rect_is_empty(area)) {
+		return;
+	}
+
+	mat4_t inverse_view_projection;
+	if (!mat4_inverse(&inverse_view_projection, view_projection)) {
+		return;
+	}
+	//pixel coordinates back to normalized device coordinates, the inverse of the viewport transform
+	mat4_t inverse_viewport = mat4_identity();
+	inverse_viewport.m[0][0] = 2.0f / window_width;
+	inverse_viewport.m[0][3] = -1.0f;
+	inverse_viewport.m[1][1] = -2.0f / window_height;
+	inverse_viewport.m[1][3] = 1.0f;
+
+	mat4_t screen_to_world = mat4_mul_mat4(inverse_view_projection, inverse_viewport);
+	mat4_t screen_to_shadow = mat4_mul_mat4(shadow_map.light_matrix, screen_to_world);
+
+	int num_jobs = (area.y1 - area.y0 + SHADOW_APPLY_ROWS - 1) / SHADOW_APPLY_ROWS;
+	shadow_apply_t* jobs = (shadow_apply_t*)malloc(sizeof(shadow_apply_t) * num_jobs);
+	if (!jobs) {
+		fprintf(stderr, "Error creating the shadow jobs. Probably not enough avaliable memory.\n");
+		return;
+	}
+	for (int i = 0; i < num_jobs; i++) {
+		int y0 = area.y0 + i * SHADOW_APPLY_ROWS;
+		int y1 = y0 + SHADOW_APPLY_ROWS < area.y1 ? y0 + SHADOW_APPLY_ROWS : area.y1;
+		jobs[i].rows = rect_make(area.x0, y0, area.x1 - area.x0, y1 - y0);
+		jobs[i].screen_to_shadow = screen_to_shadow;
+		jobs[i].depths = depths;
+		jobs[i].depth_stride = depth_stride;
+		run_job(apply_rows_job, &jobs[i]);
+	}
+	wait_jobs();
+	free(jobs);
+}
@@ -0,0 +1,41 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <stdbool.h>
+#include "vector.h"
+#include "matrix.h"
+#include "rect.h"
+#include "fixed.h"
+#include "mesh.h"
+#include "thread_pool.h"
+
+#define SHADOW_MAP_SIZE 1024
+//rows of the shadow map rendered by one job
+#define SHADOW_BAND_HEIGHT 64
+#define SHADOW_BANDS (SHADOW_MAP_SIZE / SHADOW_BAND_HEIGHT)
+
+//depth of the mesh as seen from the directional light, through an orthographic
+//projection fitted around the bounding sphere of the mesh
+typedef struct {
+	bool enabled;
+	bool pcf; //3x3 percentage closer filtering instead of a single comparison
+	bool valid; //rendered for the current frame
+	float* depth; //SHADOW_MAP_SIZE * SHADOW_MAP_SIZE, 0 closest to the light
+	mat4_t light_matrix; //world space to shadow map pixels (x, y) and depth (z)
+	float bias;
+
+	vec4_t* light_vertices; //per mesh vertex, in shadow map space
+	vec2_fixed_t* light_points;
+	int vertex_capacity;
+	int* band_faces[SHADOW_BANDS]; //dynamic arrays of the faces reaching into each band
+	thread_pool_t* pool;
+} shadow_map_t;
+
+extern shadow_map_t shadow_map;
+
+bool shadow_map_init(void);
+void shadow_map_render(const mesh_t* m, const vec4_t* world_vertices, vec3_t world_center, float world_radius);
+void shadow_map_apply_rect(rect_t area, const mat4_t* view_projection, const float* depths, int depth_stride);
+void shadow_map_free(void);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+//SSE2 is always there on x64 and can be assumed on x86 builds with /arch:SSE2,
+//everything built on top of it keeps a plain C version for other targets
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define USE_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#define RESTRICT __restrict
+#define ALIGN16 __declspec(align(16))
+#define FORCE_INLINE __forceinline
+#else
+#define RESTRICT restrict
+#define ALIGN16 __attribute__((aligned(16)))
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+//generic code paths are written once as a FORCE_INLINE function taking constant flags,
+//every specialization calling it gets compiled without the branches its flags rule out
+
+#endif
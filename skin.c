@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include "array.h"
+#include "skin.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+//vertices skinned by one job, smaller meshes are skinned on the calling thread
+#define SKIN_JOB_VERTICES 4096
+
+typedef struct {
+	const skin_t* skin;
+	const vec3_t* vertices;
+	vec4_t* out;
+	int first;
+	int end;
+} skin_job_t;
+
+//shared by every skinned mesh, created with the first one large enough to split
+static thread_pool_t* skin_pool = NULL;
+static int skin_pool_threads = 0;
+static skin_job_t* skin_jobs = NULL;
+
+typedef struct {
+	int joint;
+	skin_key_t key;
+} skin_file_key_t;
+
+static char* skip_spaces(char* text) {
+	while (*text == ' ' || *text == '\t') {
+		text++;
+	}
+	return text;
+}
+
+static bool starts_with_keyword(const char* line, const char* keyword) {
+	size_t length = strlen(keyword);
+	return strncmp(line, keyword, length) == 0 && (line[length] == ' ' || line[length] == '\t');
+}
+
+//up to SKIN_MAX_INFLUENCES pairs, the strongest first so skinning can stop at the first 0
+static bool parse_weights(const char* text, int num_vertices, skin_weights_t* weights) {
+	int vertex;
+	int joints[SKIN_MAX_INFLUENCES] = { 0 };
+	float values[SKIN_MAX_INFLUENCES] = { 0 };
+	int count = sscanf_s(text, "weight %d %d %f %d %f %d %f %d %f", &vertex,
+		&joints[0], &values[0], &joints[1], &values[1], &joints[2], &values[2], &joints[3], &values[3]);
+	int pairs = (count - 1) / 2;
+	if (count < 3 || vertex < 1 || vertex > num_vertices) {
+		return false;
+	}
+
+	skin_weights_t w = { { 0 }, { 0 } };
+	float sum = 0;
+	for (int i = 0; i < pairs; i++) {
+		if (joints[i] < 0 || joints[i] >= SKIN_MAX_JOINTS || values[i] < 0) {
+			return false;
+		}
+		int at = i;
+		while (at > 0 && w.weights[at - 1] < values[i]) {
+			w.joints[at] = w.joints[at - 1];
+			w.weights[at] = w.weights[at - 1];
+			at--;
+		}
+		w.joints[at] = (uint8_t)joints[i];
+		w.weights[at] = values[i];
+		sum += values[i];
+	}
+	if (sum <= 0) {
+		return false;
+	}
+	for (int i = 0; i < pairs; i++) {
+		w.weights[i] /= sum;
+	}
+	weights[vertex - 1] = w;
+	return true;
+}
+
+//bind pose matrices, sorted keys and the bounds each joint can move
+static bool skin_prepare(skin_t* skin, skin_file_key_t* file_keys, const vec3_t* vertices) {
+	int num_joints = array_length(skin->joints);
+	mat4_t* bind = (mat4_t*)malloc(sizeof(mat4_t) * num_joints);
+	skin->inverse_bind = (mat4_t*)malloc(sizeof(mat4_t) * num_joints);
+	skin->joint_bounds = (vec4_t*)malloc(sizeof(vec4_t) * num_joints);
+	skin->keys = (skin_key_t**)calloc(num_joints, sizeof(skin_key_t*));
+	skin->palette = (mat4_t*)malloc(sizeof(mat4_t) * num_joints);
+	skin->world_palette = (mat4_t*)malloc(sizeof(mat4_t) * num_joints);
+	if (!bind || !skin->inverse_bind || !skin->joint_bounds || !skin->keys || !skin->palette || !skin->world_palette) {
+		fprintf(stderr, "Error creating the skin. Probably not enough avaliable memory.\n");
+		free(bind);
+		return false;
+	}
+
+	for (int j = 0; j < num_joints; j++) {
+		skin_joint_t joint = skin->joints[j];
+		mat4_t local;
+		mat4_make_trs_quat(&local, (vec3_t){ 1, 1, 1 }, joint.rotation, joint.translation);
+		if (joint.parent >= 0) {
+			mat4_mul_mat4_affine(&bind[j], &bind[joint.parent], &local);
+		}
+		else {
+			bind[j] = local;
+		}
+		mat4_inverse_affine(&skin->inverse_bind[j], &bind[j]);
+		//radius -1 until a vertex following the joint is found
+		skin->joint_bounds[j] = (vec4_t){ bind[j].m[0][3], bind[j].m[1][3], bind[j].m[2][3], -1.0f };
+	}
+	free(bind);
+
+	for (int i = 0; i < skin->num_vertices; i++) {
+		skin_weights_t w = skin->weights[i];
+		for (int k = 0; k < SKIN_MAX_INFLUENCES && w.weights[k] > 0; k++) {
+			vec4_t* bounds = &skin->joint_bounds[w.joints[k]];
+			float distance = vec3_length(vec3_sub(vertices[i], vec3_from_vec4(*bounds)));
+			if (distance > bounds->w) {
+				bounds->w = distance;
+			}
+		}
+	}
+
+	int num_keys = array_length(file_keys);
+	for (int i = 0; i < num_keys; i++) {
+		skin_key_t** keys = &skin->keys[file_keys[i].joint];
+		array_push(*keys, file_keys[i].key);
+		for (int k = array_length(*keys) - 1; k > 0 && (*keys)[k - 1].time > (*keys)[k].time; k--) {
+			skin_key_t temp = (*keys)[k];
+			(*keys)[k] = (*keys)[k - 1];
+			(*keys)[k - 1] = temp;
+		}
+		if (file_keys[i].key.time > skin->duration) {
+			skin->duration = file_keys[i].key.time;
+		}
+	}
+	return true;
+}
+
+skin_t* skin_load(const char* filename, const vec3_t* vertices, int num_vertices) {
+	FILE* file;
+	char line[512];
+	if (fopen_s(&file, filename, "r") != 0) {
+		fprintf(stderr, "cannot open skin file %s.\n", filename);
+		return NULL;
+	}
+
+	skin_t* skin = (skin_t*)calloc(1, sizeof(skin_t));
+	skin_weights_t* weights = (skin_weights_t*)malloc(sizeof(skin_weights_t) * (num_vertices > 0 ? num_vertices : 1));
+	if (!skin || !weights) {
+		fprintf(stderr, "Error creating the skin. Probably not enough avaliable memory.\n");
+		fclose(file);
+		free(skin);
+		free(weights);
+		return NULL;
+	}
+	skin_weights_t rigid = { { 0 }, { 1.0f } };
+	for (int i = 0; i < num_vertices; i++) {
+		weights[i] = rigid;
+	}
+	skin->weights = weights;
+	skin->num_vertices = num_vertices;
+
+	skin_file_key_t* file_keys = NULL;
+	int line_number = 0;
+	bool valid = true;
+	while (valid && fgets(line, sizeof(line), file)) {
+		line_number++;
+		size_t length = strlen(line);
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t')) {
+			line[--length] = '\0';
+		}
+		char* text = skip_spaces(line);
+		if (text[0] == '\0' || text[0] == '#') {
+			continue;
+		}
+
+		int parsed = 0;
+		if (starts_with_keyword(text, "joint")) {
+			skin_joint_t joint;
+			parsed = sscanf_s(text, "joint %d %f %f %f %f %f %f %f", &joint.parent,
+				&joint.translation.x, &joint.translation.y, &joint.translation.z,
+				&joint.rotation.x, &joint.rotation.y, &joint.rotation.z, &joint.rotation.w) == 8
+				&& joint.parent < array_length(skin->joints) && array_length(skin->joints) < SKIN_MAX_JOINTS;
+			if (parsed) {
+				quat_normalize(&joint.rotation);
+				array_push(skin->joints, joint);
+			}
+		}
+		else if (starts_with_keyword(text, "weight")) {
+			parsed = parse_weights(text, num_vertices, weights);
+		}
+		else if (starts_with_keyword(text, "key")) {
+			skin_file_key_t k;
+			parsed = sscanf_s(text, "key %d %f %f %f %f %f %f %f %f", &k.joint, &k.key.time,
+				&k.key.translation.x, &k.key.translation.y, &k.key.translation.z,
+				&k.key.rotation.x, &k.key.rotation.y, &k.key.rotation.z, &k.key.rotation.w) == 9
+				&& k.joint >= 0 && k.key.time >= 0;
+			if (parsed) {
+				quat_normalize(&k.key.rotation);
+				array_push(file_keys, k);
+			}
+		}
+
+		if (!parsed) {
+			fprintf(stderr, "%s:%d: cannot understand \"%s\".\n", filename, line_number, text);
+			valid = false;
+		}
+	}
+	fclose(file);
+
+	//joints can be named by weights and keys before they are declared
+	int num_joints = array_length(skin->joints);
+	for (int i = 0; valid && i < num_vertices; i++) {
+		for (int k = 0; k < SKIN_MAX_INFLUENCES && weights[i].weights[k] > 0; k++) {
+			valid = weights[i].joints[k] < num_joints;
+		}
+	}
+	for (int i = 0; valid && i < array_length(file_keys); i++) {
+		valid = file_keys[i].joint < num_joints;
+	}
+	if (!valid || num_joints == 0) {
+		fprintf(stderr, "%s: every weight and key needs a joint, and the skin at least one.\n", filename);
+		valid = false;
+	}
+
+	valid = valid && skin_prepare(skin, file_keys, vertices);
+	array_free(file_keys);
+	if (!valid) {
+		skin_free(skin);
+		return NULL;
+	}
+	return skin;
+}
+
+void skin_free(skin_t* skin) {
+	if (!skin) {
+		return;
+	}
+	int num_joints = array_length(skin->joints);
+	for (int j = 0; skin->keys && j < num_joints; j++) {
+		array_free(skin->keys[j]);
+	}
+	array_free(skin->joints);
+	free(skin->keys);
+	free(skin->inverse_bind);
+	free(skin->joint_bounds);
+	free(skin->weights);
+	free(skin->palette);
+	free(skin->world_palette);
+	free(skin);
+}
+
+static void sample_keys(const skin_key_t* keys, float time, vec3_t* translation, quat_t* rotation) {
+	int num_keys = array_length((void*)keys);
+	if (time <= keys[0].time) {
+		*translation = keys[0].translation;
+		*rotation = keys[0].rotation;
+		return;
+	}
+	for (int i = 1; i < num_keys; i++) {
+		if (time < keys[i].time) {
+			const skin_key_t* k0 = &keys[i - 1];
+			const skin_key_t* k1 = &keys[i];
+			float t = (time - k0->time) / (k1->time - k0->time);
+			*translation = vec3_add(k0->translation, vec3_mul(vec3_sub(k1->translation, k0->translation), t));
+			*rotation = quat_slerp(k0->rotation, k1->rotation, t);
+			return;
+		}
+	}
+	*translation = keys[num_keys - 1].translation;
+	*rotation = keys[num_keys - 1].rotation;
+}
+
+//the joint palette for a point in time, once per frame and not per vertex. joints are rigid,
+//so every vertex stays inside the moved sphere of each joint it follows, and the blended
+//position inside of a sphere around all of them: that one becomes the mesh bounds
+void skin_evaluate(skin_t* skin, float time, vec3_t* bounds_center, float* bounds_radius) {
+	int num_joints = array_length(skin->joints);
+	if (skin->duration > 0) {
+		time = fmodf(time, skin->duration);
+		if (time < 0) {
+			time += skin->duration;
+		}
+	}
+
+	//model space pose of every joint, parents are always done before their children
+	for (int j = 0; j < num_joints; j++) {
+		skin_joint_t joint = skin->joints[j];
+		vec3_t translation = joint.translation;
+		quat_t rotation = joint.rotation;
+		if (skin->keys[j]) {
+			sample_keys(skin->keys[j], time, &translation, &rotation);
+		}
+		mat4_t local;
+		mat4_make_trs_quat(&local, (vec3_t){ 1, 1, 1 }, rotation, translation);
+		if (joint.parent >= 0) {
+			mat4_mul_mat4_affine(&skin->palette[j], &skin->palette[joint.parent], &local);
+		}
+		else {
+			skin->palette[j] = local;
+		}
+	}
+
+	vec3_t center = { 0, 0, 0 };
+	int num_bounded = 0;
+	for (int j = 0; j < num_joints; j++) {
+		mat4_t pose = skin->palette[j];
+		mat4_mul_mat4_affine(&skin->palette[j], &pose, &skin->inverse_bind[j]);
+		vec4_t bounds = skin->joint_bounds[j];
+		if (bounds.w >= 0) {
+			center = vec3_add(center, vec3_from_vec4(mat4_mul_vec4(skin->palette[j], (vec4_t){ bounds.x, bounds.y, bounds.z, 1.0f })));
+			num_bounded++;
+		}
+	}
+	if (num_bounded == 0) {
+		return;
+	}
+	center = vec3_mul(center, 1.0f / num_bounded);
+
+	float radius = 0;
+	for (int j = 0; j < num_joints; j++) {
+		vec4_t bounds = skin->joint_bounds[j];
+		if (bounds.w >= 0) {
+			vec4_t moved = mat4_mul_vec4(skin->palette[j], (vec4_t){ bounds.x, bounds.y, bounds.z, 1.0f });
+			float reach = vec3_length(vec3_sub(vec3_from_vec4(moved), center)) + bounds.w;
+			if (reach > radius) {
+				radius = reach;
+			}
+		}
+	}
+	*bounds_center = center;
+	*bounds_radius = radius;
+}
+
+//linear blend skinning fused with the world transform: every vertex is read once, moved by
+//the weighted sum of its joints' world * palette matrices and written once.
+//world_palette is stored transposed, so every column of a matrix loads as one vector
+static void skin_vertices(const skin_t* skin, const vec3_t* RESTRICT vertices, vec4_t* RESTRICT out, int first, int end) {
+	const mat4_t* palette = skin->world_palette;
+	const skin_weights_t* weights = skin->weights;
+	for (int i = first; i < end; i++) {
+		const skin_weights_t* w = &weights[i];
+#if USE_SSE2
+		__m128 x = _mm_set1_ps(vertices[i].x);
+		__m128 y = _mm_set1_ps(vertices[i].y);
+		__m128 z = _mm_set1_ps(vertices[i].z);
+		__m128 result = _mm_setzero_ps();
+		for (int k = 0; k < SKIN_MAX_INFLUENCES && w->weights[k] > 0; k++) {
+			const mat4_t* m = &palette[w->joints[k]];
+			__m128 moved = _mm_add_ps(_mm_loadu_ps(m->m[3]), _mm_mul_ps(_mm_loadu_ps(m->m[0]), x));
+			moved = _mm_add_ps(moved, _mm_mul_ps(_mm_loadu_ps(m->m[1]), y));
+			moved = _mm_add_ps(moved, _mm_mul_ps(_mm_loadu_ps(m->m[2]), z));
+			result = _mm_add_ps(result, _mm_mul_ps(moved, _mm_set1_ps(w->weights[k])));
+		}
+		_mm_storeu_ps(&out[i].x, result);
+#else
+		vec3_t v = vertices[i];
+		vec4_t result = { 0, 0, 0, 0 };
+		for (int k = 0; k < SKIN_MAX_INFLUENCES && w->weights[k] > 0; k++) {
+			const float(*m)[4] = palette[w->joints[k]].m;
+			float weight = w->weights[k];
+			result.x += (m[3][0] + m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z) * weight;
+			result.y += (m[3][1] + m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z) * weight;
+			result.z += (m[3][2] + m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z) * weight;
+			result.w += (m[3][3] + m[0][3] * v.x + m[1][3] * v.y + m[2][3] * v.z) * weight;
+		}
+		out[i] = result;
+#endif
+	}
+}
+
+static void skin_job(void* data) {
+	skin_job_t* job = (skin_job_t*)data;
+	skin_vertices(job->skin, job->vertices, job->out, job->first, job->end);
+}
+
+//world space positions of every vertex of the mesh in its current pose, w is 1
+void skin_transform(skin_t* skin, const mat4_t* world, const vec3_t* vertices, vec4_t* out) {
+	int num_joints = array_length(skin->joints);
+	for (int j = 0; j < num_joints; j++) {
+		mat4_t m;
+		mat4_mul_mat4_affine(&m, world, &skin->palette[j]);
+		for (int row = 0; row < 4; row++) {
+			for (int col = 0; col < 4; col++) {
+				skin->world_palette[j].m[col][row] = m.m[row][col];
+			}
+		}
+	}
+
+	int count = skin->num_vertices;
+	if (count >= SKIN_JOB_VERTICES * 2 && !skin_pool && skin_pool_threads == 0) {
+		skin_pool_threads = SDL_GetCPUCount();
+		skin_pool = skin_pool_threads > 1 ? thread_pool_create(skin_pool_threads, "skinning") : NULL;
+	}
+	if (!skin_pool || count < SKIN_JOB_VERTICES * 2) {
+		skin_vertices(skin, vertices, out, 0, count);
+		return;
+	}
+
+	//a few jobs per thread so a thread that gets descheduled does not hold up the frame
+	int per_job = (count + skin_pool_threads * 2 - 1) / (skin_pool_threads * 2);
+	if (per_job < SKIN_JOB_VERTICES) {
+		per_job = SKIN_JOB_VERTICES;
+	}
+	int num_jobs = (count + per_job - 1) / per_job;
+	array_truncate(skin_jobs, 0);
+	for (int i = 0; i < num_jobs; i++) {
+		skin_job_t job = { skin, vertices, out, i * per_job, (i + 1) * per_job < count ? (i + 1) * per_job : count };
+		array_push(skin_jobs, job);
+	}
+	//the array is complete before the first job runs, pushing could move it
+	for (int i = 0; i < num_jobs; i++) {
+		thread_pool_submit(skin_pool, skin_job, &skin_jobs[i]);
+	}
+	thread_pool_wait(skin_pool);
+}
+
+void skin_shutdown(void) {
+	thread_pool_destroy(skin_pool);
+	array_free(skin_jobs);
+	skin_pool = NULL;
+	skin_jobs = NULL;
+	skin_pool_threads = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef SKIN_H
+#define SKIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vector.h"
+#include "matrix.h"
+
+//skeletal animation of a mesh. a .skin file next to the .obj has one entry per line:
+//
+//  joint <parent> <x y z> <qx qy qz qw>      bind pose of the joint relative to its parent,
+//                                            parents come first, -1 for the root
+//  weight <vertex> <joint> <weight> ...      up to SKIN_MAX_INFLUENCES joint / weight pairs,
+//                                            vertices are 1 based like in the .obj
+//  key <joint> <time> <x y z> <qx qy qz qw>  pose of the joint at a time in seconds
+//
+//vertices without a weight line follow joint 0. the animation loops over the last key time
+
+#define SKIN_MAX_INFLUENCES 4
+#define SKIN_MAX_JOINTS 256
+
+typedef struct {
+	int parent;
+	vec3_t translation;
+	quat_t rotation;
+} skin_joint_t;
+
+typedef struct {
+	float time;
+	vec3_t translation;
+	quat_t rotation;
+} skin_key_t;
+
+typedef struct {
+	uint8_t joints[SKIN_MAX_INFLUENCES];
+	float weights[SKIN_MAX_INFLUENCES]; //sum to 1, unused ones are 0
+} skin_weights_t;
+
+typedef struct {
+	skin_joint_t* joints; //dynamic array
+	mat4_t* inverse_bind; //model space to joint space in the bind pose, per joint
+	vec4_t* joint_bounds; //bind pose sphere around the vertices each joint moves, radius in w
+	skin_key_t** keys; //per joint, dynamic arrays sorted by time
+	float duration;
+	skin_weights_t* weights; //per mesh vertex
+	int num_vertices;
+
+	mat4_t* palette; //model space skinning matrix per joint, from skin_evaluate
+	mat4_t* world_palette; //world * palette, per frame scratch space of skin_transform
+} skin_t;
+
+skin_t* skin_load(const char* filename, const vec3_t* vertices, int num_vertices);
+void skin_free(skin_t* skin);
+void skin_evaluate(skin_t* skin, float time, vec3_t* bounds_center, float* bounds_radius);
+void skin_transform(skin_t* skin, const mat4_t* world, const vec3_t* vertices, vec4_t* out);
+void skin_shutdown(void);
+
+#endif
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <SDL.h>
+#include "display.h"
+#include "temporal.h"
+#include "simd.h"
+
+temporal_t temporal = {
+	.enabled = false,
+	.phase = 0,
+	.checkerboard = false,
+	.history_valid = false,
+	.history_color = NULL,
+	.history_depth = NULL
+};
+
+//pixels the history buffers were allocated for
+static int history_capacity = 0;
+
+bool temporal_init(void) {
+	if (temporal.history_color) {
+		return true;
+	}
+	temporal.history_color = (uint32_t*)malloc(sizeof(uint32_t) * output_width * output_height);
+	temporal.history_depth = (float*)malloc(sizeof(float) * output_width * output_height);
+	if (!temporal.history_color || !temporal.history_depth) {
+		fprintf(stderr, "Error creating the temporal history buffers. Probably not enough avaliable memory.\n");
+		free(temporal.history_color);
+		free(temporal.history_depth);
+		temporal.history_color = NULL;
+		temporal.history_depth = NULL;
+		return false;
+	}
+	history_capacity = output_width * output_height;
+	int num_threads = SDL_GetCPUCount();
+	temporal.pool = num_threads > 1 ? thread_pool_create(num_threads, "temporal") : NULL;
+	temporal.history_valid = false;
+	return true;
+}
+
+void temporal_free(void) {
+	thread_pool_destroy(temporal.pool);
+	free(temporal.history_color);
+	free(temporal.history_depth);
+	temporal.pool = NULL;
+	temporal.history_color = NULL;
+	temporal.history_depth = NULL;
+	temporal.history_valid = false;
+	temporal.checkerboard = false;
+	history_capacity = 0;
+}
+
+//a frame that is not rendered in temporal mode leaves nothing to reproject from
+void temporal_reset(void) {
+	temporal.history_valid = false;
+	temporal.checkerboard = false;
+}
+
+//the frame renders into the buffers of the one before the last, so the last one stays
+//untouched as the history. only half of the pixels get rasterized when that history is
+//complete and matches the current size, a frame returning false renders every pixel
+bool temporal_begin_frame(const mat4_t* object_to_screen) {
+	if (output_width * output_height != history_capacity) {
+		temporal_reset();
+		return false;
+	}
+	uint32_t* color = color_buffer;
+	color_buffer = temporal.history_color;
+	temporal.history_color = color;
+	float* depth = depth_buffer;
+	depth_buffer = temporal.history_depth;
+	temporal.history_depth = depth;
+
+	temporal.object_to_screen = *object_to_screen;
+	temporal.checkerboard = temporal.history_valid
+		&& temporal.history_width == window_width
+		&& temporal.history_height == window_height;
+	if (temporal.checkerboard) {
+		temporal.phase ^= 1;
+	}
+	return temporal.checkerboard;
+}
+
+typedef struct {
+	int y0, y1;
+	rect_t area;
+	mat4_t screen_to_history;
+} temporal_job_t;
+
+//the last frame as the reconstruction reads it, kept in locals so that the pixel writes
+//do not force the compiler to load it from temporal again for every pixel
+typedef struct {
+	const uint32_t* color;
+	const float* depth;
+	rect_t rect;
+	bool checkerboard;
+	int phase;
+} history_view_t;
+
+//color of the last frame at a reprojected position, if that is still the same surface.
+//only pixels the last frame rasterized are taken, its reconstructed ones would carry
+//their colors on from frame to frame and drift further from the shading every time
+static FORCE_INLINE bool sample_history(const history_view_t* h, float x, float y, float z, uint32_t* color) {
+	rect_t r = h->rect;
+	if (!(x >= r.x0 && x < r.x1 && y >= r.y0 && y < r.y1 && z < 1.0f)) {
+		return false;
+	}
+	int ix = (int)x, iy = (int)y;
+	if (h->checkerboard && ((ix + iy + h->phase) & 1) != 0) {
+		//the closest rasterized pixel is the neighbor towards the position
+		float fx = x - ix - 0.5f, fy = y - iy - 0.5f;
+		bool horizontal = fabsf(fx) > fabsf(fy);
+		ix += horizontal ? (fx > 0.0f ? 1 : -1) : 0;
+		iy += horizontal ? 0 : (fy > 0.0f ? 1 : -1);
+		if (ix < r.x0 || ix >= r.x1 || iy < r.y0 || iy >= r.y1) {
+			return false;
+		}
+	}
+	int index = window_width * iy + ix;
+	//z / w is 1 - near / distance close enough, so 1 - z scales the tolerance with the distance
+	if (fabsf(h->depth[index] - z) > TEMPORAL_DEPTH_TOLERANCE * (1.0f - z)) {
+		return false;
+	}
+	*color = h->color[index];
+	return true;
+}
+
+//fminf is a library call without fast math, depths are never NaN
+static FORCE_INLINE float closest(float a, float b) {
+	return a < b ? a : b;
+}
+
+//rounded mean of four colors, two channels at a time
+static FORCE_INLINE uint32_t average_colors(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+	uint32_t low = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+	uint32_t high = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF) + ((d >> 8) & 0x00FF00FF) + 0x00020002;
+	return ((low >> 2) & 0x00FF00FF) | (((high >> 2) & 0x00FF00FF) << 8);
+}
+
+//fills the pixels that were not rasterized, their four neighbors all were (on the border
+//of the area the one across stands in for the missing one). where the neighbors differ,
+//the closest neighbor depth places the pixel in the scene and it is reprojected into the
+//last frame. when that lands on a different surface (disocclusion), on the empty screen or
+//off screen, the neighbors are averaged instead
+static void reconstruct_rows_job(void* data) {
+	temporal_job_t* job = (temporal_job_t*)data;
+	const mat4_t m = job->screen_to_history;
+	const rect_t area = job->area;
+	const history_view_t history = {
+		temporal.history_color, temporal.history_depth, temporal.history_rect,
+		temporal.history_checkerboard, temporal.history_phase
+	};
+	const int phase = temporal.phase;
+	const int stride = window_width;
+
+	for (int y = job->y0; y < job->y1; y++) {
+		uint32_t* pixels = color_buffer + stride * y;
+		float* depths = depth_buffer + stride * y;
+		int up = y > area.y0 ? -stride : (y + 1 < area.y1 ? stride : 0);
+		int down = y + 1 < area.y1 ? stride : (y > area.y0 ? -stride : 0);
+
+		//the parts of the reprojection that do not change along the row
+		float py = y + 0.5f;
+		float row_x = m.m[0][1] * py + m.m[0][3];
+		float row_y = m.m[1][1] * py + m.m[1][3];
+		float row_z = m.m[2][1] * py + m.m[2][3];
+		float row_w = m.m[3][1] * py + m.m[3][3];
+
+		for (int x = area.x0 + ((area.x0 + y + phase + 1) & 1); x < area.x1; x += 2) {
+			int left = x > area.x0 ? -1 : (x + 1 < area.x1 ? 1 : 0);
+			int right = x + 1 < area.x1 ? 1 : (x > area.x0 ? -1 : 0);
+			float z = closest(closest(depths[x + left], depths[x + right]), closest(depths[x + up], depths[x + down]));
+			if (z >= 1.0f) {
+				continue; //empty screen around it, it stays cleared
+			}
+
+			//inside of a face all four neighbors agree, faces are flat shaded so that is exact
+			uint32_t left_color = pixels[x + left];
+			if (pixels[x + right] == left_color && pixels[x + up] == left_color && pixels[x + down] == left_color) {
+				pixels[x] = left_color;
+				depths[x] = z;
+				continue;
+			}
+
+			//edges and silhouettes are taken from the last frame
+			float px = x + 0.5f;
+			float w = m.m[3][0] * px + m.m[3][2] * z + row_w;
+			uint32_t color;
+			bool reprojected = false;
+			if (w > 0.0f) {
+				float inverse_w = 1.0f / w;
+				float hx = (m.m[0][0] * px + m.m[0][2] * z + row_x) * inverse_w;
+				float hy = (m.m[1][0] * px + m.m[1][2] * z + row_y) * inverse_w;
+				float hz = (m.m[2][0] * px + m.m[2][2] * z + row_z) * inverse_w;
+				reprojected = sample_history(&history, hx, hy, hz, &color);
+			}
+			if (!reprojected) {
+				color = average_colors(left_color, pixels[x + right], pixels[x + up], pixels[x + down]);
+			}
+			pixels[x] = color;
+			//the next frame validates its reprojection against this depth
+			depths[x] = z;
+		}
+	}
+}
+
+static void reconstruct_rect(rect_t area) {
+	//from this frame's pixels back to model space and into the last frame's pixels. the
+	//mesh is the only thing on screen, so its own motion is followed along with the camera
+	mat4_t screen_to_object;
+	if (!mat4_inverse(&screen_to_object, &temporal.object_to_screen)) {
+		return;
+	}
+	mat4_t screen_to_history = mat4_mul_mat4(temporal.history_object_to_screen, screen_to_object);
+
+	int num_jobs = (area.y1 - area.y0 + TEMPORAL_BAND_HEIGHT - 1) / TEMPORAL_BAND_HEIGHT;
+	temporal_job_t* jobs = (temporal_job_t*)malloc(sizeof(temporal_job_t) * num_jobs);
+	if (!jobs) {
+		fprintf(stderr, "Error creating the temporal jobs. Probably not enough avaliable memory.\n");
+		return;
+	}
+	for (int i = 0; i < num_jobs; i++) {
+		jobs[i].y0 = area.y0 + i * TEMPORAL_BAND_HEIGHT;
+		jobs[i].y1 = jobs[i].y0 + TEMPORAL_BAND_HEIGHT < area.y1 ? jobs[i].y0 + TEMPORAL_BAND_HEIGHT : area.y1;
+		jobs[i].area = area;
+		jobs[i].screen_to_history = screen_to_history;
+		if (temporal.pool) {
+			thread_pool_submit(temporal.pool, reconstruct_rows_job, &jobs[i]);
+		}
+		else {
+			reconstruct_rows_job(&jobs[i]);
+		}
+	}
+	if (temporal.pool) {
+		thread_pool_wait(temporal.pool);
+	}
+	free(jobs);
+}
+
+//completes a checkerboard frame. the finished area becomes the next frame's history
+void temporal_end_frame(rect_t area) {
+	area = rect_intersect(area, rect_make(0, 0, window_width, window_height));
+	if (output_width * output_height != history_capacity || rect_is_empty(area)) {
+		temporal_reset();
+		return;
+	}
+	if (temporal.checkerboard) {
+		reconstruct_rect(area);
+	}
+
+	//outside of the area the mesh was not on screen, so nothing is reprojected from there.
+	//the buffers only hold the last frame there, so that is never looked at either
+	temporal.history_rect = area;
+	temporal.history_checkerboard = temporal.checkerboard;
+	temporal.history_phase = temporal.phase;
+	temporal.history_object_to_screen = temporal.object_to_screen;
+	temporal.history_width = window_width;
+	temporal.history_height = window_height;
+	temporal.history_valid = true;
+}
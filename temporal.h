@@ -0,0 +1,51 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+#include "rect.h"
+#include "thread_pool.h"
+
+//checkerboard rendering: every frame rasterizes only the pixels with (x + y) % 2 == phase,
+//the phase flips each frame. the other half is filled in afterwards, inside of a face from
+//its neighbors, on edges by reprojecting it into the last frame through the depth of its
+//neighbors and the matrices of both frames. works in display mode 3 with the depth test,
+//without msaa and transparency, any other frame renders every pixel
+
+//rows of the screen reconstructed by one job
+#define TEMPORAL_BAND_HEIGHT 32
+//a reprojected pixel is only taken when the last frame's depth there is this close,
+//relative to the distance from the camera, otherwise it was covered or not on screen yet
+#define TEMPORAL_DEPTH_TOLERANCE 0.02f
+
+typedef struct {
+	bool enabled;
+	int phase; //of the pixels rasterized this frame
+	bool checkerboard; //this frame only rasterizes half of the pixels
+
+	//the last frame rendered in temporal mode, only history_rect is kept up to date, the rest
+	//of the screen was empty then. the buffers trade places with color_buffer and
+	//depth_buffer at the start of every temporal frame, instead of being copied
+	bool history_valid;
+	uint32_t* history_color; //output_width * output_height, window_width apart per row
+	float* history_depth;
+	int history_width, history_height;
+	rect_t history_rect;
+	bool history_checkerboard; //only the pixels of history_phase were rasterized
+	int history_phase;
+	mat4_t history_object_to_screen;
+
+	mat4_t object_to_screen; //model space to pixels (x, y) and z / w (z) of this frame
+	thread_pool_t* pool;
+} temporal_t;
+
+extern temporal_t temporal;
+
+bool temporal_init(void);
+bool temporal_begin_frame(const mat4_t* object_to_screen);
+void temporal_end_frame(rect_t area);
+void temporal_reset(void);
+void temporal_free(void);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "array.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+static int worker_main(void* data) {
+	thread_pool_t* pool = (thread_pool_t*)data;
+	PROFILE_THREAD_NAME(pool->name);
+
+	SDL_LockMutex(pool->lock);
+	while (true) {
+		while (!pool->stopping && pool->first_job == array_length(pool->jobs)) {
+			SDL_CondWait(pool->job_available, pool->lock);
+		}
+		if (pool->first_job == array_length(pool->jobs)) {
+			break; //stopping and nothing left to do
+		}
+
+		job_t job = pool->jobs[pool->first_job++];
+		pool->busy_threads++;
+		SDL_UnlockMutex(pool->lock);
+
+		job.function(job.data);
+
+		SDL_LockMutex(pool->lock);
+		pool->busy_threads--;
+		if (pool->busy_threads == 0 && pool->first_job == array_length(pool->jobs)) {
+			SDL_CondBroadcast(pool->all_done);
+		}
+	}
+	SDL_UnlockMutex(pool->lock);
+	return 0;
+}
+
+thread_pool_t* thread_pool_create(int num_threads, const char* name) {
+	thread_pool_t* pool = (thread_pool_t*)calloc(1, sizeof(thread_pool_t));
+	if (!pool) {
+		fprintf(stderr, "Error creating the thread pool. Probably not enough avaliable memory.\n");
+		return NULL;
+	}
+
+	snprintf(pool->name, sizeof(pool->name), "%s", name);
+	pool->lock = SDL_CreateMutex();
+	pool->job_available = SDL_CreateCond();
+	pool->all_done = SDL_CreateCond();
+	pool->threads = (SDL_Thread**)calloc(num_threads, sizeof(SDL_Thread*));
+
+	for (int i = 0; pool->threads && i < num_threads; i++) {
+		pool->threads[i] = SDL_CreateThread(worker_main, name, pool);
+		if (!pool->threads[i]) {
+			fprintf(stderr, "Error creating a worker thread: %s\n", SDL_GetError());
+			break;
+		}
+		pool->num_threads++;
+	}
+
+	if (pool->num_threads == 0) {
+		thread_pool_destroy(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+void thread_pool_submit(thread_pool_t* pool, job_function_t function, void* data) {
+	job_t job = { function, data };
+
+	SDL_LockMutex(pool->lock);
+	//reuse the queue from the start once every job in it has been taken
+	if (pool->first_job > 0 && pool->first_job == array_length(pool->jobs)) {
+		array_free(pool->jobs);
+		pool->jobs = NULL;
+		pool->first_job = 0;
+	}
+	array_push(pool->jobs, job);
+	SDL_CondSignal(pool->job_available);
+	SDL_UnlockMutex(pool->lock);
+}
+
+//blocks until the queue is empty and no worker is running a job
+void thread_pool_wait(thread_pool_t* pool) {
+	SDL_LockMutex(pool->lock);
+	while (pool->busy_threads > 0 || pool->first_job < array_length(pool->jobs)) {
+		SDL_CondWait(pool->all_done, pool->lock);
+	}
+	SDL_UnlockMutex(pool->lock);
+}
+
+//finishes every queued job before the threads exit
+void thread_pool_destroy(thread_pool_t* pool) {
+	if (!pool) {
+		return;
+	}
+
+	SDL_LockMutex(pool->lock);
+	pool->stopping = true;
+	SDL_CondBroadcast(pool->job_available);
+	SDL_UnlockMutex(pool->lock);
+
+	for (int i = 0; i < pool->num_threads; i++) {
+		SDL_WaitThread(pool->threads[i], NULL);
+	}
+
+	array_free(pool->jobs);
+	free(pool->threads);
+	SDL_DestroyCond(pool->all_done);
+	SDL_DestroyCond(pool->job_available);
+	SDL_DestroyMutex(pool->lock);
+	free(pool);
+}
@@ -0,0 +1,33 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+typedef void (*job_function_t)(void* data);
+
+typedef struct {
+	job_function_t function;
+	void* data;
+} job_t;
+
+//fixed set of worker threads taking jobs from one FIFO queue
+typedef struct {
+	SDL_Thread** threads;
+	int num_threads;
+	SDL_mutex* lock;
+	SDL_cond* job_available;
+	SDL_cond* all_done;
+	job_t* jobs;       //dynamic array, jobs before first_job are already taken
+	int first_job;
+	int busy_threads;
+	bool stopping;
+	char name[32];
+} thread_pool_t;
+
+thread_pool_t* thread_pool_create(int num_threads, const char* name);
+void thread_pool_submit(thread_pool_t* pool, job_function_t function, void* data);
+void thread_pool_wait(thread_pool_t* pool);
+void thread_pool_destroy(thread_pool_t* pool);
+
+#endif
@@ -1,5 +1,8 @@
 #include "display.h"
 #include "triangle.h"
+#include "profiler.h"
+#include "simd.h"
+#include "temporal.h"
 
 void triangle_swap(triangle_t* a, triangle_t* b) {
 	triangle_t temp = *a;
@@ -7,63 +10,408 @@ void triangle_swap(triangle_t* a, triangle_t* b) {
 	*b = temp;
 }
 
-void int_swap(int* a, int* b) {
-	int temp = *a;
+void vec2_fixed_swap(vec2_fixed_t* a, vec2_fixed_t* b) {
+	vec2_fixed_t temp = *a;
 	*a = *b;
 	*b = temp;
 }
 
-void fill_flat_bottom_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color) {
-	float inverse_slope_1 = (float)(x1 - x0) / (y1 - y0);
-	float inverse_slope_2 = (float)(x2 - x0) / (y2 - y0);
+//integer division rounding towards minus infinity, the divisor has to be positive
+static int64_t floor_div(int64_t a, int64_t b) {
+	int64_t q = a / b;
+	if ((a % b) != 0 && a < 0) {
+		q--;
+	}
+	return q;
+}
+
+//edge function E(x, y) = a * x + b * y + c, positive on the inside of the triangle.
+//the bias makes pixels exactly on an edge belong to only one of two neighbouring
+//triangles (top-left fill rule), so shared edges are never drawn twice or skipped
+typedef struct {
+	int64_t a, b, c;
+} edge_function_t;
+
+static edge_function_t edge_setup(vec2_fixed_t v0, vec2_fixed_t v1) {
+	edge_function_t e;
+	int64_t dx = (int64_t)v1.x - v0.x;
+	int64_t dy = (int64_t)v1.y - v0.y;
+	e.a = -dy;
+	e.b = dx;
+	e.c = dy * v0.x - dx * v0.y;
+
+	bool is_left_edge = dy < 0;
+	bool is_top_edge = dy == 0 && dx > 0;
+	if (!is_left_edge && !is_top_edge) {
+		e.c -= 1;
+	}
+	return e;
+}
+
+//narrows the span [x_min, x_max] to the pixels whose centers are inside the edge
+//on the current row, value is the edge function at the center of pixel x_origin
+static void edge_clip_span(edge_function_t* e, int64_t value, int x_origin, int* x_min, int* x_max) {
+	int64_t step = e->a * FIXED_ONE;
+	if (step > 0) {
+		int64_t first = x_origin + floor_div(-value + step - 1, step);
+		if (first > *x_min) {
+			*x_min = (int)first;
+		}
+	}
+	else if (step < 0) {
+		int64_t last = x_origin + floor_div(value, -step);
+		if (last < *x_max) {
+			*x_max = (int)last;
+		}
+	}
+	else if (value < 0) {
+		*x_max = *x_min - 1;
+	}
+}
+
+//everything the triangle rasterizers share: edges in consistent winding,
+//the pixel bounding box and the screen space depth plane
+typedef struct {
+	edge_function_t edges[3];
+	int x_start, x_end;
+	int y_start, y_end;
+	//depth at the center of pixel (x_start, y_start) and its change per pixel
+	float z_origin;
+	float dz_dx, dz_dy;
+} triangle_setup_t;
+
+//margin in sub pixel steps added around pixel centers, used to find every pixel
+//that might have one of its multisample points covered
+#define MSAA_SAMPLE_MARGIN 6
+
+//4x rotated grid sample positions relative to the pixel center, in 28.4 sub pixel steps
+static const int msaa_sample_offsets[MSAA_SAMPLES][2] = {
+	{ -2, -6 },
+	{  6, -2 },
+	{ -6,  2 },
+	{  2,  6 }
+};
+
+//the bounding box is limited to clip, which is clip_rect for everything drawn to the screen
+static bool triangle_setup(vec2_fixed_t p0, float z0, vec2_fixed_t p1, float z1, vec2_fixed_t p2, float z2, int margin, rect_t clip, triangle_setup_t* t) {
+	int64_t area = ((int64_t)p1.x - p0.x) * ((int64_t)p2.y - p0.y) - ((int64_t)p1.y - p0.y) * ((int64_t)p2.x - p0.x);
+	if (area == 0) {
+		return false;
+	}
+	//make the winding consistent so the inside is always positive
+	if (area < 0) {
+		vec2_fixed_swap(&p1, &p2);
+		float temp = z1;
+		z1 = z2;
+		z2 = temp;
+		area = -area;
+	}
+
+	t->edges[0] = edge_setup(p0, p1);
+	t->edges[1] = edge_setup(p1, p2);
+	t->edges[2] = edge_setup(p2, p0);
+
+	//pixels whose centers are inside of the bounding box
+	fixed_t min_x = p0.x < p1.x ? (p0.x < p2.x ? p0.x : p2.x) : (p1.x < p2.x ? p1.x : p2.x);
+	fixed_t max_x = p0.x > p1.x ? (p0.x > p2.x ? p0.x : p2.x) : (p1.x > p2.x ? p1.x : p2.x);
+	fixed_t min_y = p0.y < p1.y ? (p0.y < p2.y ? p0.y : p2.y) : (p1.y < p2.y ? p1.y : p2.y);
+	fixed_t max_y = p0.y > p1.y ? (p0.y > p2.y ? p0.y : p2.y) : (p1.y > p2.y ? p1.y : p2.y);
+
+	t->x_start = fixed_ceil_to_int(min_x - FIXED_HALF - margin);
+	t->x_end = fixed_floor_to_int(max_x - FIXED_HALF + margin);
+	t->y_start = fixed_ceil_to_int(min_y - FIXED_HALF - margin);
+	t->y_end = fixed_floor_to_int(max_y - FIXED_HALF + margin);
+
+	if (t->x_start < clip.x0) t->x_start = clip.x0;
+	if (t->x_end > clip.x1 - 1) t->x_end = clip.x1 - 1;
+	if (t->y_start < clip.y0) t->y_start = clip.y0;
+	if (t->y_end > clip.y1 - 1) t->y_end = clip.y1 - 1;
+	if (t->x_start > t->x_end || t->y_start > t->y_end) {
+		return false;
+	}
+
+	//depth plane in pixel units
+	float area_pixels = (float)area / (FIXED_ONE * FIXED_ONE);
+	float x1 = (float)(p1.x - p0.x) / FIXED_ONE, y1 = (float)(p1.y - p0.y) / FIXED_ONE;
+	float x2 = (float)(p2.x - p0.x) / FIXED_ONE, y2 = (float)(p2.y - p0.y) / FIXED_ONE;
+	t->dz_dx = ((z1 - z0) * y2 - (z2 - z0) * y1) / area_pixels;
+	t->dz_dy = ((z2 - z0) * x1 - (z1 - z0) * x2) / area_pixels;
+	t->z_origin = z0
+		+ t->dz_dx * ((float)(fixed_pixel_center(t->x_start) - p0.x) / FIXED_ONE)
+		+ t->dz_dy * ((float)(fixed_pixel_center(t->y_start) - p0.y) / FIXED_ONE);
+	return true;
+}
+
+//scanline rasterizer working purely on the 28.4 fixed point vertices, each row gets its
+//exact span from the three edge functions. with FILL_DEPTH_TEST every pixel is tested
+//against the z-buffer, z is the projected depth (z / w) which interpolates linearly on
+//screen. FILL_OVERDRAW only counts the writes in overdraw_buffer instead of coloring,
+//FILL_CHECKERBOARD only visits the pixels of the current temporal phase
+#define FILL_DEPTH_TEST 1
+#define FILL_OVERDRAW 2
+#define FILL_CHECKERBOARD 8
 
-	float x_start = x0;
-	float x_end = x0;
-	for (int y = y0; y <= y2; y++) {
-		draw_horizontal_line(x_start, y, x_end, color);
-		x_start += inverse_slope_1;
-		x_end += inverse_slope_2;
+static FORCE_INLINE void fill_triangle(const triangle_t* triangle, uint32_t color, int flags) {
+	triangle_setup_t t;
+	if (!triangle_setup(
+		triangle->points[0], triangle->depths[0],
+		triangle->points[1], triangle->depths[1],
+		triangle->points[2], triangle->depths[2],
+		0, clip_rect, &t)) {
+		return;
+	}
+
+	//edge values at the center of the first pixel of the first row, then stepped per row
+	int64_t row_values[3];
+	for (int i = 0; i < 3; i++) {
+		row_values[i] = t.edges[i].a * fixed_pixel_center(t.x_start) + t.edges[i].b * fixed_pixel_center(t.y_start) + t.edges[i].c;
+	}
+
+	const int step = (flags & FILL_CHECKERBOARD) ? 2 : 1;
+	const float dz = t.dz_dx * step;
+	float row_z = t.z_origin;
+	for (int y = t.y_start; y <= t.y_end; y++) {
+		int span_start = t.x_start;
+		int span_end = t.x_end;
+		for (int i = 0; i < 3; i++) {
+			edge_clip_span(&t.edges[i], row_values[i], t.x_start, &span_start, &span_end);
+			row_values[i] += t.edges[i].b * FIXED_ONE;
+		}
+
+		uint32_t* row = color_buffer + window_width * y;
+		uint8_t* counts = (flags & FILL_OVERDRAW) ? overdraw_buffer + window_width * y : NULL;
+		float* depth_row = depth_buffer + window_width * y;
+		if (flags & FILL_CHECKERBOARD) {
+			span_start += (span_start + y + temporal.phase) & 1;
+		}
+		float z = row_z + t.dz_dx * (span_start - t.x_start);
+		for (int x = span_start; x <= span_end; x += step) {
+			if (!(flags & FILL_DEPTH_TEST) || z < depth_row[x]) {
+				if (flags & FILL_DEPTH_TEST) {
+					depth_row[x] = z;
+				}
+				if (flags & FILL_OVERDRAW) {
+					if (counts[x] != 255) {
+						counts[x]++;
+					}
+				}
+				else {
+					row[x] = color;
+				}
+				PROFILE_PIXEL(window_width * y + x);
+			}
+			z += dz;
+		}
+		row_z += t.dz_dy;
 	}
 }
-void fill_flat_top_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color) {
-	float inverse_slope_1 = (float)(x2 - x0) / (y2 - y0);
-	float inverse_slope_2 = (float)(x2 - x1) / (y2 - y1);
 
-	float x_start = x2;
-	float x_end = x2;
-	for (int y = y2; y >= y0; y--) {
-		draw_horizontal_line(x_start, y, x_end, color);
-		x_start -= inverse_slope_1;
-		x_end -= inverse_slope_2;
+//transparent triangles: same spans as fill_triangle, every covered pixel adds the color
+//weighted by alpha and closeness to oit_accum_buffer and its transparency to
+//oit_revealage_buffer. the opaque depth is only tested against, never written.
+//with FILL_MSAA_DEPTH the first sample of every pixel stands in for its depth
+#define FILL_MSAA_DEPTH 4
+
+static FORCE_INLINE void fill_triangle_oit(const triangle_t* triangle, uint32_t color, int flags) {
+	triangle_setup_t t;
+	if (!triangle_setup(
+		triangle->points[0], triangle->depths[0],
+		triangle->points[1], triangle->depths[1],
+		triangle->points[2], triangle->depths[2],
+		0, clip_rect, &t)) {
+		return;
+	}
+
+	float alpha = (color >> 24) / 255.0f;
+	float premultiplied[3] = {
+		(color & 0xFF) * alpha,
+		((color >> 8) & 0xFF) * alpha,
+		((color >> 16) & 0xFF) * alpha
+	};
+	const float* depths = (flags & FILL_MSAA_DEPTH) ? msaa_depth_buffer : depth_buffer;
+	const int depth_stride = (flags & FILL_MSAA_DEPTH) ? MSAA_SAMPLES : 1;
+
+	int64_t row_values[3];
+	for (int i = 0; i < 3; i++) {
+		row_values[i] = t.edges[i].a * fixed_pixel_center(t.x_start) + t.edges[i].b * fixed_pixel_center(t.y_start) + t.edges[i].c;
+	}
+
+	float row_z = t.z_origin;
+	for (int y = t.y_start; y <= t.y_end; y++) {
+		int span_start = t.x_start;
+		int span_end = t.x_end;
+		for (int i = 0; i < 3; i++) {
+			edge_clip_span(&t.edges[i], row_values[i], t.x_start, &span_start, &span_end);
+			row_values[i] += t.edges[i].b * FIXED_ONE;
+		}
+
+		float* accum = oit_accum_buffer + window_width * y * 4;
+		float* revealage = oit_revealage_buffer + window_width * y;
+		const float* depth_row = depths + (size_t)window_width * y * depth_stride;
+		float z = row_z + t.dz_dx * (span_start - t.x_start);
+		for (int x = span_start; x <= span_end; x++) {
+			if (!(flags & FILL_DEPTH_TEST) || z < depth_row[x * depth_stride]) {
+				//closer fragments weigh more (McGuire and Bavoil), z is z / w in 0 - 1
+				float distance = 1.0f - z;
+				float weight = 3000.0f * distance * distance * distance;
+				weight = alpha * (weight > 0.01f ? weight : 0.01f);
+				float* sum = accum + x * 4;
+				sum[0] += premultiplied[0] * weight;
+				sum[1] += premultiplied[1] * weight;
+				sum[2] += premultiplied[2] * weight;
+				sum[3] += alpha * weight;
+				revealage[x] *= 1.0f - alpha;
+				PROFILE_PIXEL(window_width * y + x);
+			}
+			z += t.dz_dx;
+		}
+		row_z += t.dz_dy;
 	}
 }
 
-void draw_filled_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color) {
-	if (y0 > y1) {
-		int_swap(&y0, &y1);
-		int_swap(&x0, &x1);
+//depth only rasterization into any float buffer, for shadow maps: no color, no pixel
+//counters and no globals touched, so several threads can fill separate parts of one
+//buffer at once. clip must lie inside of the buffer
+void draw_depth_only_triangle(vec2_fixed_t p0, float z0, vec2_fixed_t p1, float z1, vec2_fixed_t p2, float z2, float* depth, int pitch, rect_t clip) {
+	triangle_setup_t t;
+	if (!triangle_setup(p0, z0, p1, z1, p2, z2, 0, clip, &t)) {
+		return;
+	}
+
+	int64_t row_values[3];
+	for (int i = 0; i < 3; i++) {
+		row_values[i] = t.edges[i].a * fixed_pixel_center(t.x_start) + t.edges[i].b * fixed_pixel_center(t.y_start) + t.edges[i].c;
 	}
-	if (y1 > y2) {
-		int_swap(&y1, &y2);
-		int_swap(&x1, &x2);
+
+#if USE_SSE2
+	__m128 lane_offsets = _mm_mul_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(t.dz_dx));
+#endif
+	float row_z = t.z_origin;
+	for (int y = t.y_start; y <= t.y_end; y++) {
+		int span_start = t.x_start;
+		int span_end = t.x_end;
+		for (int i = 0; i < 3; i++) {
+			edge_clip_span(&t.edges[i], row_values[i], t.x_start, &span_start, &span_end);
+			row_values[i] += t.edges[i].b * FIXED_ONE;
+		}
+
+		float* row = depth + (size_t)pitch * y;
+		int x = span_start;
+#if USE_SSE2
+		//every pixel of the span is covered, four depths are kept at the minimum per step
+		for (; x + 3 <= span_end; x += 4) {
+			__m128 z = _mm_add_ps(_mm_set1_ps(row_z + t.dz_dx * (x - t.x_start)), lane_offsets);
+			_mm_storeu_ps(row + x, _mm_min_ps(_mm_loadu_ps(row + x), z));
+		}
+#endif
+		for (; x <= span_end; x++) {
+			float z = row_z + t.dz_dx * (x - t.x_start);
+			if (z < row[x]) {
+				row[x] = z;
+			}
+		}
+		row_z += t.dz_dy;
 	}
-	if (y0 > y1) {
-		int_swap(&y0, &y1);
-		int_swap(&x0, &x1);
+}
+
+//4x multisampled rasterization: coverage is evaluated from the edge functions at every
+//sample point, the color is decided once per pixel and written to each covered sample.
+//with FILL_DEPTH_TEST every sample keeps its own depth
+static FORCE_INLINE void fill_triangle_msaa(const triangle_t* triangle, uint32_t color, int flags) {
+	triangle_setup_t t;
+	if (!triangle_setup(
+		triangle->points[0], triangle->depths[0],
+		triangle->points[1], triangle->depths[1],
+		triangle->points[2], triangle->depths[2],
+		MSAA_SAMPLE_MARGIN, clip_rect, &t)) {
+		return;
 	}
 
-	//avoid division by zero
-	if (y1 == y2) {
-		fill_flat_bottom_triangle(x0, y0, x1, y1, x2, y2, color);
+	int64_t row_values[3];
+	int64_t sample_offsets[3][MSAA_SAMPLES];
+	int64_t margins[3];
+	for (int i = 0; i < 3; i++) {
+		row_values[i] = t.edges[i].a * fixed_pixel_center(t.x_start) + t.edges[i].b * fixed_pixel_center(t.y_start) + t.edges[i].c;
+		for (int s = 0; s < MSAA_SAMPLES; s++) {
+			sample_offsets[i][s] = t.edges[i].a * msaa_sample_offsets[s][0] + t.edges[i].b * msaa_sample_offsets[s][1];
+		}
+		margins[i] = (t.edges[i].a < 0 ? -t.edges[i].a : t.edges[i].a) * MSAA_SAMPLE_MARGIN
+			+ (t.edges[i].b < 0 ? -t.edges[i].b : t.edges[i].b) * MSAA_SAMPLE_MARGIN;
 	}
-	else if (y0 == y1) {
-		fill_flat_top_triangle(x0, y0, x1, y1, x2, y2, color);
+
+	float sample_z_offsets[MSAA_SAMPLES];
+	for (int s = 0; s < MSAA_SAMPLES; s++) {
+		sample_z_offsets[s] = (t.dz_dx * msaa_sample_offsets[s][0] + t.dz_dy * msaa_sample_offsets[s][1]) / FIXED_ONE;
 	}
-	else {
-		int My = y1;
-		int Mx = ((float)((x2 - x0) * (y1 - y0)) / (float)(y2 - y0)) + x0;
 
-		fill_flat_bottom_triangle(x0, y0, x1, y1, Mx, My, color);
-		fill_flat_top_triangle(x1, y1, Mx, My, x2, y2, color);
+	float row_z = t.z_origin;
+	for (int y = t.y_start; y <= t.y_end; y++) {
+		//conservative span: every pixel that could have any sample inside
+		int span_start = t.x_start;
+		int span_end = t.x_end;
+		for (int i = 0; i < 3; i++) {
+			edge_clip_span(&t.edges[i], row_values[i] + margins[i], t.x_start, &span_start, &span_end);
+		}
+
+		int64_t values[3];
+		for (int i = 0; i < 3; i++) {
+			values[i] = row_values[i] + t.edges[i].a * FIXED_ONE * (span_start - t.x_start);
+		}
+
+		uint32_t* samples = msaa_color_buffer + (window_width * y + span_start) * MSAA_SAMPLES;
+		float* sample_depths = msaa_depth_buffer + (window_width * y + span_start) * MSAA_SAMPLES;
+		float z = row_z + t.dz_dx * (span_start - t.x_start);
+		for (int x = span_start; x <= span_end; x++) {
+			int written_samples = 0;
+			for (int s = 0; s < MSAA_SAMPLES; s++) {
+				bool covered =
+					values[0] + sample_offsets[0][s] >= 0 &&
+					values[1] + sample_offsets[1][s] >= 0 &&
+					values[2] + sample_offsets[2][s] >= 0;
+				if (!covered) {
+					continue;
+				}
+				if (flags & FILL_DEPTH_TEST) {
+					float sample_z = z + sample_z_offsets[s];
+					if (sample_z >= sample_depths[s]) {
+						continue;
+					}
+					sample_depths[s] = sample_z;
+				}
+				samples[s] = color;
+				written_samples++;
+			}
+			if (written_samples > 0) {
+				PROFILE_PIXEL(window_width * y + x);
+			}
+			for (int i = 0; i < 3; i++) {
+				values[i] += t.edges[i].a * FIXED_ONE;
+			}
+			samples += MSAA_SAMPLES;
+			sample_depths += MSAA_SAMPLES;
+			z += t.dz_dx;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			row_values[i] += t.edges[i].b * FIXED_ONE;
+		}
+		row_z += t.dz_dy;
+	}
+}
+
+//the specializations used by the raster pipelines, one per combination of flags
+#define DEFINE_RASTERIZER(name, generic, flags) \
+	void name(const triangle_t* triangle, uint32_t color) { \
+		generic(triangle, color, flags); \
 	}
-}
\ No newline at end of file
+
+DEFINE_RASTERIZER(draw_filled_triangle, fill_triangle, 0)
+DEFINE_RASTERIZER(draw_filled_triangle_depth, fill_triangle, FILL_DEPTH_TEST)
+DEFINE_RASTERIZER(draw_filled_triangle_depth_checkerboard, fill_triangle, FILL_DEPTH_TEST | FILL_CHECKERBOARD)
+DEFINE_RASTERIZER(draw_filled_triangle_overdraw, fill_triangle, FILL_OVERDRAW)
+DEFINE_RASTERIZER(draw_filled_triangle_overdraw_depth, fill_triangle, FILL_OVERDRAW | FILL_DEPTH_TEST)
+DEFINE_RASTERIZER(draw_filled_triangle_msaa, fill_triangle_msaa, 0)
+DEFINE_RASTERIZER(draw_filled_triangle_msaa_depth, fill_triangle_msaa, FILL_DEPTH_TEST)
+DEFINE_RASTERIZER(draw_filled_triangle_oit, fill_triangle_oit, 0)
+DEFINE_RASTERIZER(draw_filled_triangle_oit_depth, fill_triangle_oit, FILL_DEPTH_TEST)
+DEFINE_RASTERIZER(draw_filled_triangle_oit_msaa_depth, fill_triangle_oit, FILL_DEPTH_TEST | FILL_MSAA_DEPTH)
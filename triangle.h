@@ -2,7 +2,10 @@
 #define TRIANGLE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "vector.h"
+#include "fixed.h"
+#include "rect.h"
 
 typedef struct {
 	int a;
@@ -12,14 +15,25 @@ typedef struct {
 } face_t;
 
 typedef struct {
-	vec2_t points[3];
+	vec2_fixed_t points[3];
+	float depths[3]; //projected z / w of each point, for the z-buffer
 	uint32_t color;
 	float avg_depth;
 } triangle_t;
 
-void fill_flat_bottom_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
-void fill_flat_top_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
-
-void draw_filled_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint32_t color);
+//rasterizers specialized at compile time, the fill color is ignored by the overdraw ones.
+//the oit ones only accumulate transparent triangles, _msaa_depth tests against the first
+//multisample depth. _checkerboard only fills the pixels of the current temporal phase
+void draw_filled_triangle(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_depth(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_depth_checkerboard(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_overdraw(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_overdraw_depth(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_msaa(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_msaa_depth(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_oit(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_oit_depth(const triangle_t* triangle, uint32_t color);
+void draw_filled_triangle_oit_msaa_depth(const triangle_t* triangle, uint32_t color);
+void draw_depth_only_triangle(vec2_fixed_t p0, float z0, vec2_fixed_t p1, float z1, vec2_fixed_t p2, float z2, float* depth, int pitch, rect_t clip);
 
 #endif